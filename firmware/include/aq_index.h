@@ -0,0 +1,100 @@
+#pragma once
+
+#include "hal.h"
+
+// 0..100 index from TVOC ppb (tune later!)
+uint8_t tvocToIndex(uint16_t tvoc);
+
+// Band boundaries for N color bands over the AQ index, built at compile time.
+// Band b covers (thresholds[b-1], thresholds[b]]; with hysteresis h it is only
+// left upwards at index >= thresholds[b] + h and downwards at
+// index <= thresholds[b-1] - h. Keep the table in PROGMEM (read as bytes).
+template <uint8_t N>
+struct AqBandTable {
+  uint8_t raw[101];   // band of each index without hysteresis
+  uint8_t lo[N];      // first index of the band
+  uint8_t hi[N];      // last index of the band
+  uint8_t keepLo[N];  // band is kept while keepLo <= index <= keepHi
+  uint8_t keepHi[N];
+};
+
+// thresholds must be ascending and below 100
+template <uint8_t N>
+constexpr AqBandTable<N> makeAqBandTable(const uint8_t (&thresholds)[N - 1], uint8_t hysteresis) {
+  static_assert(N >= 2, "at least two bands");
+  AqBandTable<N> t = {};
+  for (uint8_t b = 0; b < N; b++) {
+    int lo = b == 0 ? 0 : thresholds[b - 1] + 1;
+    int hi = b == N - 1 ? 100 : thresholds[b];
+    int keepLo = b == 0 ? 0 : thresholds[b - 1] - hysteresis + 1;
+    int keepHi = b == N - 1 ? 100 : thresholds[b] + hysteresis - 1;
+    t.lo[b] = (uint8_t)lo;
+    t.hi[b] = (uint8_t)hi;
+    t.keepLo[b] = (uint8_t)(keepLo < 0 ? 0 : (keepLo > lo ? lo : keepLo));
+    t.keepHi[b] = (uint8_t)(keepHi > 100 ? 100 : (keepHi < hi ? hi : keepHi));
+    for (int idx = lo; idx <= hi; idx++) t.raw[idx] = b;
+  }
+  return t;
+}
+
+// A change of color band
+struct AqBandEvent {
+  uint8_t from;
+  uint8_t to;
+  uint8_t index;   // raw index that caused it
+};
+
+// Hysteresis on the AQ index to prevent LED flickering near threshold
+// transitions: the band only changes once the index is past the hysteresis
+// margin, and the index is held inside the current band's range until then.
+// Two comparisons and a table read per sample.
+template <uint8_t N>
+class AqBandClassifier {
+public:
+  explicit AqBandClassifier(const AqBandTable<N>& table) : _table(table) {}
+
+  // Stabilized index for newIndex (0..100)
+  uint8_t apply(uint8_t newIndex) {
+    uint8_t idx = newIndex > 100 ? 100 : newIndex;
+    if (!_primed) {
+      // First classification since power-on: not a transition
+      _band = pgm_read_byte(&_table.raw[idx]);
+      _primed = true;
+    } else if (idx < pgm_read_byte(&_table.keepLo[_band]) ||
+               idx > pgm_read_byte(&_table.keepHi[_band])) {
+      uint8_t to = pgm_read_byte(&_table.raw[idx]);
+      _event = {_band, to, idx};
+      _pending = true;
+      _transitions++;
+      _band = to;
+    }
+    uint8_t lo = pgm_read_byte(&_table.lo[_band]);
+    uint8_t hi = pgm_read_byte(&_table.hi[_band]);
+    return idx < lo ? lo : (idx > hi ? hi : idx);
+  }
+
+  uint8_t band() const { return _band; }
+  uint32_t transitions() const { return _transitions; }
+
+  // Band change from apply() not yet taken (newer changes replace it)
+  bool takeEvent(AqBandEvent& e) {
+    if (!_pending) return false;
+    e = _event;
+    _pending = false;
+    return true;
+  }
+
+  // Band carried across deep sleep
+  void restore(uint8_t band) {
+    _band = band < N ? band : N - 1;
+    _primed = true;
+  }
+
+private:
+  const AqBandTable<N>& _table;
+  uint8_t _band = 0;
+  bool _primed = false;
+  bool _pending = false;
+  AqBandEvent _event = {};
+  uint32_t _transitions = 0;
+};
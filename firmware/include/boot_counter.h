@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Cold boots of this device, kept in LittleFS. A deep-sleep wake continues
+// the boot it slept in (uptime is carried across sleeps), so only other resets
+// count. Readings carry the count next to ts_ms: the pair names a reading
+// whatever its wall-clock stamp, so the server can drop a re-sent one even
+// when it had to estimate the time. Wraps past 65535, skipping 0.
+class BootCounter {
+public:
+  // LittleFS must be mounted; woke is true after a deep-sleep wake
+  void begin(bool woke);
+
+  uint16_t count() const { return _count; }   // 0 until begin(), or if the file can't be written
+
+private:
+  uint16_t _count = 0;
+};
@@ -3,6 +3,9 @@
 // Wi-Fi
 static const char* WIFI_SSID     = "YOUR_WIFI_SSID";
 static const char* WIFI_PASSWORD = "YOUR_WIFI_PASSWORD";
+// Reuse the last DHCP lease as a static config on fast reconnect (skips DHCP).
+// Disable on networks with short leases or strict IP/MAC binding.
+static const bool WIFI_CACHE_STATIC_IP = true;
 
 // HiveMQ MQTT Broker
 static const char* MQTT_BROKER   = "your-cluster.hivemq.cloud";
@@ -10,26 +13,145 @@ static const uint16_t MQTT_PORT  = 8883;
 static const char* MQTT_USERNAME = "your-username";
 static const char* MQTT_PASSWORD = "your-password";
 static const char* MQTT_TOPIC    = "airq/your-device-id";
+// Readings are published QoS1: up to this many may await a PUBACK at once
+// (more queue behind them, up to MQTT_OUTBOX_SLOTS)
+static const uint8_t MQTT_INFLIGHT_WINDOW = 4;
+// Publish the binary record (up to READING_BIN_LEN bytes, reading_codec.h) instead of JSON.
+// The dashboard decodes both; the device id is taken from the topic.
+static const bool MQTT_BINARY_PAYLOAD = false;
+// Device health: heap, link counters and loop/IO latency histograms every TELEMETRY_MS
+static const char* MQTT_TELEMETRY_TOPIC = "airq/your-device-id/telemetry";
+static const uint32_t TELEMETRY_MS = 60000;
+// Remote config (remote_config.h): a retained JSON message here retunes
+// SAMPLE_MS, WARMUP_MS, REPORT_HEARTBEAT_MS, BATCH_MAX_*, LED_BRIGHTNESS and
+// the AQ thresholds/hysteresis at runtime, and is kept in flash. One topic for
+// the whole fleet, or per device; "" disables the subscription.
+static const char* MQTT_CONFIG_TOPIC = "airq/config";
 
-// Identity
-static const char* DEVICE_ID = "airq-d1mini-01";
+// SNTP (UTC). Readings carry ts_epoch_ms once the first sync has completed.
+static const char* NTP_SERVER_1 = "pool.ntp.org";
+static const char* NTP_SERVER_2 = "time.cloudflare.com";
+
+// TLS server verification (tls_trust.h); PEM text, kept in flash.
+// A pinned public key (the server's SPKI) makes the check nearly free but must
+// be updated when the server changes its key; print it with
+//   openssl s_client -connect HOST:PORT -servername HOST </dev/null | openssl x509 -pubkey -noout
+// Hosts without a pin (or whose pin stops matching) are validated against
+// TLS_ROOT_CA: the root certificate(s) both servers chain to, concatenated.
+// That needs the SNTP time, so those connects wait for the first sync.
+// TLS_ALLOW_INSECURE connects unverified when neither is set (development only).
+static const char MQTT_TLS_PUBKEY[] PROGMEM = "";
+static const char WORKER_TLS_PUBKEY[] PROGMEM = "";
+static const char TLS_ROOT_CA[] PROGMEM = "";
+static const bool TLS_ALLOW_INSECURE = false;
+
+// Identity (an array, so buffers that carry it are sized from its length)
+static const char DEVICE_ID[] = "airq-d1mini-01";
 
 // Sampling
+// The SGP30 is always measured at exactly 1 Hz (its IAQ algorithm needs it);
+// SHT31 readings (and the SGP30 humidity compensation) refresh every
+// SHT_INTERVAL_MS, and a reading goes to serial/MQTT/upload every SAMPLE_MS.
 static const uint32_t SAMPLE_MS = 2000;
+static const uint32_t SHT_INTERVAL_MS = 5000;
+
+// Add-on sensors (sensor_registry.h), off unless fitted. Their values are
+// appended to every reading: JSON keys and binary record slots (sensor_fields.h).
+// PMS5003 particulates on a software UART: sensor TX to PMS_RX_PIN, sensor RX to PMS_TX_PIN.
+// SCD40/SCD41 NDIR CO2 on the I²C bus (0x62), next to the SHT31 and SGP30.
+static const bool SENSOR_PMS5003 = false;
+static const uint8_t PMS_RX_PIN = D6;
+static const uint8_t PMS_TX_PIN = D7;
+static const bool SENSOR_SCD4X = false;
+
+// Report by exception: a sample is published/uploaded only when a field moved by
+// at least its deadband (or the AQ color band / warm-up flag changed), and at least
+// every REPORT_HEARTBEAT_MS. Reports carry min/mean/max of the suppressed samples.
+// All deadbands 0 and a heartbeat of 0 report every sample; deadbands of 65535
+// (1000.0f for t_c/rh) publish on band transitions and the heartbeat only.
+static const uint16_t DEADBAND_TVOC_PPB = 10;
+static const uint16_t DEADBAND_ECO2_PPM = 25;
+static const float DEADBAND_T_C = 0.2f;
+static const float DEADBAND_RH = 1.0f;
+static const uint32_t REPORT_HEARTBEAT_MS = 60000;
+
+// Edge analytics (edge_stats.h): per-sample EWMA (alpha = 2^-EDGE_EWMA_SHIFT),
+// rolling min/max and rate of change of TVOC/eCO2, carried in every reading.
+// A spike is a sample at least SPIKE_*_RISE above the EWMA while rising at
+// SPIKE_*_PER_MIN or faster; it is reported at once and, in the low-power
+// modes, opens an upload window right away.
+static const uint8_t EDGE_EWMA_SHIFT = 3;   // ~8 samples (16 s at 2 s)
+static const uint16_t SPIKE_TVOC_RISE_PPB = 150;
+static const uint16_t SPIKE_TVOC_PPB_PER_MIN = 300;
+static const uint16_t SPIKE_ECO2_RISE_PPM = 200;
+static const uint16_t SPIKE_ECO2_PPM_PER_MIN = 400;
+
+// Batched upload to the Cloudflare Worker (D1 storage)
+// Readings are queued and POSTed as one JSON array every BATCH_MAX_SAMPLES
+// samples or BATCH_MAX_AGE_MS, whichever comes first. MQTT stays per-sample.
+static const uint8_t BATCH_MAX_SAMPLES = 15;
+static const uint32_t BATCH_MAX_AGE_MS = 30000;
+
+// Offline store-and-forward (LittleFS)
+// Readings that don't fit the RAM queue during an outage are written to flash
+// in segments of OFFLINE_SEGMENT_RECORDS (a READING_BIN_LEN slot each); the oldest segment is
+// reused once OFFLINE_MAX_SEGMENTS are full (32 × 256 ≈ 4.5 h at 2 s).
+// Backfill sends OFFLINE_BACKFILL_RECORDS per request, at most one request per OFFLINE_BACKFILL_INTERVAL_MS.
+static const uint16_t OFFLINE_SEGMENT_RECORDS = 256;
+static const uint8_t OFFLINE_MAX_SEGMENTS = 32;
+static const uint8_t OFFLINE_BACKFILL_RECORDS = 60;
+static const uint32_t OFFLINE_BACKFILL_INTERVAL_MS = 5000;
+
+// OTA updates from the Cloudflare deployment (/api/firmware, see web/public/firmware/)
+// Checked once after boot and every OTA_CHECK_INTERVAL_MS (0: only rollbacks).
+// A new image is on trial until its first acknowledged MQTT publish; if it
+// resets OTA_TRIAL_BOOTS times or isn't confirmed within OTA_CONFIRM_MS the
+// previous version is installed again.
+static const uint32_t OTA_CHECK_INTERVAL_MS = 6UL * 3600000UL;
+static const uint32_t OTA_CONFIRM_MS = 10UL * 60000UL;
+static const uint8_t OTA_TRIAL_BOOTS = 3;
+
+// Software watchdog: a loop() stage step longer than WATCHDOG_STALL_MS counts
+// as a stall (telemetry "watchdog"); the Worker connection is aborted after
+// WATCHDOG_HTTP_MS without progress and MQTT reconnected after WATCHDOG_MQTT_MS
+// without inbound traffic (pings keep an idle link under a minute).
+// Sensors missing at boot are probed again every SENSOR_REPROBE_MS.
+static const uint32_t WATCHDOG_STALL_MS = 1000;
+static const uint32_t WATCHDOG_HTTP_MS = 30000;
+static const uint32_t WATCHDOG_MQTT_MS = 180000;
+static const uint32_t SENSOR_REPROBE_MS = 30000;
+
+// Power mode: 0 = always on (mains), 1 = modem sleep, 2 = deep sleep (battery)
+// Low-power modes keep the radio off except for upload windows of at most
+// UPLOAD_WINDOW_MS, opened when a batch is due. Deep sleep needs GPIO16 (D0)
+// wired to RST; the 1 Hz SGP30 tick still wakes the CPU every second.
+static const uint8_t POWER_MODE = 0;
+static const uint32_t UPLOAD_WINDOW_MS = 20000;
+static const uint32_t POWER_REPORT_MS = 60000;   // power/latency budget on serial
 
 // NeoPixel shield
 static const uint8_t PIN_NEOPIXEL = D4;   // common default for D1 mini shields
 static const uint16_t N_LEDS = 1;
 
 // UX / warmup
+// Full warm-up after a cold start; the short one applies when a stored SGP30
+// baseline was restored (warm restart, OTA update), covering the sensor's 15 s init
 static const uint32_t WARMUP_MS = 60000;
+static const uint32_t WARMUP_RESTORED_MS = 15000;
 
-// LED brightness cap (0..255)
+// LED brightness cap (0..255), applied once at boot
 static const uint8_t LED_BRIGHTNESS = 40;
+// LED_MODE: 0 solid color, 1 bar graph of the AQ index, 2 bar graph colored along
+// the AQ ramp (bar modes need N_LEDS > 1). Colors cross-fade over LED_FADE_MS;
+// frames run every LED_FRAME_MS but the strip is only written when it changes.
+static const uint8_t LED_MODE = 0;
+static const uint16_t LED_FRAME_MS = 20;
+static const uint16_t LED_FADE_MS = 800;
 
 // AQ Index thresholds and hysteresis
 // Thresholds define the color transitions: green (0-LOW), yellow (LOW-HIGH), red (HIGH-100)
-// Hysteresis margin prevents flickering near boundaries
+// Hysteresis margin prevents flickering near boundaries: a band is only left once the
+// index is AQ_HYSTERESIS_BAND past its threshold (band changes log as [AQ] lines)
 static const uint8_t AQ_THRESHOLD_LOW = 20;     // Green → Yellow transition
 static const uint8_t AQ_THRESHOLD_HIGH = 60;    // Yellow → Red transition
 static const uint8_t AQ_HYSTERESIS_BAND = 5;    // Margin to prevent flickering (ppb)
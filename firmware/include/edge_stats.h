@@ -0,0 +1,113 @@
+#pragma once
+
+#include "hal.h"
+
+#include "reading.h"
+
+// Rolling window length in samples (SAMPLE_MS apart: 64 s at the default 2 s)
+static const uint8_t EDGE_WINDOW = 32;
+
+// Minimum and maximum of the last EDGE_WINDOW values. Two monotonic deques of
+// (sequence, value): a push drops the entries it dominates from the back and
+// the expired one from the front, so it is amortized O(1) with fixed memory.
+class WindowExtrema {
+public:
+  void reset();
+  void push(uint16_t value);
+
+  uint8_t size() const { return _filled; }
+  uint16_t min() const { return _min.entries[_min.head].value; }   // size() > 0
+  uint16_t max() const { return _max.entries[_max.head].value; }
+
+private:
+  struct Entry {
+    uint16_t seq;
+    uint16_t value;
+  };
+  // Ring of at most EDGE_WINDOW entries, front at head
+  struct Deque {
+    Entry entries[EDGE_WINDOW];
+    uint8_t head;
+    uint8_t count;
+  };
+
+  void pushBack(Deque& d, uint16_t value, bool keepBelow);
+
+  Deque _min = {};   // values ascending from the front
+  Deque _max = {};   // values descending from the front
+  uint16_t _seq = 0;
+  uint8_t _filled = 0;
+};
+
+// Streaming statistics of one SGP30 channel, in fixed point: an EWMA (Q8,
+// alpha = 2^-shift), the rolling min/max and the rate of change since the
+// previous sample. A spike starts when a sample is at least `rise` above the
+// EWMA of the samples before it while rising at `ratePerMin` or faster; it
+// ends once the value is back within rise/2 of the EWMA, so a slow climb or a
+// plateau doesn't keep firing.
+class EdgeChannel {
+public:
+  struct Bands {
+    uint16_t rise;         // above the EWMA
+    uint16_t ratePerMin;   // rise per minute
+  };
+
+  // Without the window, which is rebuilt after a deep-sleep wake
+  struct State {
+    int32_t ewmaQ8;
+    uint32_t lastMs;
+    uint16_t last;
+    int16_t rate;
+    uint8_t primed;
+    uint8_t spiking;
+  };
+
+  EdgeChannel(const Bands& bands, uint8_t ewmaShift);
+
+  // Returns true if a spike starts with this sample
+  bool push(uint16_t value, uint32_t tsMs);
+
+  // Forget everything (the sensor stopped delivering)
+  void reset();
+
+  uint16_t ewma() const { return (uint16_t)((_state.ewmaQ8 + 128) >> 8); }
+  int16_t rate() const { return _state.rate; }
+  const WindowExtrema& window() const { return _window; }
+
+  const State& state() const { return _state; }
+  void restore(const State& s) { _state = s; }
+
+private:
+  Bands _bands;
+  uint8_t _shift;
+  State _state = {};
+  WindowExtrema _window;
+};
+
+// Edge analytics of TVOC and eCO2, computed per sample so the server gets
+// trends and events without scanning raw rows: fills Reading::stats, and a
+// spike sets its READING_ANOMALY_* bit (the report filter then reports the
+// sample whatever its deadbands). No spikes are raised during warm-up, when
+// the SGP30 values are still settling.
+class EdgeStats {
+public:
+  struct State {
+    EdgeChannel::State tvoc;
+    EdgeChannel::State eco2;
+  };
+
+  EdgeStats(const EdgeChannel::Bands& tvoc, const EdgeChannel::Bands& eco2, uint8_t ewmaShift);
+
+  // r.tvoc and r.eco2 only count when sgpValid; otherwise the statistics restart
+  void offer(Reading& r, bool sgpValid);
+
+  uint32_t anomalies() const { return _anomalies; }   // spikes since boot
+
+  State state() const { return {_tvoc.state(), _eco2.state()}; }
+  void restore(const State& s);
+
+private:
+  EdgeChannel _tvoc;
+  EdgeChannel _eco2;
+  uint32_t _anomalies = 0;
+};
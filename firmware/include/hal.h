@@ -0,0 +1,38 @@
+#pragma once
+
+// Portability layer for the platform-independent pipeline code (codec, JSON,
+// conditioning, report filter). On the device this is just Arduino.h; the
+// native PlatformIO env (benchmarks and trace replay) gets the few Arduino
+// helpers those modules use from the C++ standard library instead.
+#ifdef ARDUINO
+
+#include <Arduino.h>
+
+#else
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+
+template <typename T, typename L, typename H>
+constexpr T constrain(T v, L lo, H hi) {
+  return v < (T)lo ? (T)lo : (v > (T)hi ? (T)hi : v);
+}
+
+// D1 mini pin names referenced by config.h
+static const uint8_t D4 = 2;
+static const uint8_t D6 = 12;
+static const uint8_t D7 = 13;
+
+#endif
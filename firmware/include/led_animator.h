@@ -0,0 +1,146 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+
+#include "led_color.h"
+
+// How the AQ state is drawn across the strip
+enum class LedMode : uint8_t {
+  Solid,        // every pixel shows the AQ color
+  Bar,          // bar graph of the AQ index, lit pixels in the AQ color
+  GradientBar,  // bar graph, each pixel colored by its position on the AQ ramp
+};
+
+// Fixed-rate NeoPixel renderer, polled from loop() independently of SAMPLE_MS.
+// Targets cross-fade over fadeMs and the warm-up pulse is rendered per frame.
+// Frames are diffed against the last one shown: WS2812 writes disable
+// interrupts (~30 µs per pixel), so show() only runs when a pixel changed.
+template <uint16_t N>
+class LedAnimator {
+public:
+  // colorAt maps an AQ index (0..100) to a color; used by GradientBar
+  LedAnimator(Adafruit_NeoPixel& leds, LedMode mode, uint16_t frameMs, uint16_t fadeMs,
+              uint32_t (*colorAt)(uint8_t))
+    : _leds(leds), _mode(mode), _frameMs(frameMs), _fadeMs(fadeMs), _colorAt(colorAt) {}
+
+  // Brightness is applied here and by setBrightness(); otherwise only pixel values change.
+  // Without clear the strip keeps showing what it latched before (deep-sleep wake).
+  void begin(uint8_t brightness, bool clear) {
+    _leds.begin();
+    _leds.setBrightness(brightness);
+    if (clear) {
+      _leds.clear();
+      _leds.show();
+    }
+    for (uint16_t i = 0; i < N; i++) _shown[i] = 0;
+  }
+
+  // Rescale the strip (remote config); every pixel is rewritten on the next frame
+  void setBrightness(uint8_t brightness) {
+    if (brightness == _leds.getBrightness()) return;
+    _leds.setBrightness(brightness);
+    for (uint16_t i = 0; i < N; i++) _shown[i] = UINT32_MAX;
+  }
+
+  // New AQ color and index (0..100); fades from whatever is currently displayed,
+  // the warm-up pulse included (from its current frame, every pixel lit)
+  void setTarget(uint32_t rgb, uint8_t level, uint32_t nowMs) {
+    bool pulsing = _pulse;
+    _pulse = false;
+    if (!pulsing && rgb == _toRgb && level == _toLevel) return;
+    _fromRgb = pulsing ? pulsingBlueAt(nowMs) : currentRgb(nowMs);
+    _fromLevel = pulsing ? 100 : currentLevel(nowMs);
+    _toRgb = rgb;
+    _toLevel = min<uint8_t>(level, 100);
+    _fadeStartMs = nowMs;
+  }
+
+  // Warm-up: pulsing blue on every pixel until the next setTarget()
+  void setPulse() { _pulse = true; }
+
+  // Render a frame when one is due
+  void poll(uint32_t nowMs) {
+    if (nowMs - _lastFrameMs < _frameMs) return;
+    _lastFrameMs = nowMs;
+
+    uint32_t frame[N];
+    render(nowMs, frame);
+
+    bool changed = false;
+    for (uint16_t i = 0; i < N; i++) {
+      if (frame[i] == _shown[i]) continue;
+      _shown[i] = frame[i];
+      _leds.setPixelColor(i, frame[i]);
+      changed = true;
+    }
+    _frames++;
+    if (!changed) return;
+    _leds.show();
+    _shows++;
+  }
+
+  // Nothing will change until the next target: callers may idle longer than a frame
+  bool idle(uint32_t nowMs) const { return !_pulse && nowMs - _fadeStartMs >= _fadeMs; }
+
+  uint32_t frames() const { return _frames; }
+  uint32_t shows() const { return _shows; }
+
+private:
+  // Fade progress 0..256
+  uint32_t progress(uint32_t nowMs) const {
+    uint32_t t = nowMs - _fadeStartMs;
+    return (_fadeMs == 0 || t >= _fadeMs) ? 256 : t * 256 / _fadeMs;
+  }
+
+  static uint8_t lerp8(uint8_t a, uint8_t b, uint32_t p) {
+    return (uint8_t)((a * (256 - p) + b * p) >> 8);
+  }
+
+  // Channel-wise blend of two 0x00RRGGBB colors
+  static uint32_t blend(uint32_t a, uint32_t b, uint32_t p) {
+    return packRgb(lerp8(a >> 16, b >> 16, p), lerp8(a >> 8, b >> 8, p), lerp8(a, b, p));
+  }
+
+  // Color scaled by 0..256
+  static uint32_t dim(uint32_t c, uint32_t scale) { return blend(0, c, scale); }
+
+  uint32_t currentRgb(uint32_t nowMs) const { return blend(_fromRgb, _toRgb, progress(nowMs)); }
+  uint8_t currentLevel(uint32_t nowMs) const { return lerp8(_fromLevel, _toLevel, progress(nowMs)); }
+
+  void render(uint32_t nowMs, uint32_t* frame) const {
+    if (_pulse || _mode == LedMode::Solid || N == 1) {
+      uint32_t c = _pulse ? pulsingBlueAt(nowMs) : currentRgb(nowMs);
+      for (uint16_t i = 0; i < N; i++) frame[i] = c;
+      return;
+    }
+
+    // Bar length in 1/100 pixel; the pixel at the tip is dimmed by its fraction
+    uint32_t rgb = currentRgb(nowMs);
+    uint32_t lit = (uint32_t)currentLevel(nowMs) * N;
+    for (uint16_t i = 0; i < N; i++) {
+      uint32_t c = (_mode == LedMode::GradientBar) ? _colorAt((uint8_t)((i + 1) * 100 / N)) : rgb;
+      uint32_t start = (uint32_t)i * 100;
+      uint32_t fill = lit <= start ? 0 : min<uint32_t>(lit - start, 100);
+      frame[i] = dim(c, fill * 256 / 100);
+    }
+  }
+
+  Adafruit_NeoPixel& _leds;
+  LedMode _mode;
+  uint16_t _frameMs;
+  uint16_t _fadeMs;
+  uint32_t (*_colorAt)(uint8_t);
+
+  uint32_t _fromRgb = 0;
+  uint32_t _toRgb = 0;
+  uint8_t _fromLevel = 0;
+  uint8_t _toLevel = 0;
+  uint32_t _fadeStartMs = 0;
+  bool _pulse = false;
+
+  uint32_t _shown[N];     // last frame written to the strip
+  uint32_t _lastFrameMs = 0;
+  uint32_t _frames = 0;
+  uint32_t _shows = 0;
+};
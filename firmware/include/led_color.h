@@ -0,0 +1,46 @@
+#pragma once
+
+#include "hal.h"
+
+// AQ index → LED color, precomputed at compile time (101 entries, 0..100).
+// Same ramp as before: green up to low, green→yellow up to high, yellow→red
+// above. Integer math throughout; entries are packed 0x00RRGGBB like
+// Adafruit_NeoPixel::Color().
+//
+//Index →
+//0    LOW       HIGH          100
+//|----|----------|------------|
+// G      G→Y        Y→R
+struct AqColorLut {
+  uint32_t rgb[101];
+};
+
+constexpr uint32_t packRgb(uint8_t r, uint8_t g, uint8_t b) {
+  return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+constexpr AqColorLut makeAqColorLut(uint8_t low, uint8_t high) {
+  AqColorLut lut = {};
+  for (int idx = 0; idx <= 100; idx++) {
+    if (idx <= low) {
+      lut.rgb[idx] = packRgb(0, 255, 0);
+    } else if (idx <= high) {
+      lut.rgb[idx] = packRgb((uint8_t)(255 * (idx - low) / (high - low)), 255, 0);
+    } else {
+      lut.rgb[idx] = packRgb(255, (uint8_t)(255 * (100 - idx) / (100 - high)), 0);
+    }
+  }
+  return lut;
+}
+
+// Warm-up pulse: blue triangle wave with a 1 s period, brightness 20..140
+inline uint32_t pulsingBlueAt(uint32_t nowMs) {
+  uint32_t phase = nowMs % 1000;                             // ms into the period
+  uint32_t tri = phase < 500 ? phase * 2 : 2000 - phase * 2;  // 0..1000
+  return packRgb(0, 0, (uint8_t)(20 + 120 * tri / 1000));
+}
+
+// Color for an AQ index (clamped to 100) from a LUT kept in flash
+inline uint32_t aqColorAt(const AqColorLut& lut, uint8_t idx) {
+  return pgm_read_dword(&lut.rgb[min<uint8_t>(idx, 100)]);
+}
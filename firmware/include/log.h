@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Serial log levels. LOG_LEVEL is set with -D in platformio.ini; messages
+// above it compile to nothing: dead code the compiler drops with its format
+// string, arguments never evaluated (still type-checked, so no unused warnings).
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1   // missing sensors, unusable filesystem
+#define LOG_LEVEL_WARN  2   // link losses, failed uploads, dropped data
+#define LOG_LEVEL_INFO  3   // connects, syncs, periodic reports
+#define LOG_LEVEL_DEBUG 4   // per-sample lines: reading JSON, publishes, batch POSTs
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+static const size_t LOG_BUFFER_BYTES = 1024;
+static const size_t LOG_LINE_MAX = 352;   // a reading's JSON plus some text
+
+// Non-blocking serial output. Lines are formatted on the stack (no String, no
+// heap) and appended to a RAM ring; poll() moves only as many bytes as the
+// UART FIFO has room for, so logging never waits for the 115200 baud line.
+// Lines that don't fit in the ring are dropped whole and counted.
+class AsyncLog {
+public:
+  void begin(HardwareSerial& uart) { _uart = &uart; }
+
+  void line(const char* text);   // text and a newline
+  void linef(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  // Feed the UART from the ring; call from loop()
+  void poll();
+  // Drain everything, blocking (before deep sleep or a restart)
+  void flush();
+
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  void put(const char* data, size_t len);
+
+  HardwareSerial* _uart = nullptr;
+  char _ring[LOG_BUFFER_BYTES];
+  size_t _head = 0;   // next byte to send
+  size_t _used = 0;
+  uint32_t _dropped = 0;
+};
+
+extern AsyncLog asyncLog;
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) asyncLog.linef(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) do { if (0) asyncLog.linef(__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) asyncLog.linef(__VA_ARGS__)
+#else
+#define LOG_WARN(...) do { if (0) asyncLog.linef(__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) asyncLog.linef(__VA_ARGS__)
+#else
+#define LOG_INFO(...) do { if (0) asyncLog.linef(__VA_ARGS__); } while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) asyncLog.linef(__VA_ARGS__)
+#define LOG_DEBUG_LINE(text) asyncLog.line(text)
+#else
+#define LOG_DEBUG(...) do { if (0) asyncLog.linef(__VA_ARGS__); } while (0)
+#define LOG_DEBUG_LINE(text) do { if (0) asyncLog.line(text); } while (0)
+#endif
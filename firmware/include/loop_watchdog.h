@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "profiler.h"
+
+// State machines the watchdog can reset on their own (instead of the device)
+enum class Watched : uint8_t {
+  Http,   // HttpsKeepAlive to the Worker (uploads, backfill, OTA)
+  Mqtt,   // MqttLink to HiveMQ
+  Count
+};
+
+// Software watchdog for loop() stages and the network state machines.
+//
+// Every instrumented stage step runs inside a WatchdogScope. A step that takes
+// longer than stallMs (a blocking connect or read inside a library) counts as
+// a stall of its stage. A timer also watches the step while it is still running
+// (library calls yield, so the timer fires) and notes the stage in RTC memory:
+// if the hardware watchdog then resets the chip, the next boot reports which
+// stage hung.
+//
+// supervise() is the per-machine check: a machine that has been active without
+// progress for longer than its limit is reported stuck (once), and the caller
+// aborts that machine only.
+class LoopWatchdog {
+public:
+  explicit LoopWatchdog(uint32_t stallMs);
+
+  // Report a watchdog reset from the previous boot and start the timer
+  void begin();
+
+  void enter(Stage stage);
+  void leave();
+
+  // True when machine has been active with no progress since progressMs for limitMs
+  bool supervise(Watched machine, bool active, uint32_t progressMs, uint32_t limitMs, uint32_t nowMs);
+
+  uint32_t stalls(Stage stage) const { return _stalls[(uint8_t)stage]; }
+  uint32_t resets(Watched machine) const { return _resets[(uint8_t)machine]; }
+  uint32_t hardResets() const { return _hardResets; }   // chip resets by a watchdog since power-on
+
+  static const char* name(Watched machine);
+
+private:
+  // Kept in RTC memory across watchdog resets
+  struct Record {
+    uint8_t stage;       // Stage::Count when no step was overdue
+    uint8_t reserved[3];
+    uint32_t runningMs;  // how long the overdue step had been running
+    uint32_t hardResets;
+  };
+
+  static void onTick(void* arg);
+  void tick();
+  void saveRecord(uint8_t stage, uint32_t runningMs);
+
+  uint32_t _stallMs;
+  volatile uint8_t _stage = (uint8_t)Stage::Count;   // step running now
+  volatile uint32_t _enteredMs = 0;
+  volatile bool _recorded = false;                    // overdue step written to RTC
+  uint32_t _stalls[(uint8_t)Stage::Count] = {};
+  uint32_t _resets[(uint8_t)Watched::Count] = {};
+  bool _stuck[(uint8_t)Watched::Count] = {};
+  uint32_t _hardResets = 0;
+};
+
+// Brackets one stage step (alongside its ScopedTimer)
+class WatchdogScope {
+public:
+  WatchdogScope(LoopWatchdog& watchdog, Stage stage) : _watchdog(watchdog) { _watchdog.enter(stage); }
+  ~WatchdogScope() { _watchdog.leave(); }
+
+private:
+  LoopWatchdog& _watchdog;
+};
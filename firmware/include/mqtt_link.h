@@ -0,0 +1,150 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecureBearSSL.h>
+#include <Adafruit_MQTT.h>
+#include <Adafruit_MQTT_Client.h>
+
+#include "tls_trust.h"
+
+// Readings queued for QoS1 delivery (copied, so callers can reuse their buffer).
+// Payloads share one byte pool, so small (binary) readings don't each reserve room
+// for the largest JSON one.
+static const uint8_t MQTT_OUTBOX_SLOTS = 8;
+static const size_t MQTT_OUTBOX_BYTES = 2048;
+static const size_t MQTT_PAYLOAD_MAX = 768;   // a telemetry part; JSON readings take up to READING_JSON_MAX
+static_assert(MQTT_PAYLOAD_MAX < MQTT_OUTBOX_BYTES / 2, "the outbox pool must hold a message while another waits");
+static const size_t MQTT_TOPIC_MAX = 80;
+// Largest message accepted on the subscribed topic (remote config); longer ones are dropped
+static const size_t MQTT_INBOX_MAX = 256;
+
+// HiveMQ connection as a cooperative state machine.
+// poll() does at most one bounded step per call: a connect attempt (after an
+// exponential backoff), one inbound packet, one outbound PUBLISH, or a
+// keepalive ping when the link has been idle.
+// publish() queues a QoS1 message: up to `window` are in flight at once,
+// PUBACKs are matched by packet id, and unacknowledged messages are resent
+// (DUP) after a reconnect. Nothing waits for the broker.
+// The broker is verified as trust says; the TLS session is cached so a
+// reconnect resumes it instead of repeating the full handshake.
+// An optional subscription (QoS1) is renewed after every CONNECT, so a
+// retained message on it arrives on each connect; the latest message is kept
+// for takeMessage() and acknowledged at once.
+class MqttLink {
+public:
+  enum class State : uint8_t {
+    Offline,     // no WiFi
+    Backoff,     // waiting before the next connect attempt
+    Connecting,  // next poll() performs the TLS + CONNECT handshake
+    Online,
+  };
+
+  MqttLink(const char* broker, uint16_t port, const char* user, const char* pass, const char* topic,
+           uint8_t window, TlsTrust& trust);
+
+  // Topic to subscribe to after each CONNECT (set before the first poll(); nullptr/"" = none)
+  void subscribe(const char* topic) { _subTopic = topic; }
+
+  void poll();
+
+  // Drop the connection and reconnect after the usual backoff (unacknowledged messages are resent)
+  void reset(const char* why);
+  bool publish(const uint8_t* payload, size_t len);   // QoS1 on the reading topic, false if the outbox is full
+  // Same, on another topic (telemetry); topic must outlive the message
+  bool publishTo(const char* topic, const uint8_t* payload, size_t len);
+
+  bool online() const { return _state == State::Online; }
+  State state() const { return _state; }
+  uint32_t lastRxMs() const { return _lastRxMs; }   // millis() of the last inbound byte (or the connect)
+  uint32_t reconnects() const { return _reconnects; }
+  bool takeHandshake(uint32_t& cycles);   // CPU cycles of the last connect (TLS + CONNACK), once per connect
+
+  // Latest message on the subscribed topic, once; a newer one replaces an untaken one
+  bool takeMessage(uint8_t* out, size_t cap, size_t& len);
+
+  uint8_t queued() const { return _count; }        // not yet acknowledged, in flight or waiting
+  uint8_t inFlight() const { return _inFlight; }
+  uint32_t acked() const { return _acked; }
+  uint32_t retransmits() const { return _retransmits; }
+  uint32_t rejected() const { return _rejected; }  // outbox full or link down
+
+private:
+  enum class SlotState : uint8_t { Free, Queued, InFlight, Acked };
+
+  struct Slot {
+    SlotState state;
+    bool dup;          // sent before: retransmission after a reconnect
+    uint16_t packetId;
+    uint16_t at;       // payload offset in _pool
+    uint16_t len;
+    uint32_t sentMs;
+    const char* topic;
+  };
+
+  // Inbound packet being assembled from whatever bytes are available
+  struct Inbound {
+    uint8_t header;      // 0 = waiting for a packet
+    uint8_t lenBytes;    // remaining-length bytes seen
+    bool lenDone;
+    uint32_t remaining;  // body bytes still to read
+    uint32_t multiplier;
+    uint32_t length;     // whole body
+    uint16_t stored;
+    uint8_t body[2 + MQTT_TOPIC_MAX + 2 + MQTT_INBOX_MAX];   // the rest of longer bodies is skipped
+  };
+
+  void connectNow();
+  void scheduleRetry(uint32_t nowMs);
+  void dropLink(uint32_t nowMs, const char* why);
+  bool writeAll(const uint8_t* data, size_t len);
+  bool sendPublish(Slot& slot, uint32_t nowMs);
+  bool sendNext(uint32_t nowMs);
+  void readInbound();
+  void handlePacket();
+  void handlePuback(uint16_t packetId);
+  void handlePublish();
+  bool sendSubscribe();
+  void requeueInFlight();
+  bool reserve(size_t len, uint16_t& at);
+  Slot& slotAt(uint8_t i) { return _slots[(_head + i) % MQTT_OUTBOX_SLOTS]; }
+
+  TlsTrust& _trust;
+  BearSSL::WiFiClientSecure _tls;
+  BearSSL::Session _session;
+  Adafruit_MQTT_Client _mqtt;
+  uint16_t _port;
+  const char* _topic;
+  uint8_t _window;
+  const char* _subTopic = nullptr;
+
+  State _state = State::Offline;
+  uint32_t _nextAttemptMs = 0;
+  uint32_t _backoffMs = 0;
+  uint32_t _lastTxMs = 0;       // last packet sent: the keepalive only needs a ping when idle
+  uint32_t _pingSentMs = 0;
+  uint32_t _lastRxMs = 0;
+  bool _pingPending = false;
+  uint32_t _reconnects = 0;
+  uint32_t _handshakeCycles = 0;
+  bool _handshakeTimed = false;
+
+  // Outbox ring: slots _head.._head+_count-1 in publish order
+  Slot _slots[MQTT_OUTBOX_SLOTS];
+  uint8_t _head = 0;
+  uint8_t _count = 0;
+  uint8_t _inFlight = 0;
+  // Payload pool, used FIFO like the slots: the oldest payload starts at
+  // slotAt(0).at, the next one goes at _poolTail, wrapping to 0 when the end is short
+  uint8_t _pool[MQTT_OUTBOX_BYTES];
+  uint16_t _poolTail = 0;
+  bool _poolWrapped = false;   // _poolTail is behind the oldest payload
+  uint16_t _nextPacketId = 1;
+  Inbound _in = {};
+  uint8_t _inbox[MQTT_INBOX_MAX];
+  uint16_t _inboxLen = 0;
+  bool _inboxReady = false;
+
+  uint32_t _acked = 0;
+  uint32_t _retransmits = 0;
+  uint32_t _rejected = 0;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "reading_codec.h"
+
+// Store-and-forward queue for readings the Worker couldn't take, kept in LittleFS.
+// Binary records (reading_codec.h) are appended to fixed-size segment files
+// /q7/<seq>, one READING_BIN_LEN slot per record so a segment can be seeked by
+// record index; when maxSegments are in use the oldest is deleted, so the log is a
+// circular buffer of whole segments. Writes are batched by the caller (one
+// append per batch, never per sample) and the read cursor is only persisted
+// while draining, which keeps flash wear proportional to outage length.
+// Logs left by an older record layout (their own directory and stride: /q6 and
+// before, see OFFLINE_LEGACY) are drained first, as they are: the server decodes
+// every record version.
+class OfflineLog {
+public:
+  OfflineLog(uint16_t segmentRecords, uint8_t maxSegments);
+
+  // Mount the filesystem (formatting it if unreadable) and recover the log state
+  bool begin();
+
+  // Append count records, each in a READING_BIN_LEN slot
+  bool append(const uint8_t* records, size_t count);
+
+  // Copy up to maxRecords of the oldest records into out (sized for maxRecords
+  // current records) without consuming them. Returns the number of records
+  // copied (never spans two segments) and their length in bytes: the records
+  // are packed back to back, as the Worker takes them. An oldest segment
+  // with nothing left to read (its write failed) is dropped on the way.
+  size_t peek(uint8_t* out, size_t maxRecords, size_t& bytes);
+
+  // Discard the n records returned by the last peek() (after they were delivered).
+  // A no-op if append() overwrote their segment in the meantime: they were
+  // counted as overwritten then, and the records now oldest weren't sent.
+  void consume(size_t n);
+
+  uint32_t pending() const { return _pending + _legacyPending; }
+  uint32_t overwritten() const { return _overwritten; }
+
+private:
+  void removeDir(const char* path, const char* why);
+  bool openLegacy();
+  bool oldestLegacySegment(uint32_t& seq, uint32_t& records) const;
+  void consumeLegacy(size_t n);
+  void segmentPath(uint32_t seq, char* out, size_t cap) const;
+  uint32_t segmentRecords(uint32_t seq) const;
+  uint32_t dropOldest();
+  void saveCursor();
+
+  uint16_t _segmentRecords;
+  uint8_t _maxSegments;
+  bool _mounted = false;
+
+  // Segments _firstSeq.._lastSeq exist when _segments > 0
+  uint32_t _firstSeq = 0;
+  uint32_t _lastSeq = 0;
+  uint8_t _segments = 0;
+  uint16_t _lastFill = 0;     // records in the newest segment
+  uint16_t _readOffset = 0;   // records already delivered from the oldest segment
+  uint32_t _peekSeq = 0;      // segment the last peek() read
+
+  uint32_t _pending = 0;
+
+  // Older-layout log being drained (index into the legacy table, -1 = none)
+  int8_t _legacy = -1;
+  uint32_t _legacySeq = 0;         // its oldest segment
+  uint32_t _legacyRecords = 0;     // records in that segment
+  uint16_t _legacyOffset = 0;      // already delivered from it
+  uint32_t _legacyPending = 0;     // undelivered in the whole legacy log
+  uint32_t _overwritten = 0;  // undelivered records lost to segment reuse
+};
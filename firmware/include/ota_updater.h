@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+#include <bearssl/bearssl_hash.h>
+
+#include "https_keepalive.h"
+
+// Set per build (platformio.ini); reported in update checks and kept as the last good version
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "dev"
+#endif
+
+static const size_t OTA_VERSION_MAX = 16;
+
+// HTTPS firmware updates from the Cloudflare deployment, over the Worker connection.
+//
+// Every checkIntervalMs (and once after boot; 0: never) GET /api/firmware asks for a
+// newer image; the answer is one line "<version> <path> <size> <sha256>", or
+// 204 when up to date. The image is streamed from the HTTP response into the
+// OTA flash area (Updater buffers one flash sector, never the image) and hashed
+// on the way; it is only committed, for eboot to copy over the sketch at the
+// next boot, once size and SHA-256 match. The caller then saves its state and restarts.
+//
+// The ESP8266 has a single application slot, so rolling back means installing
+// the last confirmed version again. A new image is on trial until confirm()
+// (it came up and published); one that resets trialBoots times or isn't
+// confirmed within confirmMs is marked failed, never installed again, and the
+// previous version is requested instead.
+class OtaUpdater {
+public:
+  enum class Phase : uint8_t {
+    Idle,
+    Checking,     // GET /api/firmware
+    Downloading,  // image streaming into flash
+    Ready,        // image committed: restart to boot it
+  };
+
+  OtaUpdater(HttpsKeepAlive& http, const char* deviceId, uint32_t checkIntervalMs,
+             uint32_t confirmMs, uint8_t trialBoots);
+
+  // Load the trial state (LittleFS must be mounted). coldBoot is false after a
+  // deep-sleep wake, which doesn't count as a trial boot.
+  void begin(bool coldBoot);
+
+  // One bounded step. Starts a check when due and the connection is free (the
+  // caller shouldn't start uploads while busy()); nowMs is on the virtual clock.
+  void poll(uint32_t nowMs);
+
+  // The running image works: make it the version to roll back to
+  void confirm();
+
+  bool busy() const { return _phase == Phase::Checking || _phase == Phase::Downloading; }
+  bool restartPending() const { return _phase == Phase::Ready; }
+  bool onTrial() const { return _onTrial; }
+  Phase phase() const { return _phase; }
+
+private:
+  // Persisted in LittleFS; versions are NUL-terminated
+  struct TrialState {
+    uint32_t magic;
+    char good[OTA_VERSION_MAX];     // last confirmed version
+    char trial[OTA_VERSION_MAX];    // installed, not confirmed yet
+    char failed[OTA_VERSION_MAX];   // rejected on trial, not installed again
+    uint8_t boots;                  // boots of the trial image so far
+    uint8_t reserved[3];
+    uint32_t crc;
+  };
+
+  static bool onManifest(void* ctx, const uint8_t* data, size_t len);
+  static bool onImage(void* ctx, const uint8_t* data, size_t len);
+
+  void startCheck();
+  bool parseManifest();
+  void startDownload();
+  bool writeImage(const uint8_t* data, size_t len);
+  void finishDownload(int status);
+  void rejectTrial(const char* why);
+  void scheduleCheck(uint32_t nowMs, uint32_t afterMs);
+  void saveState();
+
+  HttpsKeepAlive& _http;
+  const char* _deviceId;
+  uint32_t _checkIntervalMs;
+  uint32_t _confirmMs;
+  uint8_t _trialBoots;
+
+  TrialState _state;
+  bool _onTrial = false;
+  bool _rollback = false;          // next check asks for _state.good
+  Phase _phase = Phase::Idle;
+  bool _checkNow = true;           // first check as soon as the network is up
+  uint32_t _nextCheckMs = 0;
+
+  // Check response: "<version> <path> <size> <sha256hex>"
+  char _path[128];
+  char _manifest[OTA_VERSION_MAX + sizeof(_path) + 80];
+  size_t _manifestLen = 0;
+
+  // Download in progress
+  char _version[OTA_VERSION_MAX];
+  uint32_t _size = 0;
+  uint32_t _written = 0;
+  uint8_t _expected[32];
+  br_sha256_context _sha;
+  uint8_t _lastByte = 0;           // held back so a bad image can still be abandoned
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "sensor_driver.h"
+
+// Plantower PMS5003 particulate sensor on a UART (9600 Bd, SoftwareSerial on
+// the D1 mini: the hardware UART carries the logs). Put in passive mode at
+// probe, so it only sends a frame when asked: start() sends the 7-byte request
+// (~7 ms bit-banged) and collect() parses the 32-byte answer once it has
+// arrived in the receive buffer. The fan runs continuously; readings settle
+// ~30 s after power-on.
+class Pms5003 : public SensorDriver {
+public:
+  explicit Pms5003(Stream& uart);
+
+  bool probe() override;
+  bool start() override;
+  SensorStep collect(int32_t* values) override;
+
+private:
+  void send(uint8_t cmd, uint16_t data);
+  void drain();
+
+  Stream& _uart;
+  uint8_t _waits = 0;   // Again steps for the frame in progress
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "edge_stats.h"
+#include "reading_codec.h"
+#include "report_filter.h"
+#include "scheduler.h"
+#include "timekeeper.h"
+
+// Operating modes for mains vs battery units (POWER_MODE in config.h)
+enum class PowerMode : uint8_t {
+  AlwaysOn,    // radio and CPU always on (mains powered)
+  ModemSleep,  // CPU samples on schedule; radio only on for batched upload windows
+  DeepSleep,   // deep sleep between samples; radio only on wakes that upload
+};
+
+// Readings carried across deep sleep in RTC memory (binary records; more go to the offline log)
+static const uint8_t SLEEP_STASH_RECORDS = 2;
+
+// Time accounting for the power/latency budget report
+struct PowerStats {
+  uint32_t awakeMs;    // CPU running
+  uint32_t radioMs;    // radio powered
+  uint32_t sleepMs;    // deep sleep
+  uint32_t windows;    // upload windows opened
+  uint32_t latencySumMs;  // reading age at successful upload, summed
+  uint32_t latencyCount;
+};
+
+// State that must survive deep sleep (stored in RTC memory)
+struct SleepState {
+  uint32_t uptimeMs;        // virtual time since power-on at the next wake
+  uint32_t deadlines[Scheduler::MAX_TASKS];  // sampling task schedule, on the virtual clock
+  uint16_t baselineEco2;
+  uint16_t baselineTvoc;
+  uint8_t hasBaseline;
+  uint8_t aqBand;
+  uint8_t stashCount;
+  uint8_t radioOnWake;
+  uint32_t nextWindowMs;    // earliest next upload window (after a failed one)
+  uint32_t warmupMs;        // warm-up length chosen at power-on
+  uint32_t baselineSavedMs; // SgpBaseline snapshot schedule
+  uint8_t baselineTrusted;
+  Timekeeper::State clock;  // SNTP sync point and drift: epoch stamps stay valid while asleep
+  ReportFilter::State report;  // last report and the suppressed window
+  EdgeStats::State edge;    // EWMA and rate (the min/max window restarts on every wake)
+  uint8_t anomalyDue;       // a spike awaits its upload window
+  PowerStats stats;
+  uint8_t stash[SLEEP_STASH_RECORDS * READING_BIN_LEN];
+};
+
+// Duty-cycling and the virtual clock.
+// millis() restarts after every deep sleep, so uptimeMs() adds the time slept
+// and timestamps, warm-up and batching stay monotonic across sleeps.
+class PowerManager {
+public:
+  explicit PowerManager(PowerMode mode);
+
+  // Restores SleepState after a deep-sleep wake; call first in setup()
+  void begin();
+
+  PowerMode mode() const { return _mode; }
+  bool wokeFromSleep() const { return _woke; }
+  bool radioAvailable() const { return _radioAvailable; }
+  uint32_t uptimeMs() const { return _state.uptimeMs + millis(); }
+
+  // Persistent fields for the caller to read after begin() and fill before deepSleep()
+  SleepState& state() { return _state; }
+
+  // Radio power accounting (the caller switches the radio)
+  void radioOn(uint32_t nowMs);
+  void radioOff(uint32_t nowMs);
+  bool radioIsOn() const { return _radioOn; }
+
+  void noteUploadLatency(uint32_t ageMs);
+
+  // Save state and deep sleep for ms; the radio is only calibrated on wake if asked. Never returns.
+  void deepSleep(uint32_t ms, bool radioOnWake);
+
+  // Power/latency budget on serial, every intervalMs
+  void report(uint32_t nowMs, uint32_t intervalMs);
+
+private:
+  void accountAwake(uint32_t nowMs);
+
+  PowerMode _mode;
+  SleepState _state;
+  bool _woke = false;
+  bool _radioAvailable = true;
+  bool _radioOn = true;
+  uint32_t _radioSinceMs = 0;
+  uint32_t _awakeSinceMs = 0;
+  uint32_t _lastReportMs = 0;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Hot-path stages instrumented in loop()
+enum class Stage : uint8_t {
+  Loop,      // one loop() pass, excluding sleep/idle
+  I2c,       // sensor triggers and readouts
+  Reading,   // conditioning + serial/MQTT/queue of one reading
+  Led,       // animation frame (including leds.show())
+  Wifi,      // WifiSupervisor::poll()
+  Mqtt,      // MqttLink::poll() (connects, pings, inbound)
+  Http,      // Worker upload step (TLS connect, request, response)
+  Tls,       // TLS connects alone, both links (MQTT includes the CONNACK wait)
+  Count
+};
+
+// Latency histogram buckets: 4× steps, <16 µs, <64 µs, ... <1.05 s, and ≥1.05 s
+static const uint8_t PROFILE_BUCKETS = 10;
+
+struct StageStats {
+  uint32_t n;
+  uint32_t sumUs;
+  uint32_t maxUs;
+  uint32_t hist[PROFILE_BUCKETS];
+};
+
+// Fixed-bucket latency statistics per stage, from the CPU cycle counter.
+// record() is a handful of integer ops, cheap enough for every loop() pass;
+// stats cover the window since the last reset().
+class Profiler {
+public:
+  Profiler() { reset(); }
+
+  void record(Stage stage, uint32_t cycles);
+  void reset();
+
+  const StageStats& stats(Stage stage) const { return _stats[(uint8_t)stage]; }
+
+  // Upper bound of the bucket holding the pct-th percentile (0 if no samples)
+  uint32_t percentileUs(Stage stage, uint8_t pct) const;
+
+  // Heap low-water mark over the window, sampled by noteHeap()
+  void noteHeap();
+  uint32_t minFreeHeap() const { return _minFreeHeap; }
+
+  static const char* name(Stage stage);
+  static uint32_t bucketLimitUs(uint8_t bucket);   // exclusive upper edge; UINT32_MAX for the last
+
+private:
+  StageStats _stats[(uint8_t)Stage::Count];
+  uint32_t _minFreeHeap = UINT32_MAX;
+};
+
+// Times the enclosing scope into one stage
+class ScopedTimer {
+public:
+  ScopedTimer(Profiler& profiler, Stage stage)
+    : _profiler(profiler), _stage(stage), _start(ESP.getCycleCount()) {}
+  ~ScopedTimer() { _profiler.record(_stage, ESP.getCycleCount() - _start); }
+
+private:
+  Profiler& _profiler;
+  Stage _stage;
+  uint32_t _start;
+};
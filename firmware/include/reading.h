@@ -0,0 +1,54 @@
+#pragma once
+
+#include "hal.h"
+
+#include "sensor_fields.h"
+
+// Summary of the samples a report stands for (report-by-exception, see
+// report_filter.h): the suppressed samples since the previous report plus this one
+struct ReadingSpan {
+  uint16_t samples;   // 1 = just this sample
+  uint16_t tvocMin, tvocMean, tvocMax;
+  uint16_t eco2Min, eco2Mean, eco2Max;
+  float tMin, tMean, tMax;     // NAN if no valid temperature in the window
+  float rhMin, rhMean, rhMax;  // NAN if no valid humidity in the window
+};
+
+// Add-on sensor values at the time of the reading (sensor_registry.h); only
+// fields with a current value are present, in registry order
+static const uint8_t READING_EXTRA_MAX = 4;
+
+struct ReadingExtras {
+  uint8_t count;
+  SensorField field[READING_EXTRA_MAX];
+  int32_t value[READING_EXTRA_MAX];   // × 10^decimals of the field
+};
+
+// Edge analytics of TVOC and eCO2 at the time of the reading (edge_stats.h)
+struct ReadingStats {
+  uint8_t samples;    // in the rolling window; 0 = no valid SGP30 sample yet
+  uint16_t tvocEwma, tvocMin, tvocMax;   // ppb; min/max over the rolling window
+  uint16_t eco2Ewma, eco2Min, eco2Max;   // ppm
+  int16_t tvocRate, eco2Rate;            // change since the previous sample, per minute
+  uint8_t anomalies;  // READING_ANOMALY_* of spikes that started with this sample
+};
+
+static const uint8_t READING_ANOMALY_TVOC_SPIKE = 0x01;
+static const uint8_t READING_ANOMALY_ECO2_SPIKE = 0x02;
+
+// One conditioned sample, as emitted over serial/MQTT and stored in D1
+struct Reading {
+  uint32_t tsMs;      // time since boot (ms)
+  uint16_t boot;      // cold boots so far (0 = unknown); with tsMs it identifies the reading
+  uint64_t epochMs;   // wall-clock time of the measurement (Unix ms), 0 if not yet known
+  float tC;           // temperature (°C), NAN if unavailable
+  float rh;           // relative humidity (%), NAN if unavailable
+  uint16_t tvoc;      // TVOC (ppb)
+  uint16_t eco2;      // eCO2 (ppm)
+  uint8_t aqIndex;    // AQ index (0–100)
+  uint8_t aqBand;     // color band of aqIndex (0 = green), stabilized by hysteresis
+  bool warmingUp;     // warm-up flag
+  ReadingSpan span;   // window summary when this reading is a report
+  ReadingExtras extra;  // add-on sensors (not summarized in span)
+  ReadingStats stats;   // rolling statistics and spikes
+};
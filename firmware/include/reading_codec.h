@@ -0,0 +1,249 @@
+#pragma once
+
+#include "hal.h"
+
+#include "reading.h"
+
+// Compact binary encoding of a Reading for MQTT, the offline log and RTC stashes
+// (server-side decoder: web/public/airq-payload.js).
+// Little-endian; the device is identified by the topic. Sections after the
+// header are only present when they carry something, as the flags say:
+//
+//  off size field
+//   0   1   version (READING_BIN_VERSION)
+//   1   1   flags: bit0 warming_up, bit1 t_c valid, bit2 rh valid,
+//               bit3 span t valid, bit4 span rh valid,
+//               bit5 span block, bit6 stats block, bit7 boot count present
+//   2   4   ts_ms (uint32)
+//   6   2   t_c × 100 (int16)
+//   8   2   rh × 100 (uint16)
+//  10   2   tvoc_ppb (uint16)
+//  12   2   eco2_ppm (uint16)
+//  14   1   aq_index (uint8)
+//  15   6   ts_epoch_ms (uint48, Unix ms; 0 = clock not synced)
+//  then, in this order:
+//       26  span (bit5; omitted for a single sample):
+//           samples (uint16); tvoc_ppb, eco2_ppm, t_c × 100 (int16), rh × 100
+//           min, mean, max (uint16 each)
+//       1   extra slot count n (0..READING_EXTRA_MAX, always present)
+//       5n  per slot: field id (uint8, sensor_fields.h), value × 10^decimals (int32)
+//       18  stats (bit6; omitted before the first SGP30 sample, edge_stats.h):
+//           samples in the rolling window (uint8), anomalies (READING_ANOMALY_*
+//           bits, uint8), tvoc_ppb and eco2_ppm ewma, window min, window max
+//           (uint16 each), tvoc_ppb and eco2_ppm change per minute (int16 each)
+//       2   boot count (bit7; uint16, omitted while unknown)
+//
+// Any layout change bumps the version; the decoder rejects versions it doesn't know.
+// Versions 1 to 6 had every section at a fixed offset (15, 21, 47, 48+5n, 66+5n
+// and 68+5n bytes) and are only decoded server-side.
+static const uint8_t READING_BIN_VERSION = 7;
+static const size_t READING_BIN_HEAD_LEN = 21;
+static const size_t READING_BIN_SPAN_LEN = 26;
+static const size_t READING_BIN_EXTRA_SLOT_LEN = 5;
+static const size_t READING_BIN_STATS_LEN = 18;
+static const size_t READING_BIN_BOOT_LEN = 2;
+// Longest record (every section, all extra slots): buffers and the fixed-size
+// slots of the offline log and RTC stash are sized for it
+static const size_t READING_BIN_LEN = READING_BIN_HEAD_LEN + READING_BIN_SPAN_LEN + 1 +
+                                      READING_BIN_EXTRA_SLOT_LEN * READING_EXTRA_MAX +
+                                      READING_BIN_STATS_LEN + READING_BIN_BOOT_LEN;
+
+static const uint8_t READING_FLAG_WARMING_UP = 0x01;
+static const uint8_t READING_FLAG_T_VALID    = 0x02;
+static const uint8_t READING_FLAG_RH_VALID   = 0x04;
+static const uint8_t READING_FLAG_SPAN_T_VALID  = 0x08;
+static const uint8_t READING_FLAG_SPAN_RH_VALID = 0x10;
+static const uint8_t READING_FLAG_SPAN  = 0x20;
+static const uint8_t READING_FLAG_STATS = 0x40;
+static const uint8_t READING_FLAG_BOOT  = 0x80;
+
+inline void putU16le(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+inline void putU32le(uint8_t* p, uint32_t v) {
+  putU16le(p, (uint16_t)v);
+  putU16le(p + 2, (uint16_t)(v >> 16));
+}
+
+// Scale by 100 with rounding, saturating to [lo, hi]
+inline int32_t scaledCenti(float v, int32_t lo, int32_t hi) {
+  float s = v * 100.0f;
+  int32_t q = (int32_t)(s < 0 ? s - 0.5f : s + 0.5f);
+  return q < lo ? lo : (q > hi ? hi : q);
+}
+
+// Returns the number of bytes written (at most READING_BIN_LEN), or 0 if cap is too small
+inline size_t encodeReadingBinary(const Reading& r, uint8_t* out, size_t cap) {
+  const ReadingSpan& sp = r.span;
+  const ReadingExtras& ex = r.extra;
+  const ReadingStats& st = r.stats;
+  uint8_t flags = 0;
+  if (r.warmingUp) flags |= READING_FLAG_WARMING_UP;
+  if (!isnan(r.tC)) flags |= READING_FLAG_T_VALID;
+  if (!isnan(r.rh)) flags |= READING_FLAG_RH_VALID;
+  if (sp.samples > 1) {
+    flags |= READING_FLAG_SPAN;
+    if (!isnan(sp.tMean)) flags |= READING_FLAG_SPAN_T_VALID;
+    if (!isnan(sp.rhMean)) flags |= READING_FLAG_SPAN_RH_VALID;
+  }
+  if (st.samples > 0 || st.anomalies) flags |= READING_FLAG_STATS;
+  if (r.boot) flags |= READING_FLAG_BOOT;
+
+  uint8_t n = ex.count < READING_EXTRA_MAX ? ex.count : READING_EXTRA_MAX;
+  size_t len = READING_BIN_HEAD_LEN + 1 + READING_BIN_EXTRA_SLOT_LEN * n;
+  if (flags & READING_FLAG_SPAN) len += READING_BIN_SPAN_LEN;
+  if (flags & READING_FLAG_STATS) len += READING_BIN_STATS_LEN;
+  if (flags & READING_FLAG_BOOT) len += READING_BIN_BOOT_LEN;
+  if (cap < len) return 0;
+
+  out[0] = READING_BIN_VERSION;
+  out[1] = flags;
+  putU32le(out + 2, r.tsMs);
+  putU16le(out + 6, (flags & READING_FLAG_T_VALID) ? (uint16_t)(int16_t)scaledCenti(r.tC, -32768, 32767) : 0);
+  putU16le(out + 8, (flags & READING_FLAG_RH_VALID) ? (uint16_t)scaledCenti(r.rh, 0, 65535) : 0);
+  putU16le(out + 10, r.tvoc);
+  putU16le(out + 12, r.eco2);
+  out[14] = r.aqIndex;
+  putU32le(out + 15, (uint32_t)r.epochMs);
+  putU16le(out + 19, (uint16_t)(r.epochMs >> 32));
+  uint8_t* p = out + READING_BIN_HEAD_LEN;
+
+  if (flags & READING_FLAG_SPAN) {
+    bool spanT = flags & READING_FLAG_SPAN_T_VALID;
+    bool spanRh = flags & READING_FLAG_SPAN_RH_VALID;
+    putU16le(p, sp.samples);
+    putU16le(p + 2, sp.tvocMin);
+    putU16le(p + 4, sp.tvocMean);
+    putU16le(p + 6, sp.tvocMax);
+    putU16le(p + 8, sp.eco2Min);
+    putU16le(p + 10, sp.eco2Mean);
+    putU16le(p + 12, sp.eco2Max);
+    putU16le(p + 14, spanT ? (uint16_t)(int16_t)scaledCenti(sp.tMin, -32768, 32767) : 0);
+    putU16le(p + 16, spanT ? (uint16_t)(int16_t)scaledCenti(sp.tMean, -32768, 32767) : 0);
+    putU16le(p + 18, spanT ? (uint16_t)(int16_t)scaledCenti(sp.tMax, -32768, 32767) : 0);
+    putU16le(p + 20, spanRh ? (uint16_t)scaledCenti(sp.rhMin, 0, 65535) : 0);
+    putU16le(p + 22, spanRh ? (uint16_t)scaledCenti(sp.rhMean, 0, 65535) : 0);
+    putU16le(p + 24, spanRh ? (uint16_t)scaledCenti(sp.rhMax, 0, 65535) : 0);
+    p += READING_BIN_SPAN_LEN;
+  }
+
+  *p++ = n;
+  for (uint8_t i = 0; i < n; i++) {
+    p[0] = (uint8_t)ex.field[i];
+    putU32le(p + 1, (uint32_t)ex.value[i]);
+    p += READING_BIN_EXTRA_SLOT_LEN;
+  }
+
+  if (flags & READING_FLAG_STATS) {
+    p[0] = st.samples;
+    p[1] = st.anomalies;
+    putU16le(p + 2, st.tvocEwma);
+    putU16le(p + 4, st.tvocMin);
+    putU16le(p + 6, st.tvocMax);
+    putU16le(p + 8, st.eco2Ewma);
+    putU16le(p + 10, st.eco2Min);
+    putU16le(p + 12, st.eco2Max);
+    putU16le(p + 14, (uint16_t)st.tvocRate);
+    putU16le(p + 16, (uint16_t)st.eco2Rate);
+    p += READING_BIN_STATS_LEN;
+  }
+
+  if (flags & READING_FLAG_BOOT) putU16le(p, r.boot);
+  return len;
+}
+
+inline uint16_t getU16le(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+inline uint32_t getU32le(const uint8_t* p) {
+  return getU16le(p) | ((uint32_t)getU16le(p + 2) << 16);
+}
+
+// Length of the record at in (from its flags and slot count), or 0 for an
+// unknown version, more extra slots than a Reading holds, or a record longer than len
+inline size_t readingBinaryLength(const uint8_t* in, size_t len) {
+  if (len < READING_BIN_HEAD_LEN + 1 || in[0] != READING_BIN_VERSION) return 0;
+  uint8_t flags = in[1];
+  size_t at = READING_BIN_HEAD_LEN + ((flags & READING_FLAG_SPAN) ? READING_BIN_SPAN_LEN : 0);
+  if (len < at + 1 || in[at] > READING_EXTRA_MAX) return 0;
+  size_t need = at + 1 + READING_BIN_EXTRA_SLOT_LEN * in[at];
+  if (flags & READING_FLAG_STATS) need += READING_BIN_STATS_LEN;
+  if (flags & READING_FLAG_BOOT) need += READING_BIN_BOOT_LEN;
+  return need <= len ? need : 0;
+}
+
+// Inverse of encodeReadingBinary; returns false for an unknown version or short input.
+// Absent sections decode as a single-sample span, no statistics and an unknown boot.
+inline bool decodeReadingBinary(const uint8_t* in, size_t len, Reading& r) {
+  if (readingBinaryLength(in, len) == 0) return false;
+
+  uint8_t flags = in[1];
+  r.tsMs = getU32le(in + 2);
+  r.tC = (flags & READING_FLAG_T_VALID) ? (int16_t)getU16le(in + 6) / 100.0f : NAN;
+  r.rh = (flags & READING_FLAG_RH_VALID) ? getU16le(in + 8) / 100.0f : NAN;
+  r.tvoc = getU16le(in + 10);
+  r.eco2 = getU16le(in + 12);
+  r.aqIndex = in[14];
+  r.epochMs = getU32le(in + 15) | ((uint64_t)getU16le(in + 19) << 32);
+  r.warmingUp = (flags & READING_FLAG_WARMING_UP) != 0;
+  const uint8_t* p = in + READING_BIN_HEAD_LEN;
+
+  ReadingSpan& sp = r.span;
+  if (flags & READING_FLAG_SPAN) {
+    bool spanT = flags & READING_FLAG_SPAN_T_VALID;
+    bool spanRh = flags & READING_FLAG_SPAN_RH_VALID;
+    sp.samples = getU16le(p);
+    sp.tvocMin = getU16le(p + 2);
+    sp.tvocMean = getU16le(p + 4);
+    sp.tvocMax = getU16le(p + 6);
+    sp.eco2Min = getU16le(p + 8);
+    sp.eco2Mean = getU16le(p + 10);
+    sp.eco2Max = getU16le(p + 12);
+    sp.tMin = spanT ? (int16_t)getU16le(p + 14) / 100.0f : NAN;
+    sp.tMean = spanT ? (int16_t)getU16le(p + 16) / 100.0f : NAN;
+    sp.tMax = spanT ? (int16_t)getU16le(p + 18) / 100.0f : NAN;
+    sp.rhMin = spanRh ? getU16le(p + 20) / 100.0f : NAN;
+    sp.rhMean = spanRh ? getU16le(p + 22) / 100.0f : NAN;
+    sp.rhMax = spanRh ? getU16le(p + 24) / 100.0f : NAN;
+    p += READING_BIN_SPAN_LEN;
+  } else {
+    sp.samples = 1;
+    sp.tvocMin = sp.tvocMean = sp.tvocMax = r.tvoc;
+    sp.eco2Min = sp.eco2Mean = sp.eco2Max = r.eco2;
+    sp.tMin = sp.tMean = sp.tMax = r.tC;
+    sp.rhMin = sp.rhMean = sp.rhMax = r.rh;
+  }
+
+  ReadingExtras& ex = r.extra;
+  ex.count = 0;
+  uint8_t n = *p++;
+  for (uint8_t i = 0; i < n; i++, p += READING_BIN_EXTRA_SLOT_LEN) {
+    if (p[0] == (uint8_t)SensorField::None) continue;
+    ex.field[ex.count] = (SensorField)p[0];
+    ex.value[ex.count] = (int32_t)getU32le(p + 1);
+    ex.count++;
+  }
+
+  ReadingStats& st = r.stats;
+  if (flags & READING_FLAG_STATS) {
+    st.samples = p[0];
+    st.anomalies = p[1];
+    st.tvocEwma = getU16le(p + 2);
+    st.tvocMin = getU16le(p + 4);
+    st.tvocMax = getU16le(p + 6);
+    st.eco2Ewma = getU16le(p + 8);
+    st.eco2Min = getU16le(p + 10);
+    st.eco2Max = getU16le(p + 12);
+    st.tvocRate = (int16_t)getU16le(p + 14);
+    st.eco2Rate = (int16_t)getU16le(p + 16);
+    p += READING_BIN_STATS_LEN;
+  } else {
+    st = {};
+  }
+
+  r.boot = (flags & READING_FLAG_BOOT) ? getU16le(p) : 0;
+  return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "hal.h"
+
+#include "json_writer.h"
+#include "reading.h"
+
+// Write one reading as a JSON object (the serial/MQTT/Worker format, see
+// README). epochMs == 0 is written as "ts_epoch_ms": null; the caller
+// back-stamps readings taken before the clock was known.
+void writeReadingJson(JsonWriter& w, const Reading& r, const char* deviceId);
+
+// Longest object writeReadingJson() writes for deviceId: with "boot", the
+// "stats", "spike" and "agg" objects, and extraFields add-on sensor fields.
+// deviceId is an array (DEVICE_ID in config.h) so its length is known here.
+template <size_t N>
+constexpr size_t readingJsonMax(const char (&deviceId)[N], uint8_t extraFields) {
+  (void)deviceId;
+  return 446 + (N - 1) + 20 * extraFields;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "hal.h"
+
+#include "aq_index.h"
+#include "edge_stats.h"
+#include "json_writer.h"
+#include "led_color.h"
+#include "reading.h"
+#include "report_filter.h"
+
+// LED color bands: green, yellow, red
+static const uint8_t AQ_BAND_COUNT = 3;
+
+// The per-reading path of emitReading() in main.cpp, shared with the native
+// harness so a replayed trace runs the device's code: AQ index and band, LED
+// color, edge statistics, report filter, JSON and binary encoding. The caller
+// owns the sensors, the LED and where the encodings go.
+class ReadingPipeline {
+public:
+  ReadingPipeline(AqBandClassifier<AQ_BAND_COUNT>& bands, const AqColorLut& colors,
+                  EdgeStats& edge, ReportFilter& filter, const char* deviceId);
+
+  // r comes with its timestamps, sensor values, warm-up flag and add-on fields.
+  // Sets the AQ index and band (held by hysteresis once warmed up), the edge
+  // statistics and the report span, writes r as JSON into json (every sample)
+  // and, for a report, as a binary record into bin unless bin is null.
+  // sgpValid is false when tvoc/eco2 are placeholders. Returns true if r is
+  // to be reported.
+  bool step(Reading& r, bool sgpValid, JsonWriter& json, uint8_t* bin = nullptr, size_t binCap = 0);
+
+  // LED target of the last step: the ramp color of its AQ index (unused while warming up)
+  uint32_t color() const { return _color; }
+  // Binary record written by the last step (0 if none, or bin was too small)
+  size_t binLength() const { return _binLen; }
+
+private:
+  AqBandClassifier<AQ_BAND_COUNT>& _bands;
+  const AqColorLut& _colors;
+  EdgeStats& _edge;
+  ReportFilter& _filter;
+  const char* _deviceId;
+  uint32_t _color = 0;
+  size_t _binLen = 0;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Settings that can be retuned at runtime; the defaults come from config.h
+struct DeviceSettings {
+  uint32_t rev;            // revision of the applied config message, 0 = compiled defaults
+  uint32_t sampleMs;       // SAMPLE_MS
+  uint32_t warmupMs;       // WARMUP_MS
+  uint32_t heartbeatMs;    // REPORT_HEARTBEAT_MS
+  uint32_t batchAgeMs;     // BATCH_MAX_AGE_MS
+  uint8_t batchSamples;    // BATCH_MAX_SAMPLES, at most the compiled value (buffers are sized for it)
+  uint8_t ledBrightness;   // LED_BRIGHTNESS
+  uint8_t aqLow;           // AQ_THRESHOLD_LOW
+  uint8_t aqHigh;          // AQ_THRESHOLD_HIGH
+  uint8_t aqHysteresis;    // AQ_HYSTERESIS_BAND
+};
+
+// Limits a message is checked against (besides aqLow < aqHigh < 100 and the
+// compiled batchSamples)
+static const uint32_t REMOTE_SAMPLE_MS_MIN = 1000;   // the SGP30 step rate
+static const uint32_t REMOTE_SAMPLE_MS_MAX = 600000;
+static const uint32_t REMOTE_WARMUP_MS_MAX = 3600000;
+static const uint32_t REMOTE_HEARTBEAT_MS_MAX = 86400000;
+static const uint32_t REMOTE_BATCH_AGE_MS_MIN = 1000;
+static const uint32_t REMOTE_BATCH_AGE_MS_MAX = 3600000;
+static const uint8_t REMOTE_HYSTERESIS_MAX = 20;
+
+// Remote configuration: a compact JSON object of unsigned integers, e.g.
+//   {"rev":7,"sample_ms":5000,"batch_samples":10,"led_brightness":20}
+// received on an MQTT topic (normally retained and fleet-wide). "rev" is
+// required and must be higher than the applied one; the retained copy
+// redelivered on every reconnect carries the applied rev and changes nothing. Omitted keys keep their current
+// value and unknown keys are skipped (newer tooling). The whole message is
+// validated against the limits before anything changes: it is applied
+// completely or not at all. Accepted settings are persisted in LittleFS and
+// loaded at boot, ahead of the compiled defaults.
+class RemoteConfig {
+public:
+  explicit RemoteConfig(const DeviceSettings& defaults);
+
+  // Load the stored settings (LittleFS must be mounted); false keeps the defaults
+  bool load();
+
+  // Parse and validate a message into next (a full copy of the current settings
+  // with the changes). Returns nullptr if it is acceptable, else the reason;
+  // next.rev equal to the applied rev means there is nothing to change.
+  const char* parse(const char* msg, size_t len, DeviceSettings& next) const;
+
+  // Make next current and persist it; false if it couldn't be written (it still applies)
+  bool accept(const DeviceSettings& next);
+
+  const DeviceSettings& settings() const { return _settings; }
+
+private:
+  struct Stored {
+    uint32_t magic;
+    DeviceSettings settings;
+    uint32_t crc;
+  };
+
+  const char* check(const DeviceSettings& s) const;
+
+  DeviceSettings _settings;
+  uint8_t _batchMax;
+};
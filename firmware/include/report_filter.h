@@ -0,0 +1,65 @@
+#pragma once
+
+#include "hal.h"
+
+#include "reading.h"
+
+// Report-by-exception: a sample is only published and uploaded when a field
+// moved by at least its deadband since the last report (add-on sensor fields:
+// the deadband in sensor_fields.h), the AQ index, warm-up flag or sensor
+// validity changed, a spike started (edge_stats.h), or the heartbeat interval
+// expired.
+// Suppressed samples are folded into min/mean/max, which the next report
+// carries in Reading::span, so nothing is lost but the redundant rows.
+class ReportFilter {
+public:
+  struct Deadbands {
+    uint16_t tvocPpb;
+    uint16_t eco2Ppm;
+    float tC;
+    float rh;
+  };
+
+  // Last report and the open window; kept in RTC memory across deep sleep
+  struct State {
+    uint32_t lastReportMs;
+    uint16_t lastTvoc, lastEco2;
+    float lastTC, lastRh;
+    uint8_t lastAqBand;
+    uint8_t lastWarmingUp;
+    uint8_t hasLast;
+    uint16_t n, tN, rhN;
+    uint16_t tvocMin, tvocMax, eco2Min, eco2Max;
+    uint32_t tvocSum, eco2Sum;
+    float tMin, tMax, tSum;
+    float rhMin, rhMax, rhSum;
+    ReadingExtras lastExtra;
+  };
+
+  // Deadbands of 0 with heartbeatMs 0 report every sample
+  ReportFilter(const Deadbands& bands, uint32_t heartbeatMs);
+
+  // Feed every sample. Returns true if r should be reported; r.span is set
+  // either way (the window summary, or just r itself when suppressed).
+  bool offer(Reading& r);
+
+  void setHeartbeat(uint32_t heartbeatMs) { _heartbeatMs = heartbeatMs; }
+
+  uint32_t reported() const { return _reported; }
+  uint32_t suppressed() const { return _suppressed; }
+
+  const State& state() const { return _state; }
+  void restore(const State& s) { _state = s; }
+
+private:
+  bool changed(const Reading& r) const;
+  void accumulate(const Reading& r);
+  void summarize(ReadingSpan& span) const;
+  void startWindow();
+
+  Deadbands _bands;
+  uint32_t _heartbeatMs;
+  State _state;
+  uint32_t _reported = 0;
+  uint32_t _suppressed = 0;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+
+// Fixed-capacity FIFO with no heap use. When full, push() overwrites the
+// oldest element so a long outage keeps the most recent N entries.
+template <typename T, size_t N>
+class RingBuffer {
+public:
+  // Returns false if an old element had to be dropped to make room
+  bool push(const T& item) {
+    bool dropped = false;
+    if (_count == N) {
+      _head = (_head + 1) % N;
+      _count--;
+      dropped = true;
+    }
+    _items[(_head + _count) % N] = item;
+    _count++;
+    return !dropped;
+  }
+
+  // i-th oldest element (0 = oldest); i must be < size()
+  const T& peek(size_t i) const { return _items[(_head + i) % N]; }
+
+  // Remove the n oldest elements
+  void drop(size_t n) {
+    if (n > _count) n = _count;
+    _head = (_head + n) % N;
+    _count -= n;
+  }
+
+  size_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+  bool full() const { return _count == N; }
+  static constexpr size_t capacity() { return N; }
+
+private:
+  T _items[N];
+  size_t _head = 0;
+  size_t _count = 0;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Small typed records in the ESP8266 RTC user memory (512 bytes, kept across
+// reset and deep sleep, lost on power-off). Each record is stored with a magic
+// tag and CRC32 so stale or uninitialised memory is rejected on load.
+
+// Slot offsets in 4-byte RTC blocks; keep each record inside its range
+enum RtcSlot : uint32_t {
+  RTC_SLOT_WIFI = 0,     // WifiSupervisor fast-connect cache (blocks 0..15)
+  RTC_SLOT_SLEEP = 16,   // PowerManager SleepState (blocks 16..122)
+  RTC_SLOT_WATCHDOG = 123,  // LoopWatchdog reset diagnostics (blocks 123..127)
+};
+
+inline uint32_t crc32(const uint8_t* data, size_t len, uint32_t crc = 0xFFFFFFFF) {
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return crc;
+}
+
+template <typename T>
+struct RtcRecord {
+  uint32_t magic;
+  uint32_t crc;
+  T data;
+};
+
+template <typename T>
+bool rtcLoad(RtcSlot slot, uint32_t magic, T& out) {
+  RtcRecord<T> rec;
+  static_assert(sizeof(rec) % 4 == 0, "RTC records must be a multiple of 4 bytes");
+  if (!ESP.rtcUserMemoryRead(slot, (uint32_t*)&rec, sizeof(rec))) return false;
+  if (rec.magic != magic || rec.crc != crc32((const uint8_t*)&rec.data, sizeof(T))) return false;
+  out = rec.data;
+  return true;
+}
+
+template <typename T>
+bool rtcSave(RtcSlot slot, uint32_t magic, const T& data) {
+  RtcRecord<T> rec;
+  rec.magic = magic;
+  rec.data = data;
+  rec.crc = crc32((const uint8_t*)&rec.data, sizeof(T));
+  return ESP.rtcUserMemoryWrite(slot, (uint32_t*)&rec, sizeof(rec));
+}
+
+inline void rtcClear(RtcSlot slot) {
+  uint32_t zero[2] = {0, 0};
+  ESP.rtcUserMemoryWrite(slot, zero, sizeof(zero));
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#include "sensor_driver.h"
+
+// Sensirion SCD40/SCD41 NDIR CO2 sensor on the shared I²C bus (0x62).
+// Runs in periodic mode, where the sensor measures every 5 s by itself; each
+// registry step asks whether a new result is ready (1 ms command) and only
+// then reads it out, so the driver never waits on the 5 s conversion.
+// Periodic mode survives ESP resets and deep sleep; probe() picks it up.
+class Scd4x : public SensorDriver {
+public:
+  explicit Scd4x(TwoWire& wire, uint8_t addr = 0x62);
+
+  bool probe() override;
+  bool start() override;
+  SensorStep collect(int32_t* values) override;
+
+private:
+  enum class Phase : uint8_t {
+    Ready,   // get_data_ready_status sent
+    Read,    // read_measurement sent
+  };
+
+  TwoWire& _wire;
+  uint8_t _addr;
+  Phase _phase = Phase::Ready;
+};
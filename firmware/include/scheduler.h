@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Cooperative fixed-rate task table, run from loop().
+// Deadlines advance by whole intervals from the previous deadline, not from
+// when the task actually ran, so lateness never accumulates into drift. A task
+// that falls more than an interval behind skips the lost slots (counted as
+// missed) and stays on its original phase.
+class Scheduler {
+public:
+  typedef void (*TaskFn)(uint32_t nowMs);
+
+  static const uint8_t MAX_TASKS = 6;
+
+  // Lateness of each run relative to its deadline
+  struct TaskStats {
+    uint32_t runs;
+    uint32_t missed;      // deadlines skipped because the loop was blocked too long
+    uint32_t lateSumMs;
+    uint32_t lateMaxMs;
+  };
+
+  // First run at firstMs; returns the task id, or -1 if the table is full
+  int8_t add(const char* name, uint32_t intervalMs, TaskFn fn, uint32_t firstMs);
+
+  // Run every task whose deadline has passed (each at most once per call)
+  void run(uint32_t nowMs);
+
+  // Time until the earliest deadline (0 if one is due)
+  uint32_t untilNext(uint32_t nowMs) const;
+
+  // Deadlines on the virtual clock, carried across deep sleep
+  uint32_t deadline(int8_t id) const { return _tasks[id].nextMs; }
+  void setDeadline(int8_t id, uint32_t ms) { _tasks[id].nextMs = ms; }
+
+  // New rate from the next deadline on (which keeps its time); 0 is ignored
+  void setInterval(int8_t id, uint32_t intervalMs) {
+    if (intervalMs > 0) _tasks[id].intervalMs = intervalMs;
+  }
+
+  const TaskStats& stats(int8_t id) const { return _tasks[id].stats; }
+
+  // One [SCHED] line per task on serial; stats restart afterwards
+  void report();
+
+private:
+  struct Task {
+    const char* name;
+    uint32_t intervalMs;
+    uint32_t nextMs;
+    TaskFn fn;
+    TaskStats stats;
+  };
+
+  Task _tasks[MAX_TASKS];
+  uint8_t _count = 0;
+};
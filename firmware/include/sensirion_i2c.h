@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Sensirion I²C framing shared by the SHT31, SGP30 and SCD4x: 16-bit commands,
+// and 16-bit words each followed by a CRC-8 byte. Only the transfers; callers
+// wait out command execution times themselves.
+
+// Sensirion CRC-8 (poly 0x31, init 0xFF) over one 16-bit word
+inline uint8_t sensirionCrc(uint16_t word) {
+  uint8_t crc = 0xFF;
+  uint8_t bytes[2] = {(uint8_t)(word >> 8), (uint8_t)word};
+  for (uint8_t b : bytes) {
+    crc ^= b;
+    for (int i = 0; i < 8; i++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+  }
+  return crc;
+}
+
+// Command with optional argument words; false on NACK
+inline bool sensirionCommand(TwoWire& wire, uint8_t addr, uint16_t cmd, const uint16_t* args = nullptr,
+                             uint8_t count = 0) {
+  wire.beginTransmission(addr);
+  wire.write((uint8_t)(cmd >> 8));
+  wire.write((uint8_t)cmd);
+  for (uint8_t i = 0; i < count; i++) {
+    wire.write((uint8_t)(args[i] >> 8));
+    wire.write((uint8_t)args[i]);
+    wire.write(sensirionCrc(args[i]));
+  }
+  return wire.endTransmission() == 0;
+}
+
+// Read count words; false on a short read or any CRC mismatch
+inline bool sensirionRead(TwoWire& wire, uint8_t addr, uint16_t* words, uint8_t count) {
+  uint8_t want = count * 3;
+  if (wire.requestFrom(addr, want) != want) {
+    while (wire.available()) wire.read();
+    return false;
+  }
+  bool ok = true;
+  for (uint8_t i = 0; i < count; i++) {
+    uint16_t w = (uint16_t)(wire.read() << 8);
+    w |= (uint8_t)wire.read();
+    if ((uint8_t)wire.read() != sensirionCrc(w)) ok = false;
+    words[i] = w;
+  }
+  return ok;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "sensor_fields.h"
+
+// Outcome of SensorDriver::collect()
+enum class SensorStep : uint8_t {
+  Done,        // new values written
+  Unchanged,   // no new measurement yet; the previous values still hold
+  Again,       // not complete (or another transfer was issued): collect() again after measureMs
+  Failed,      // no answer or corrupt data
+};
+
+// Timing and payload of an add-on sensor, fixed per driver
+struct SensorSpec {
+  const char* name;
+  uint32_t measureMs;         // from start() (or an Again) until collect() can read
+  uint32_t intervalMs;        // time between measurements, at least the sensor's update rate
+  const SensorField* fields;  // what collect() writes, in this order
+  uint8_t fieldCount;
+};
+
+// An add-on sensor driven by SensorRegistry. start() and collect() only run
+// short bus transfers and never wait for a conversion: the registry calls
+// collect() once measureMs has passed, and no other transfer of its sensors
+// runs in the same loop(). probe() runs at boot and while the sensor is
+// missing, and may block for a few ms.
+class SensorDriver {
+public:
+  explicit SensorDriver(const SensorSpec& spec) : _spec(spec) {}
+
+  const SensorSpec& spec() const { return _spec; }
+
+  // Detect and configure the sensor; false if it didn't answer
+  virtual bool probe() = 0;
+
+  // Trigger a measurement (or ask for the latest one); false on a bus error
+  virtual bool start() = 0;
+
+  // values has spec().fieldCount entries, × 10^decimals of each field
+  virtual SensorStep collect(int32_t* values) = 0;
+
+private:
+  const SensorSpec& _spec;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "hal.h"
+
+// Payload fields of the add-on sensors (sensor_registry.h). The ids are part of
+// the wire format (reading_codec.h, web/public/airq-payload.js): new fields are
+// appended, ids are never renumbered or reused.
+enum class SensorField : uint8_t {
+  None = 0,   // empty slot
+  Pm1 = 1,    // PM1.0, µg/m³ (PMS5003, atmospheric)
+  Pm25 = 2,   // PM2.5, µg/m³
+  Pm10 = 3,   // PM10, µg/m³
+  Co2 = 4,    // CO2, ppm (SCD4x NDIR)
+  Count
+};
+
+struct SensorFieldInfo {
+  const char* key;     // JSON key (also the D1 column name, once stored)
+  uint8_t decimals;    // values are carried × 10^decimals
+  int32_t deadband;    // report-by-exception threshold, in carried units
+};
+
+static const SensorFieldInfo SENSOR_FIELDS[] = {
+  {nullptr, 0, 0},
+  {"pm1_ugm3", 0, 5},
+  {"pm25_ugm3", 0, 5},
+  {"pm10_ugm3", 0, 10},
+  {"co2_ppm", 0, 50},
+};
+static_assert(sizeof(SENSOR_FIELDS) / sizeof(SENSOR_FIELDS[0]) == (size_t)SensorField::Count,
+              "one entry per sensor field");
+
+// Unknown ids (a newer record) map to the empty slot
+inline const SensorFieldInfo& sensorFieldInfo(SensorField field) {
+  uint8_t i = (uint8_t)field;
+  return SENSOR_FIELDS[i < (uint8_t)SensorField::Count ? i : 0];
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Latest SHT31 + SGP30 results; each sensor keeps its own timestamp
+struct SensorSample {
+  uint32_t shtMs;      // when the SHT31 conversion was triggered
+  bool shtValid;
+  float tC, rh;        // NAN unless shtValid
+  int32_t tCenti;      // same values in 0.01 °C / 0.01 %RH
+  int32_t rhCenti;
+  uint32_t sgpMs;      // when measure_iaq was sent
+  bool sgpValid;
+  uint16_t tvoc, eco2;
+};
+
+// Bits returned by SensorReader::poll()
+static const uint8_t SENSOR_SHT = 0x01;
+static const uint8_t SENSOR_SGP = 0x02;
+
+// Non-blocking readout of both sensors, polled from loop().
+// startSht() triggers an SHT31 single-shot measurement (temperature and
+// humidity in one conversion) and startSgp() the SGP30 measure_iaq step; they
+// run on independent schedules, convert in parallel, and poll() collects each
+// result once its conversion time has passed. Only the I²C transfers run
+// inline (~1 ms) instead of ~60 ms of library delays. Each new SHT31 reading
+// is written to the SGP30 as humidity compensation right after its next
+// measurement, so it never delays a measure_iaq.
+// The probe/init/baseline calls stay with the Adafruit drivers; don't issue
+// them while sgpBusy().
+class SensorReader {
+public:
+  SensorReader(TwoWire& wire, uint8_t shtAddr, uint8_t sgpAddr);
+
+  // Which sensors answered at boot
+  void enable(bool sht, bool sgp) { _shtOn = sht; _sgpOn = sgp; }
+
+  // Trigger a conversion; false if the sensor is absent or still busy (overrun)
+  bool startSht(uint32_t nowMs);
+  bool startSgp(uint32_t nowMs);
+
+  // Advance the readouts; returns SENSOR_* bits for results that completed
+  uint8_t poll(uint32_t nowMs);
+
+  const SensorSample& latest() const { return _sample; }
+
+  bool busy() const { return _shtPending || _sgp != SgpPhase::Idle; }
+  bool sgpBusy() const { return _sgp != SgpPhase::Idle; }
+  uint32_t errors() const { return _errors; }     // NACKs and CRC failures
+  uint32_t overruns() const { return _overruns; } // start while still converting
+
+private:
+  enum class SgpPhase : uint8_t {
+    Idle,
+    Measuring,   // measure_iaq running
+    Settling,    // set_humidity written, sensor not ready for the next command
+  };
+
+  bool command(uint8_t addr, uint16_t cmd, const uint16_t* args = nullptr, uint8_t count = 0);
+  bool readWords(uint8_t addr, uint16_t* words, uint8_t count);
+  void readSht();
+  void readSgp(uint32_t nowMs);
+
+  TwoWire& _wire;
+  uint8_t _shtAddr;
+  uint8_t _sgpAddr;
+  bool _shtOn = false;
+  bool _sgpOn = false;
+
+  bool _shtPending = false;
+  uint32_t _shtStartMs = 0;
+  SgpPhase _sgp = SgpPhase::Idle;
+  uint32_t _sgpStartMs = 0;
+
+  uint16_t _ahScaled = 0;        // absolute humidity, 8.8 fixed g/m³ (0 = compensation off)
+  bool _ahPending = false;       // not yet written to the SGP30
+  SensorSample _sample;
+  uint32_t _errors = 0;
+  uint32_t _overruns = 0;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "reading.h"
+#include "sensor_driver.h"
+
+// Add-on sensors (particulates, NDIR CO2, ...) beside the SHT31/SGP30 pair.
+//
+// Each driver declares its conversion time, interval and payload fields
+// (SensorSpec). poll() runs at most one bus transfer per call: a result that
+// is ready first, otherwise the start of a due measurement, so conversions of
+// all sensors overlap while loop() spends one short transfer on them at most.
+// Deadlines advance on a fixed grid like the Scheduler's; a start that finds
+// its sensor still converting counts as an overrun and waits for the next slot.
+//
+// fill() copies the current values into a Reading's extras, which the codec and
+// JSON writer serialize from the field table, so a new driver only adds fields.
+// A sensor that fails SENSOR_FAILURE_LIMIT times in a row is taken out until
+// reprobe() finds it again; its fields drop out of the readings meanwhile.
+class SensorRegistry {
+public:
+  static const uint8_t MAX_DRIVERS = 4;
+  static const uint8_t SENSOR_FAILURE_LIMIT = 3;
+
+  // Before begin(); false if the tables are full or the spec can't keep its interval
+  bool add(SensorDriver& driver);
+
+  // Probe every driver and schedule the first measurements
+  void begin(uint32_t nowMs);
+
+  // Probe the drivers that are out; true if one came back
+  bool reprobe(uint32_t nowMs);
+
+  // One transfer at most (see above)
+  void poll(uint32_t nowMs);
+
+  // Values no older than three intervals, in registration order
+  void fill(ReadingExtras& out, uint32_t nowMs) const;
+
+  bool busy() const;      // a conversion in flight
+  bool missing() const;   // a registered sensor is out
+
+  // Time until the next start is due (UINT32_MAX without sensors)
+  uint32_t untilNext(uint32_t nowMs) const;
+
+  uint32_t errors() const { return _errors; }
+  uint32_t overruns() const { return _overruns; }
+
+private:
+  enum class Phase : uint8_t {
+    Out,         // not found or stopped answering
+    Idle,
+    Measuring,   // waiting measureMs for collect()
+  };
+
+  struct Slot {
+    SensorDriver* driver;
+    Phase phase;
+    uint8_t firstValue;   // into _values
+    uint8_t failures;     // in a row
+    bool valid;
+    uint32_t nextMs;      // next start
+    uint32_t stepMs;      // last transfer
+    uint32_t updatedMs;   // last new values
+  };
+
+  void start(Slot& s, uint32_t nowMs);
+  void collect(Slot& s, uint32_t nowMs);
+  void fail(Slot& s);
+  void advance(Slot& s, uint32_t nowMs);
+
+  Slot _slots[MAX_DRIVERS];
+  uint8_t _count = 0;
+  uint8_t _fields = 0;
+  uint8_t _nextStart = 0;   // round-robin among due starts
+  int32_t _values[READING_EXTRA_MAX] = {};
+  uint32_t _errors = 0;
+  uint32_t _overruns = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_SGP30.h>
+
+// SGP30 IAQ baseline persistence in LittleFS.
+// The sensor needs ~12 h of operation to learn its baseline, and IAQinit()
+// discards it. Snapshots are written hourly once the baseline is trustworthy
+// and restored with setIAQBaseline() after IAQinit() on the next boot, so a
+// reboot or OTA update doesn't restart the learning period.
+class SgpBaseline {
+public:
+  explicit SgpBaseline(Adafruit_SGP30& sgp);
+
+  // Call after IAQinit() (LittleFS must be mounted). warmRestart is true when
+  // the sensor stayed powered across the reset; after a power-on the snapshot is
+  // only used when its age can be checked against wall-clock time.
+  // Returns true if a baseline was restored.
+  bool restore(bool warmRestart);
+
+  // Periodic snapshotting; algoMs is time since the IAQ algorithm started
+  void poll(uint32_t algoMs);
+
+  // Snapshot now, e.g. before an OTA restart (only once the baseline is trusted)
+  void save();
+
+  // Carry state across deep sleep (RAM is lost, the sensor's algorithm isn't)
+  void resume(bool trusted, uint32_t lastSaveMs) { _trusted = trusted; _lastSaveMs = lastSaveMs; }
+
+  bool restored() const { return _restored; }
+  bool trusted() const { return _trusted; }     // restored, or learned for 12 h
+  uint32_t lastSaveMs() const { return _lastSaveMs; }
+
+private:
+  struct Snapshot {
+    uint32_t magic;
+    uint16_t eco2;
+    uint16_t tvoc;
+    uint32_t savedEpoch;   // wall-clock seconds at save, 0 if unknown
+    uint32_t crc;
+  };
+
+  Adafruit_SGP30& _sgp;
+  bool _restored = false;
+  bool _trusted = false;
+  uint32_t _lastSaveMs = 0;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Wall-clock time from SNTP, mapped onto the firmware's uptime clock.
+// configTime() runs SNTP in the background (never blocks); each sync records a
+// (uptime, epoch) pair and the measured drift of the uptime clock, so any
+// uptime timestamp — including ones taken before the first sync and across
+// deep sleep — can be converted to epoch milliseconds.
+class Timekeeper {
+public:
+  // Persisted across deep sleep (system time doesn't survive it)
+  struct State {
+    uint64_t syncEpochMs;   // epoch at the last sync
+    uint32_t syncUptimeMs;  // uptime at the last sync
+    int32_t driftPpm;       // uptime clock error, + means uptime runs slow
+    uint32_t syncs;
+  };
+
+  // Start SNTP; syncs happen whenever WiFi is up
+  void begin(const char* server1, const char* server2);
+
+  // Pick up a completed sync; call regularly with the current uptime
+  void poll(uint32_t uptimeMs);
+
+  bool synced() const { return _state.syncs > 0; }
+
+  // Epoch ms for an uptime timestamp of this power cycle, or 0 before the first sync
+  uint64_t toEpochMs(uint32_t uptimeMs) const;
+
+  int32_t driftPpm() const { return _state.driftPpm; }
+  const State& state() const { return _state; }
+  void restore(const State& s) { _state = s; }
+
+private:
+  State _state = {0, 0, 0, 0};
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClientSecureBearSSL.h>
+
+// How a TLS client verifies one server, instead of setInsecure().
+//
+// A pinned public key (the server's SPKI, PEM) is the fast path: BearSSL
+// only checks that the server proves possession of that key, with no chain
+// walk, no signature checks on certificates and no clock, so a handshake
+// costs about what an unverified one did. Without a pin the certificate chain
+// is validated against the root CA, which needs the SNTP time. After
+// TLS_PIN_FAILURES handshakes in a row that BearSSL rejected for the key or
+// chain (e.g. the server rotated its key; DNS, TCP and timeouts don't count)
+// connects use the root CA for TLS_PIN_RETRY_MS, then the pin is tried again:
+// a flaky network can't turn pinning off. Key material is parsed from PROGMEM once, in begin(), into
+// long-lived heap objects; the roots are shared by every host using the same
+// PEM. The clients resume TLS sessions, so reconnects skip the certificate
+// step entirely and only full handshakes pay for verification.
+// TLS buffers are sized per server: the first connect probes for max
+// fragment length negotiation, and a server that supports it gets a 1 KB
+// receive buffer instead of the 16 KB a full-size record needs.
+class TlsTrust {
+public:
+  enum class Mode : uint8_t {
+    None,       // nothing configured: connects are refused
+    Pinned,     // server public key
+    RootCa,     // chain validated against the root CA(s)
+    Insecure,   // TLS_ALLOW_INSECURE, development only
+  };
+
+  static const uint8_t TLS_PIN_FAILURES = 2;
+  static const uint32_t TLS_PIN_RETRY_MS = 30UL * 60 * 1000;
+
+  // pinPem and caPem point to PROGMEM strings, "" when unused
+  TlsTrust(const char* host, PGM_P pinPem, PGM_P caPem, bool allowInsecure);
+
+  // Parse the PEM blocks; call once at boot (logs unusable ones)
+  void begin();
+
+  // Configure client for the next connect to port; false if the server can't be verified
+  bool apply(BearSSL::WiFiClientSecure& client, uint16_t port);
+
+  // Outcome of the connect after apply(); sslError is client.getLastSSLError()
+  void noteHandshake(bool ok, int sslError);
+
+  Mode mode() const { return _mode; }   // as configured
+  Mode active() const;                  // used for the next connect (RootCa while the pin is set aside)
+  static const char* name(Mode mode);
+
+private:
+  enum class Mfln : uint8_t {
+    Unknown,       // not probed yet
+    Unconfirmed,   // probe failed: unsupported, or the network was down
+    Supported,
+    Unsupported,   // probe failed and a connect then worked
+  };
+
+  void sizeBuffers(BearSSL::WiFiClientSecure& client, uint16_t port);
+
+  const char* _host;
+  PGM_P _pinPem;
+  PGM_P _caPem;
+  bool _allowInsecure;
+  BearSSL::PublicKey* _pin = nullptr;
+  BearSSL::X509List* _roots = nullptr;
+  Mode _mode = Mode::None;
+  uint8_t _pinFailures = 0;
+  bool _usedPin = false;             // the last apply() set the pinned key
+  bool _fallback = false;            // pin set aside until _retryPinMs
+  uint32_t _retryPinMs = 0;
+  Mfln _mfln = Mfln::Unknown;
+};
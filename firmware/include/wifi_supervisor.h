@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// Non-blocking WiFi connection supervisor, polled from loop().
+// The last good BSSID/channel (and optionally the DHCP lease) is cached in RTC
+// memory, so a reconnect after reset or deep sleep skips the channel scan and
+// DHCP. Failed attempts back off exponentially (with jitter) and the radio is
+// idled between attempts so a flapping AP doesn't burn CPU and power.
+class WifiSupervisor {
+public:
+  enum class State : uint8_t {
+    Idle,        // before begin(), or suspended
+    Connecting,  // association in progress (fast or full)
+    Connected,
+    Backoff,     // radio idle until the next attempt
+  };
+
+  WifiSupervisor(const char* ssid, const char* password, bool cacheStaticIp);
+
+  // Start the first association; returns immediately
+  void begin();
+
+  // Advance the state machine; cheap when nothing changes
+  void poll();
+
+  // Power the radio down (modem sleep) until resume(); poll() is then a no-op.
+  // resume() also performs begin() if it hasn't run yet.
+  void suspend();
+  void resume();
+
+  bool connected() const { return _state == State::Connected; }
+  State state() const { return _state; }
+  uint32_t reconnects() const { return _reconnects; }
+  uint32_t lastConnectMs() const { return _lastConnectMs; }  // duration of the last successful association
+
+private:
+  struct FastConnect {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t hasIp;
+    uint32_t ip, gateway, subnet, dns;
+  };
+
+  void startAttempt(uint32_t nowMs);
+  void onConnected(uint32_t nowMs);
+  void onFailed(uint32_t nowMs);
+
+  const char* _ssid;
+  const char* _password;
+  bool _cacheStaticIp;
+
+  State _state = State::Idle;
+  bool _begun = false;
+  FastConnect _cache;
+  bool _cacheValid = false;
+  bool _fastAttempt = false;
+  uint32_t _attemptStartMs = 0;
+  uint32_t _nextAttemptMs = 0;
+  uint32_t _backoffMs = 0;
+  uint32_t _reconnects = 0;
+  uint32_t _lastConnectMs = 0;
+};
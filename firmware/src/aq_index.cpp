@@ -0,0 +1,14 @@
+#include "aq_index.h"
+
+uint8_t tvocToIndex(uint16_t tvoc) {
+  if (tvoc <= 200) {
+    // 0..200 ppb → 0..60
+    return (uint8_t)(tvoc * 60 / 200);
+  }
+  if (tvoc <= 800) {
+    // 200..800 ppb → 60..90
+    return (uint8_t)(60 + (tvoc - 200) * 30 / 600);
+  }
+  // >800 ppb → clamp
+  return 100;
+}
@@ -0,0 +1,31 @@
+#include "boot_counter.h"
+
+#include <LittleFS.h>
+
+#include "log.h"
+
+static const char* BOOT_COUNT_PATH = "/boot_count";
+
+void BootCounter::begin(bool woke) {
+  uint16_t count = 0;
+  File f = LittleFS.open(BOOT_COUNT_PATH, "r");
+  if (f) {
+    if (f.read((uint8_t*)&count, sizeof(count)) != sizeof(count)) count = 0;
+    f.close();
+  }
+  if (woke && count != 0) {
+    _count = count;
+    return;
+  }
+
+  count = (count == UINT16_MAX) ? 1 : count + 1;
+  f = LittleFS.open(BOOT_COUNT_PATH, "w");
+  bool ok = f && f.write((const uint8_t*)&count, sizeof(count)) == sizeof(count);
+  if (f) f.close();
+  _count = ok ? count : 0;
+  if (ok) {
+    LOG_INFO("[BOOT] Boot %u", (unsigned)count);
+  } else {
+    LOG_WARN("[BOOT] Boot count not saved; readings go out without one");
+  }
+}
@@ -0,0 +1,106 @@
+#include "edge_stats.h"
+
+void WindowExtrema::reset() {
+  _min.head = _min.count = 0;
+  _max.head = _max.count = 0;
+  _seq = 0;
+  _filled = 0;
+}
+
+// Drop the back entries the new value makes irrelevant, then append it
+void WindowExtrema::pushBack(Deque& d, uint16_t value, bool keepBelow) {
+  // Entries that left the window
+  while (d.count > 0 && (uint16_t)(_seq - d.entries[d.head].seq) >= EDGE_WINDOW) {
+    d.head = (uint8_t)((d.head + 1) % EDGE_WINDOW);
+    d.count--;
+  }
+  while (d.count > 0) {
+    uint16_t back = d.entries[(d.head + d.count - 1) % EDGE_WINDOW].value;
+    if (keepBelow ? back < value : back > value) break;
+    d.count--;
+  }
+  d.entries[(d.head + d.count) % EDGE_WINDOW] = {_seq, value};
+  d.count++;
+}
+
+void WindowExtrema::push(uint16_t value) {
+  pushBack(_min, value, true);
+  pushBack(_max, value, false);
+  _seq++;
+  if (_filled < EDGE_WINDOW) _filled++;
+}
+
+EdgeChannel::EdgeChannel(const Bands& bands, uint8_t ewmaShift) : _bands(bands), _shift(ewmaShift) {}
+
+void EdgeChannel::reset() {
+  _state = State();
+  _window.reset();
+}
+
+bool EdgeChannel::push(uint16_t value, uint32_t tsMs) {
+  State& s = _state;
+  bool started = false;
+
+  if (!s.primed) {
+    s.ewmaQ8 = (int32_t)value << 8;
+    s.rate = 0;
+    s.primed = 1;
+  } else {
+    uint32_t dtMs = tsMs - s.lastMs;
+    int32_t delta = (int32_t)value - s.last;
+    int32_t rate = dtMs ? (int32_t)((int64_t)delta * 60000 / (int64_t)dtMs) : 0;
+    s.rate = (int16_t)constrain(rate, INT16_MIN, INT16_MAX);
+
+    // Compared with the EWMA before this sample, which the spike hasn't pulled up yet
+    int32_t above = (int32_t)value - ewma();
+    if (!s.spiking) {
+      started = above >= _bands.rise && s.rate >= (int32_t)_bands.ratePerMin;
+      s.spiking = started;
+    } else if (above < _bands.rise / 2) {
+      s.spiking = 0;
+    }
+
+    // ewma += (value - ewma) * 2^-shift; the division keeps the sign right
+    s.ewmaQ8 += (((int32_t)value << 8) - s.ewmaQ8) / (1 << _shift);
+  }
+  s.last = value;
+  s.lastMs = tsMs;
+  _window.push(value);
+  return started;
+}
+
+EdgeStats::EdgeStats(const EdgeChannel::Bands& tvoc, const EdgeChannel::Bands& eco2, uint8_t ewmaShift)
+  : _tvoc(tvoc, ewmaShift), _eco2(eco2, ewmaShift) {}
+
+void EdgeStats::restore(const State& s) {
+  _tvoc.restore(s.tvoc);
+  _eco2.restore(s.eco2);
+}
+
+void EdgeStats::offer(Reading& r, bool sgpValid) {
+  ReadingStats& st = r.stats;
+  st = ReadingStats{};
+  if (!sgpValid) {
+    _tvoc.reset();
+    _eco2.reset();
+    return;
+  }
+
+  bool tvocSpike = _tvoc.push(r.tvoc, r.tsMs);
+  bool eco2Spike = _eco2.push(r.eco2, r.tsMs);
+  if (!r.warmingUp) {
+    if (tvocSpike) st.anomalies |= READING_ANOMALY_TVOC_SPIKE;
+    if (eco2Spike) st.anomalies |= READING_ANOMALY_ECO2_SPIKE;
+    if (st.anomalies) _anomalies++;
+  }
+
+  st.samples = _tvoc.window().size();
+  st.tvocEwma = _tvoc.ewma();
+  st.tvocMin = _tvoc.window().min();
+  st.tvocMax = _tvoc.window().max();
+  st.tvocRate = _tvoc.rate();
+  st.eco2Ewma = _eco2.ewma();
+  st.eco2Min = _eco2.window().min();
+  st.eco2Max = _eco2.window().max();
+  st.eco2Rate = _eco2.rate();
+}
@@ -0,0 +1,342 @@
+#include "https_keepalive.h"
+
+// TLS handshake timeout; BearSSL's connect() cannot be split, so this bounds the one blocking step
+static const uint32_t HTTP_CONNECT_TIMEOUT_MS = 4000;
+// Request/response timeout, counted from the last byte written or received
+static const uint32_t HTTP_RESPONSE_TIMEOUT_MS = 5000;
+// Response bytes parsed per poll() so a large body can't monopolise loop()
+static const int HTTP_READ_BUDGET = 256;
+// Body bytes handed to a get() sink per poll(), in one read
+static const size_t HTTP_SINK_BUDGET = 512;
+
+HttpsKeepAlive::HttpsKeepAlive(const char* host, uint16_t port, TlsTrust& trust)
+  : _host(host), _port(port), _trust(trust) {}
+
+bool HttpsKeepAlive::isOpen() {
+  return _client.connected();
+}
+
+void HttpsKeepAlive::close() {
+  if (busy()) {
+    abort();   // the caller still gets its finished(-1)
+    return;
+  }
+  _client.stop();
+}
+
+void HttpsKeepAlive::abort() {
+  if (!busy()) return;
+  _retried = true;   // no silent retry: the caller decides
+  fail();
+}
+
+bool HttpsKeepAlive::start(const char* path, const char* contentType, const char* body, size_t len) {
+  if (busy()) return false;
+
+  int headLen = snprintf(_head, sizeof(_head),
+                         "POST %s HTTP/1.1\r\n"
+                         "Host: %s\r\n"
+                         "Content-Type: %s\r\n"
+                         "Content-Length: %u\r\n"
+                         "Connection: keep-alive\r\n"
+                         "\r\n",
+                         path, _host, contentType, (unsigned)len);
+  if (!begin(headLen)) return false;
+  _body = body;
+  _bodyLen = len;
+  _sink = nullptr;
+  return true;
+}
+
+bool HttpsKeepAlive::get(const char* path, BodySink sink, void* ctx) {
+  if (busy()) return false;
+
+  int headLen = snprintf(_head, sizeof(_head),
+                         "GET %s HTTP/1.1\r\n"
+                         "Host: %s\r\n"
+                         "Connection: keep-alive\r\n"
+                         "\r\n",
+                         path, _host);
+  if (!begin(headLen)) return false;
+  _body = nullptr;
+  _bodyLen = 0;
+  _sink = sink;
+  _sinkCtx = ctx;
+  return true;
+}
+
+// Common request setup once the head is formatted
+bool HttpsKeepAlive::begin(int headLen) {
+  if (headLen <= 0 || (size_t)headLen >= sizeof(_head)) return false;
+
+  _headLen = headLen;
+  _sent = 0;
+  _progressMs = millis();
+  _deadline = _progressMs + HTTP_RESPONSE_TIMEOUT_MS;
+  _retried = false;
+  _gotBytes = false;
+  _done = false;
+  _stats.requests++;
+
+  if (_client.connected()) {
+    // Anything unread here is left over from a previous response; drop it
+    while (_client.available() > 0) _client.read();
+    _reusedSocket = true;
+    _state = State::Sending;
+  } else {
+    _reusedSocket = false;
+    _state = State::Connecting;
+  }
+  return true;
+}
+
+bool HttpsKeepAlive::finished(int& status) {
+  if (!_done) return false;
+  _done = false;
+  status = _result;
+  return true;
+}
+
+bool HttpsKeepAlive::connectNow() {
+  _client.stop();
+  if (!_trust.apply(_client, _port)) return false;
+  _client.setSession(&_session);  // resume the previous TLS session when the server allows it
+  _client.setTimeout(HTTP_CONNECT_TIMEOUT_MS);
+
+  _stats.handshakes++;
+  uint32_t start = ESP.getCycleCount();
+  bool ok = _client.connect(_host, _port);
+  _handshakeCycles = ESP.getCycleCount() - start;
+  _handshakeTimed = true;
+  _trust.noteHandshake(ok, ok ? 0 : _client.getLastSSLError());
+  return ok;
+}
+
+bool HttpsKeepAlive::takeHandshake(uint32_t& cycles) {
+  if (!_handshakeTimed) return false;
+  _handshakeTimed = false;
+  cycles = _handshakeCycles;
+  return true;
+}
+
+void HttpsKeepAlive::poll() {
+  switch (_state) {
+    case State::Idle:
+      return;
+
+    case State::Connecting:
+      if (!connectNow()) {
+        fail();
+        return;
+      }
+      _state = State::Sending;
+      _progressMs = millis();
+      _deadline = _progressMs + HTTP_RESPONSE_TIMEOUT_MS;
+      return;  // the handshake used this step's budget
+
+    case State::Sending:
+      sendSome();
+      return;
+
+    default:
+      readSome();
+      return;
+  }
+}
+
+// Write as much of the request as the TLS send buffer currently accepts
+void HttpsKeepAlive::sendSome() {
+  size_t total = _headLen + _bodyLen;
+  int room = _client.availableForWrite();
+  if (room <= 0) {
+    // A send buffer that never drains on a live socket times out like a silent response
+    if (!_client.connected() || (int32_t)(millis() - _deadline) > 0) fail();
+    return;
+  }
+
+  const uint8_t* src;
+  size_t avail;
+  if (_sent < _headLen) {
+    src = (const uint8_t*)_head + _sent;
+    avail = _headLen - _sent;
+  } else {
+    src = (const uint8_t*)_body + (_sent - _headLen);
+    avail = total - _sent;
+  }
+  size_t n = min<size_t>(avail, (size_t)room);
+  if (_client.write(src, n) != n) {
+    fail();
+    return;
+  }
+  _sent += n;
+  _progressMs = millis();
+  _deadline = _progressMs + HTTP_RESPONSE_TIMEOUT_MS;
+
+  if (_sent == total) {
+    _state = State::StatusLine;
+    _lineLen = 0;
+    _gotBytes = false;
+    _status = -1;
+    _remaining = -1;
+    _chunked = false;
+    _serverCloses = false;
+    _deadline = millis() + HTTP_RESPONSE_TIMEOUT_MS;
+  }
+}
+
+void HttpsKeepAlive::readSome() {
+  int budget = HTTP_READ_BUDGET;
+  bool progressed = false;
+  while (budget-- > 0 && _state != State::Idle && _client.available() > 0) {
+    // Streamed body: one bulk read straight to the sink, bounded by the body/chunk length
+    if (_sink != nullptr && _status / 100 == 2 && (_state == State::Body || _state == State::ChunkData)) {
+      uint8_t buf[HTTP_SINK_BUDGET];
+      size_t want = sizeof(buf);
+      if (_remaining >= 0 && (size_t)_remaining < want) want = (size_t)_remaining;
+      int n = _client.read(buf, want);
+      if (n <= 0) break;
+      _gotBytes = true;
+      progressed = true;
+      if (!_sink(_sinkCtx, buf, (size_t)n)) {
+        fail();
+        return;
+      }
+      if (_remaining > 0) {
+        _remaining -= n;
+        if (_remaining == 0) {
+          if (_state == State::Body) complete();
+          else _state = State::ChunkEnd;
+        }
+      }
+      break;  // the bulk read used this step's budget
+    }
+
+    int c = _client.read();
+    if (c < 0) break;
+    progressed = true;
+    feed((char)c);
+  }
+  if (_state == State::Idle) return;
+  if (progressed) {
+    _progressMs = millis();
+    _deadline = _progressMs + HTTP_RESPONSE_TIMEOUT_MS;
+  }
+
+  if (!_client.connected() && _client.available() == 0) {
+    if (_state == State::Body && _remaining < 0) {
+      complete();  // close-delimited body
+    } else {
+      fail();
+    }
+    return;
+  }
+  if ((int32_t)(millis() - _deadline) > 0) {
+    fail();
+  }
+}
+
+void HttpsKeepAlive::feed(char c) {
+  _gotBytes = true;
+
+  switch (_state) {
+    case State::Body:
+      if (_remaining > 0 && --_remaining == 0) complete();
+      return;
+
+    case State::ChunkData:
+      if (--_remaining == 0) _state = State::ChunkEnd;
+      return;
+
+    default:
+      // Line-oriented states; overlong lines are truncated (only the prefix matters)
+      if (c == '\n') {
+        if (_lineLen > 0 && _line[_lineLen - 1] == '\r') _lineLen--;
+        _line[_lineLen] = '\0';
+        handleLine();
+        _lineLen = 0;
+      } else if (_lineLen < sizeof(_line) - 1) {
+        _line[_lineLen++] = c;
+      }
+      return;
+  }
+}
+
+void HttpsKeepAlive::handleLine() {
+  switch (_state) {
+    case State::StatusLine: {
+      // "HTTP/1.1 200 OK"; HTTP/1.0 closes unless told otherwise
+      const char* sp = strchr(_line, ' ');
+      if (strncmp(_line, "HTTP/1.", 7) != 0 || sp == nullptr) {
+        fail();
+        return;
+      }
+      _status = atoi(sp + 1);
+      _serverCloses = (_line[7] == '0');
+      _state = State::Headers;
+      return;
+    }
+
+    case State::Headers:
+      if (_lineLen == 0) {
+        // Blank line terminates the headers
+        if (_chunked) {
+          _state = State::ChunkSize;
+        } else if (_remaining == 0 || _status == 204 || _status == 304) {
+          complete();  // no body (204/304 never have one, with or without a length)
+        } else {
+          if (_remaining < 0) _serverCloses = true;  // length unknown: body runs until close
+          _state = State::Body;
+        }
+      } else if (strncasecmp(_line, "Content-Length:", 15) == 0) {
+        _remaining = atol(_line + 15);
+      } else if (strncasecmp(_line, "Transfer-Encoding:", 18) == 0) {
+        _chunked = strstr(_line + 18, "chunked") != nullptr;
+      } else if (strncasecmp(_line, "Connection:", 11) == 0) {
+        _serverCloses = strstr(_line + 11, "close") != nullptr;
+      }
+      return;
+
+    case State::ChunkSize:
+      _remaining = strtol(_line, nullptr, 16);
+      _state = (_remaining > 0) ? State::ChunkData : State::Trailer;
+      return;
+
+    case State::ChunkEnd:
+      _state = State::ChunkSize;
+      return;
+
+    case State::Trailer:
+      if (_lineLen == 0) complete();
+      return;
+
+    default:
+      return;
+  }
+}
+
+void HttpsKeepAlive::complete() {
+  if (_reusedSocket) _stats.reused++;
+  if (_serverCloses) _client.stop();
+  _result = _status;
+  _state = State::Idle;
+  _done = true;
+}
+
+void HttpsKeepAlive::fail() {
+  _client.stop();
+
+  // A reused socket the server already closed fails before any response arrives;
+  // that request never reached the Worker, so it is safe to send again.
+  if (_reusedSocket && !_retried && !_gotBytes) {
+    _retried = true;
+    _reusedSocket = false;
+    _sent = 0;
+    _state = State::Connecting;
+    return;
+  }
+
+  _stats.failures++;
+  _result = -1;
+  _state = State::Idle;
+  _done = true;
+}
@@ -0,0 +1,60 @@
+#include "log.h"
+
+#include <stdarg.h>
+
+AsyncLog asyncLog;
+
+void AsyncLog::put(const char* data, size_t len) {
+  if (len > LOG_BUFFER_BYTES - _used) {
+    _dropped++;
+    return;
+  }
+  size_t tail = (_head + _used) % LOG_BUFFER_BYTES;
+  size_t first = min(len, LOG_BUFFER_BYTES - tail);
+  memcpy(_ring + tail, data, first);
+  memcpy(_ring, data + first, len - first);
+  _used += len;
+}
+
+void AsyncLog::line(const char* text) {
+  size_t len = strlen(text);
+  if (len + 1 > LOG_BUFFER_BYTES - _used) {
+    _dropped++;
+    return;
+  }
+  put(text, len);
+  put("\n", 1);
+}
+
+void AsyncLog::linef(const char* fmt, ...) {
+  char buf[LOG_LINE_MAX];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof(buf) - 1, fmt, args);
+  va_end(args);
+  if (n < 0) return;
+  size_t len = min((size_t)n, sizeof(buf) - 2);   // truncated lines keep their newline
+  buf[len++] = '\n';
+  put(buf, len);
+}
+
+void AsyncLog::poll() {
+  if (!_uart) return;
+  while (_used > 0) {
+    int room = _uart->availableForWrite();
+    if (room <= 0) return;
+    size_t n = min(min((size_t)room, _used), LOG_BUFFER_BYTES - _head);
+    _uart->write((const uint8_t*)_ring + _head, n);
+    _head = (_head + n) % LOG_BUFFER_BYTES;
+    _used -= n;
+  }
+}
+
+void AsyncLog::flush() {
+  if (!_uart) return;
+  while (_used > 0) {
+    poll();
+    yield();
+  }
+  _uart->flush();
+}
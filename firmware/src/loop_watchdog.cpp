@@ -0,0 +1,109 @@
+#include "loop_watchdog.h"
+
+extern "C" {
+#include <user_interface.h>
+}
+
+#include "log.h"
+#include "rtc_store.h"
+
+static const uint32_t WATCHDOG_MAGIC = 0x57445431;  // "WDT1"
+
+// Running-step check period (the hardware watchdog bites after ~8 s without a yield)
+static const uint32_t WATCHDOG_TICK_MS = 500;
+
+static const char* const WATCHED_NAMES[] = {"http", "mqtt"};
+static_assert(sizeof(WATCHED_NAMES) / sizeof(WATCHED_NAMES[0]) == (size_t)Watched::Count, "one name per machine");
+
+static os_timer_t watchdogTimer;
+
+LoopWatchdog::LoopWatchdog(uint32_t stallMs) : _stallMs(stallMs) {}
+
+const char* LoopWatchdog::name(Watched machine) {
+  return WATCHED_NAMES[(uint8_t)machine];
+}
+
+void LoopWatchdog::begin() {
+  static_assert(sizeof(RtcRecord<Record>) <= (128 - RTC_SLOT_WATCHDOG) * 4, "watchdog record overflows its RTC slot");
+  Record rec;
+  bool have = rtcLoad(RTC_SLOT_WATCHDOG, WATCHDOG_MAGIC, rec);
+
+  rst_info* info = ESP.getResetInfoPtr();
+  uint32_t reason = info != nullptr ? info->reason : REASON_DEFAULT_RST;
+  bool bitten = reason == REASON_WDT_RST || reason == REASON_SOFT_WDT_RST || reason == REASON_EXCEPTION_RST;
+
+  // Counts survive resets, not power cycles
+  _hardResets = (have && reason != REASON_DEFAULT_RST) ? rec.hardResets : 0;
+  if (bitten) {
+    _hardResets++;
+    if (have && rec.stage < (uint8_t)Stage::Count) {
+      LOG_ERROR("[WDT] Reset (reason %u) while %s had been running %lu ms", (unsigned)reason,
+                Profiler::name((Stage)rec.stage), (unsigned long)rec.runningMs);
+    } else {
+      LOG_ERROR("[WDT] Reset (reason %u) outside an instrumented stage", (unsigned)reason);
+    }
+  }
+  saveRecord((uint8_t)Stage::Count, 0);
+
+  os_timer_setfn(&watchdogTimer, onTick, this);
+  os_timer_arm(&watchdogTimer, WATCHDOG_TICK_MS, true);
+}
+
+void LoopWatchdog::saveRecord(uint8_t stage, uint32_t runningMs) {
+  Record rec = {};
+  rec.stage = stage;
+  rec.runningMs = runningMs;
+  rec.hardResets = _hardResets;
+  rtcSave(RTC_SLOT_WATCHDOG, WATCHDOG_MAGIC, rec);
+}
+
+void LoopWatchdog::enter(Stage stage) {
+  _enteredMs = millis();
+  _stage = (uint8_t)stage;
+}
+
+void LoopWatchdog::leave() {
+  uint8_t stage = _stage;
+  _stage = (uint8_t)Stage::Count;
+  if (stage >= (uint8_t)Stage::Count) return;
+
+  uint32_t took = millis() - _enteredMs;
+  if (took >= _stallMs) {
+    _stalls[stage]++;
+    LOG_WARN("[WDT] %s step took %lu ms (stall %lu)", Profiler::name((Stage)stage),
+             (unsigned long)took, (unsigned long)_stalls[stage]);
+  }
+  if (_recorded) {
+    _recorded = false;
+    saveRecord((uint8_t)Stage::Count, 0);   // it returned after all
+  }
+}
+
+void LoopWatchdog::onTick(void* arg) {
+  ((LoopWatchdog*)arg)->tick();
+}
+
+// Timer context: only notes the overdue step, once per step
+void LoopWatchdog::tick() {
+  uint8_t stage = _stage;
+  if (stage >= (uint8_t)Stage::Count || _recorded) return;
+  uint32_t running = millis() - _enteredMs;
+  if (running < _stallMs) return;
+  _recorded = true;
+  saveRecord(stage, running);
+}
+
+bool LoopWatchdog::supervise(Watched machine, bool active, uint32_t progressMs, uint32_t limitMs,
+                             uint32_t nowMs) {
+  uint8_t i = (uint8_t)machine;
+  if (!active || nowMs - progressMs < limitMs) {
+    _stuck[i] = false;
+    return false;
+  }
+  if (_stuck[i]) return false;   // already reported; the caller's reset is still taking effect
+  _stuck[i] = true;
+  _resets[i]++;
+  LOG_WARN("[WDT] %s stuck for %lu ms, resetting it (%lu reset(s))", name(machine),
+           (unsigned long)(nowMs - progressMs), (unsigned long)_resets[i]);
+  return true;
+}
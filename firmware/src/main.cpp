@@ -1,28 +1,136 @@
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
 #include <WiFiClientSecureBearSSL.h>
+#include <SoftwareSerial.h>
 #include <Wire.h>
 #include <time.h>
 
-#include <Adafruit_MQTT.h>
-#include <Adafruit_MQTT_Client.h>
-
 #include <Adafruit_SGP30.h>
 #include <Adafruit_SHT31.h>
 #include <Adafruit_NeoPixel.h>
 
 #include "config.h"
+#include "aq_index.h"
+#include "boot_counter.h"
+#include "edge_stats.h"
+#include "https_keepalive.h"
+#include "json_writer.h"
+#include "led_animator.h"
+#include "led_color.h"
+#include "log.h"
+#include "loop_watchdog.h"
+#include "mqtt_link.h"
+#include "offline_log.h"
+#include "ota_updater.h"
+#include "pms5003.h"
+#include "profiler.h"
+#include "power_manager.h"
+#include "reading.h"
+#include "reading_codec.h"
+#include "reading_json.h"
+#include "reading_pipeline.h"
+#include "remote_config.h"
+#include "report_filter.h"
+#include "ring_buffer.h"
+#include "scd4x.h"
+#include "scheduler.h"
+#include "sensor_reader.h"
+#include "sensor_registry.h"
+#include "sgp_baseline.h"
+#include "timekeeper.h"
+#include "tls_trust.h"
+#include "wifi_supervisor.h"
 
 static bool shtOk = false;
 static bool sgpOk = false;
-static uint8_t lastAqIndex = 0;
-
-// HiveMQ MQTT client with TLS
-BearSSL::WiFiClientSecure wifiClient;
-Adafruit_MQTT_Client mqtt(&wifiClient, MQTT_BROKER, MQTT_PORT, MQTT_USERNAME, MQTT_PASSWORD);
 
-// HiveMQ Publish topic
-Adafruit_MQTT_Publish* mqttPub = nullptr;
+// Duty cycling and the virtual clock (uptime across deep sleeps)
+static PowerManager power((PowerMode)POWER_MODE);
+static uint32_t windowStartMs = 0;   // current upload window, low-power modes only
+
+// SNTP wall clock mapped onto the virtual clock (epoch timestamps for readings)
+static Timekeeper timekeeper;
+
+// WiFi association, reconnect and fast-connect cache (polled from loop())
+static WifiSupervisor wifi(WIFI_SSID, WIFI_PASSWORD, WIFI_CACHE_STATIC_IP);
+
+// Cloudflare Worker (D1 storage)
+static const char* WORKER_HOST = "airq-5xv.pages.dev";
+
+// Server verification per host: pinned public key, else the root CA (config.h)
+static TlsTrust mqttTrust(MQTT_BROKER, MQTT_TLS_PUBKEY, TLS_ROOT_CA, TLS_ALLOW_INSECURE);
+static TlsTrust workerTrust(WORKER_HOST, WORKER_TLS_PUBKEY, TLS_ROOT_CA, TLS_ALLOW_INSECURE);
+
+// HiveMQ MQTT client with TLS (connection state machine, polled from loop())
+static MqttLink mqttLink(MQTT_BROKER, MQTT_PORT, MQTT_USERNAME, MQTT_PASSWORD, MQTT_TOPIC,
+                         MQTT_INFLIGHT_WINDOW, mqttTrust);
+
+// Worker connection, kept open between samples
+static HttpsKeepAlive worker(WORKER_HOST, 443, workerTrust);
+
+// Firmware updates pulled over the same connection, with trial boot and rollback
+static OtaUpdater ota(worker, DEVICE_ID, OTA_CHECK_INTERVAL_MS, OTA_CONFIRM_MS, OTA_TRIAL_BOOTS);
+
+// Report-by-exception: only changed readings (or heartbeats) are published and uploaded
+static ReportFilter reportFilter({DEADBAND_TVOC_PPB, DEADBAND_ECO2_PPM, DEADBAND_T_C, DEADBAND_RH},
+                                 REPORT_HEARTBEAT_MS);
+
+// Rolling TVOC/eCO2 statistics per sample; a spike is reported and uploaded at once
+static EdgeStats edgeStats({SPIKE_TVOC_RISE_PPB, SPIKE_TVOC_PPB_PER_MIN},
+                           {SPIKE_ECO2_RISE_PPM, SPIKE_ECO2_PPM_PER_MIN}, EDGE_EWMA_SHIFT);
+static bool anomalyDue = false;   // a spike is queued: upload without waiting for the batch
+
+// Readings waiting to be uploaded; sized for a few missed flushes on top of one batch
+static const size_t UPLOAD_QUEUE_LEN = 64;
+static_assert(UPLOAD_QUEUE_LEN >= BATCH_MAX_SAMPLES, "upload queue must hold at least one batch");
+static RingBuffer<Reading, UPLOAD_QUEUE_LEN> pendingUploads;
+static uint32_t droppedUploads = 0;
+static uint32_t lastUploadFailMs = 0;
+
+// Preallocated payload buffers: no per-sample heap allocation.
+// sampleJson is shared by Serial and MQTT; uploadJson holds the batch owned by
+// the worker state machine until its request finishes.
+static const size_t READING_JSON_MAX =
+    readingJsonMax(DEVICE_ID, SENSOR_PMS5003 || SENSOR_SCD4X ? READING_EXTRA_MAX : 0);
+static_assert(READING_JSON_MAX <= MQTT_PAYLOAD_MAX, "a JSON reading must fit one MQTT message: shorten DEVICE_ID");
+static char sampleJson[READING_JSON_MAX];
+static char uploadJson[BATCH_MAX_SAMPLES * (READING_JSON_MAX + 1) + 2];
+static uint8_t sampleBin[READING_BIN_LEN];   // MQTT payload when MQTT_BINARY_PAYLOAD is set
+static uint32_t droppedPublishes = 0;   // reports that didn't fit their buffer, so weren't published
+static size_t uploadCount = 0;   // queue (or offline log) entries covered by the request in flight
+static bool uploadIsBackfill = false;
+static uint32_t uploadOldestMs = 0;   // timestamp of the oldest reading in flight (latency budget)
+
+// Offline store-and-forward: readings the RAM queue can't hold are spilled to
+// flash one batch at a time and backfilled as binary records once uploads succeed again
+static OfflineLog offlineLog(OFFLINE_SEGMENT_RECORDS, OFFLINE_MAX_SEGMENTS);
+static uint8_t spillBin[BATCH_MAX_SAMPLES * READING_BIN_LEN];
+static uint8_t backfillBin[OFFLINE_BACKFILL_RECORDS * READING_BIN_LEN];
+static char backfillPath[sizeof("/api/store?device_id=") + sizeof(DEVICE_ID)];
+static uint32_t lastBackfillMs = 0;
+
+// Heap health, report-by-exception savings and scheduler jitter, on serial every HEAP_REPORT_MS
+static const uint32_t HEAP_REPORT_MS = 60000;
+static uint32_t lastHeapReport = 0;
+// Heap when the MQTT and upload TLS sessions are first up together (0 = not yet):
+// the steady cost of both connections, for sizing buffers
+static uint32_t tlsUpFreeHeap = 0;
+static uint32_t tlsUpMaxBlock = 0;
+
+// Stage timing (cycle counter) and fleet telemetry on MQTT_TELEMETRY_TOPIC every TELEMETRY_MS
+static Profiler profiler;
+static const size_t TELEMETRY_JSON_MAX = 768;   // the counters before "stages" take ~550 B
+static_assert(TELEMETRY_JSON_MAX <= MQTT_PAYLOAD_MAX, "a telemetry part must fit one MQTT message");
+static char telemetryJson[TELEMETRY_JSON_MAX];
+static uint32_t lastTelemetryMs = 0;
+static uint32_t telemetrySeq = 0;
+static uint32_t telemetryDropped = 0;   // parts the outbox had no room for
+
+// Stage stalls and stuck network state machines (reset on their own, not the device)
+static LoopWatchdog watchdog(WATCHDOG_STALL_MS);
+
+// Network steps alternate between MQTT and HTTP so one loop() never runs both
+static bool pollMqttNext = true;
 
 
 // Hardware stack
@@ -30,302 +138,818 @@ Adafruit_NeoPixel leds(N_LEDS, PIN_NEOPIXEL, NEO_GRB + NEO_KHZ800);
 Adafruit_SGP30 sgp;
 Adafruit_SHT31 sht31 = Adafruit_SHT31();
 
+// I²C addresses (BEWARE, this SHT31 board is NOT at the usual 0x44!)
+static const uint8_t SHT31_ADDR = 0x45;
+static const uint8_t SGP30_ADDR = 0x58;
+
+// Per-sample readout: both conversions overlap and loop() never waits on them.
+// The Adafruit drivers above are kept for probing, IAQinit and baselines.
+static SensorReader sensors(Wire, SHT31_ADDR, SGP30_ADDR);
+
+// Add-on sensors enabled in config.h, each on its own interval; their
+// transfers interleave (one per loop()) and their fields extend every reading
+static SoftwareSerial pmsSerial(PMS_RX_PIN, PMS_TX_PIN);
+static Pms5003 pms(pmsSerial);
+static Scd4x scd4x(Wire);
+static SensorRegistry extraSensors;
+
+// Multi-rate sampling: the SGP30 IAQ algorithm is specified for exactly 1 Hz,
+// humidity changes slowly, and readings go out at SAMPLE_MS. Readings run
+// just after an SGP30 tick so they carry a fresh result.
+static const uint32_t SGP30_INTERVAL_MS = 1000;
+static const uint32_t READING_PHASE_MS = 50;
+static Scheduler scheduler;
+
+// IAQ baseline snapshots in flash (survive reboots and OTA updates)
+static SgpBaseline sgpBaseline(sgp);
+static bool baselineAwaitsClock = false;   // power-on: snapshot age can only be checked after SNTP
+
+static bool fsOk = false;
+static uint32_t lastProbeMs = 0;   // sensors missing at boot are probed again every SENSOR_REPROBE_MS
+
+// Cadence, batching, LED and AQ bands: config.h defaults, overridden by the
+// remote config (MQTT_CONFIG_TOPIC) stored in flash
+static RemoteConfig remoteConfig({0, SAMPLE_MS, WARMUP_MS, REPORT_HEARTBEAT_MS, BATCH_MAX_AGE_MS,
+                                  BATCH_MAX_SAMPLES, LED_BRIGHTNESS, AQ_THRESHOLD_LOW,
+                                  AQ_THRESHOLD_HIGH, AQ_HYSTERESIS_BAND});
+static const DeviceSettings& settings = remoteConfig.settings();
+static uint8_t configMsg[MQTT_INBOX_MAX];
+static int8_t readingTask = -1;
+
+static BootCounter bootCounter;
 static uint32_t bootMs = 0;
-static uint32_t lastSample = 0;
+static uint32_t warmupMs = WARMUP_MS;   // shortened when the SGP30 baseline is restored
+
+// Color ramp and band boundaries for the thresholds in force. Built at compile
+// time for the defaults and rebuilt when the remote config changes them; they
+// live in RAM, which pgm_read_* reads as well on the ESP8266.
+static_assert(AQ_THRESHOLD_LOW < AQ_THRESHOLD_HIGH && AQ_THRESHOLD_HIGH < 100, "AQ thresholds must satisfy LOW < HIGH < 100");
+static const char* const AQ_BAND_NAMES[AQ_BAND_COUNT] = {"green", "yellow", "red"};
+static AqBandTable<AQ_BAND_COUNT> aqBandTable =
+    makeAqBandTable<AQ_BAND_COUNT>({AQ_THRESHOLD_LOW, AQ_THRESHOLD_HIGH}, AQ_HYSTERESIS_BAND);
+static AqBandClassifier<AQ_BAND_COUNT> aqBands(aqBandTable);
+static AqColorLut aqColors = makeAqColorLut(AQ_THRESHOLD_LOW, AQ_THRESHOLD_HIGH);
+
+static uint32_t colorForIndex(uint8_t idx) {
+  return aqColorAt(aqColors, idx);
+}
+static ReadingPipeline readingPipeline(aqBands, aqColors, edgeStats, reportFilter, DEVICE_ID);
+
+// Frame-rate LED rendering (fades, warm-up pulse, bar graph), polled from loop().
+// Deep sleep only renders one frame per wake, so colors switch without a fade there.
+static LedAnimator<N_LEDS> ledAnim(leds, (LedMode)LED_MODE, LED_FRAME_MS,
+                                   (PowerMode)POWER_MODE == PowerMode::DeepSleep ? 0 : LED_FADE_MS,
+                                   colorForIndex);
+
+
+// Readings taken before the first SNTP sync get their epoch once the clock is
+// known (same power cycle, so tsMs is on the same virtual clock)
+static Reading stamped(const Reading& r) {
+  Reading s = r;
+  if (s.epochMs == 0) s.epochMs = timekeeper.toEpochMs(s.tsMs);
+  return s;
+}
+
+// Write one reading as a JSON object, back-stamped with the epoch if known by now
+static void writeReadingJson(JsonWriter& w, const Reading& reading) {
+  writeReadingJson(w, stamped(reading), DEVICE_ID);
+}
+
+// Free heap, largest free block and fragmentation (0% = one contiguous block)
+static void reportStats(uint32_t nowMs) {
+  if (tlsUpFreeHeap == 0 && mqttLink.online() && worker.isOpen()) {
+    tlsUpFreeHeap = ESP.getFreeHeap();
+    tlsUpMaxBlock = ESP.getMaxFreeBlockSize();
+    LOG_INFO("[HEAP] Both TLS sessions up: free=%u max_block=%u",
+             (unsigned)tlsUpFreeHeap, (unsigned)tlsUpMaxBlock);
+  }
+  if (nowMs - lastHeapReport < HEAP_REPORT_MS) return;
+  lastHeapReport = nowMs;
+
+  LOG_INFO("[HEAP] free=%u max_block=%u frag=%u%%",
+           (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMaxFreeBlockSize(),
+           (unsigned)ESP.getHeapFragmentation());
+
+  // Report-by-exception savings
+  uint32_t total = reportFilter.reported() + reportFilter.suppressed();
+  LOG_INFO("[REPORT] %lu of %lu sample(s) reported (%u%% suppressed)",
+           (unsigned long)reportFilter.reported(), (unsigned long)total,
+           total ? (unsigned)(reportFilter.suppressed() * 100ULL / total) : 0u);
+
+  // Cadence under load: lateness per task since the last report
+  scheduler.report();
+  LOG_INFO("[SENSOR] %lu I2C error(s), %lu overrun(s); add-ons %lu error(s), %lu overrun(s)",
+           (unsigned long)sensors.errors(), (unsigned long)sensors.overruns(),
+           (unsigned long)extraSensors.errors(), (unsigned long)extraSensors.overruns());
+}
+
+// Queue a payload for HiveMQ (QoS1, sent from poll(); dropped if the link is down or the outbox is full)
+static bool publishToMQTT(const uint8_t* payload, size_t len) {
+  if (WiFi.status() != WL_CONNECTED) {
+    LOG_DEBUG("[MQTT] WiFi not connected");
+    return false;
+  }
+  if (!mqttLink.online()) {
+    LOG_DEBUG("[MQTT] Broker not connected");
+    return false;
+  }
 
-// Apply brightness cap and update first pixel (assumes at least 1 LED)
-static void setLed(uint32_t c) {
-  leds.setBrightness(LED_BRIGHTNESS);
-  leds.setPixelColor(0, c);
-  leds.show();
+  bool ok = mqttLink.publish(payload, len);
+  if (ok) {
+    LOG_DEBUG("[MQTT] Queued for %s (%u B, %u unacknowledged)", MQTT_TOPIC, (unsigned)len,
+              (unsigned)mqttLink.queued());
+  } else {
+    LOG_WARN("[MQTT] Outbox full, reading not published");
+  }
+  return ok;
 }
 
-// From power-on until WARMUP_MS expires the LED ignores air quality and shows a slow pulsing blue
-static uint32_t pulsingBlue(uint32_t nowMs) {
-  float phase = (nowMs % 1000) / 1000.0f;
-  float tri = (phase < 0.5f) ? (phase * 2.0f) : (2.0f - phase * 2.0f);
-  uint8_t b = (uint8_t)(20 + 120 * tri);
-  return leds.Color(0, 0, b);
+// Hand the queued readings to the worker state machine as one JSON array once
+// batchSamples have accumulated or the oldest is batchAgeMs old (settings),
+// or right away after a spike.
+// On failure the readings stay queued and the next attempt waits another batchAgeMs.
+static bool uploadDue(uint32_t nowMs) {
+  return !pendingUploads.empty() &&
+         (anomalyDue || pendingUploads.size() >= settings.batchSamples ||
+          (nowMs - pendingUploads.peek(0).tsMs) >= settings.batchAgeMs);
 }
 
-// 0..100 index from TVOC ppb (tune later!)
-static uint8_t tvocToIndex(uint16_t tvoc) {
-  if (tvoc <= 200) {
-    // 0..200 ppb → 0..60
-    return (uint8_t)(tvoc * 60 / 200);
+static void startUpload(uint32_t nowMs) {
+  if (pendingUploads.empty() || worker.busy()) return;
+  if (WiFi.status() != WL_CONNECTED) return;
+
+  bool due = uploadDue(nowMs);
+  bool backingOff = lastUploadFailMs != 0 && (nowMs - lastUploadFailMs) < settings.batchAgeMs;
+  if (!due || (backingOff && !anomalyDue)) return;
+
+  size_t limit = min<size_t>(pendingUploads.size(), settings.batchSamples);
+  JsonWriter w(uploadJson, sizeof(uploadJson));
+  w.beginArray();
+  size_t n = 0;
+  size_t mark = w.length();
+  for (; n < limit; n++) {
+    mark = w.length();
+    writeReadingJson(w, pendingUploads.peek(n));
+    if (!w.ok()) break;  // doesn't fit: the rest goes in the next batch
   }
-  if (tvoc <= 800) {
-    // 200..800 ppb → 60..90
-    return (uint8_t)(60 + (tvoc - 200) * 30 / 600);
+  if (!w.ok()) w.truncate(mark);
+  w.endArray();
+  if (!w.ok() && n > 0) {
+    // No room left for the closing bracket: give up the last element too
+    n--;
+    w.truncate(mark);
+    w.endArray();
   }
-  // >800 ppb → clamp
-  return 100;
+  if (n == 0 || !w.ok()) return;
+
+  if (!worker.start("/api/store", "application/json", w.c_str(), w.length())) return;
+  uploadCount = n;
+  uploadIsBackfill = false;
+  uploadOldestMs = pendingUploads.peek(0).tsMs;
+  anomalyDue = false;
+
+  LOG_DEBUG("[WORKER] %s batch of %u (%lu dropped since boot)",
+            worker.isOpen() ? "POSTing" : "Connecting,", (unsigned)n, (unsigned long)droppedUploads);
 }
 
-// Apply hysteresis to prevent LED flickering near threshold transitions
-// Returns the stabilized AQ index: sticks with lastAqIndex unless
-// the new value is far enough away (beyond the hysteresis band)
-static uint8_t applyHysteresis(uint8_t newIndex) {
-  // If we're in a stable zone far from thresholds, accept the change
-  if (newIndex <= (AQ_THRESHOLD_LOW - AQ_HYSTERESIS_BAND) ||
-      (newIndex > (AQ_THRESHOLD_LOW - AQ_HYSTERESIS_BAND) && 
-       newIndex < (AQ_THRESHOLD_LOW + AQ_HYSTERESIS_BAND) &&
-       lastAqIndex >= AQ_THRESHOLD_LOW) ||
-      (newIndex > (AQ_THRESHOLD_HIGH - AQ_HYSTERESIS_BAND) && 
-       newIndex < (AQ_THRESHOLD_HIGH + AQ_HYSTERESIS_BAND) &&
-       lastAqIndex >= AQ_THRESHOLD_HIGH) ||
-      newIndex >= (AQ_THRESHOLD_HIGH + AQ_HYSTERESIS_BAND)) {
-    // Simplified: accept if clearly away from thresholds
-    if (newIndex < (AQ_THRESHOLD_LOW - AQ_HYSTERESIS_BAND) ||
-        newIndex > (AQ_THRESHOLD_HIGH + AQ_HYSTERESIS_BAND)) {
-      return newIndex;
-    }
-    // In hysteresis zone: check relative to last state
-    if (lastAqIndex < AQ_THRESHOLD_LOW && newIndex < (AQ_THRESHOLD_LOW + AQ_HYSTERESIS_BAND)) {
-      return lastAqIndex;  // Stay in green
+// Drain the offline log, rate-limited to OFFLINE_BACKFILL_RECORDS every
+// OFFLINE_BACKFILL_INTERVAL_MS so a reconnect burst doesn't swamp the Worker.
+// Only runs while live uploads are succeeding.
+static void startBackfill(uint32_t nowMs) {
+  if (offlineLog.pending() == 0 || worker.busy() || lastUploadFailMs != 0) return;
+  if (WiFi.status() != WL_CONNECTED) return;
+  if (nowMs - lastBackfillMs < OFFLINE_BACKFILL_INTERVAL_MS) return;
+
+  size_t bytes;
+  size_t n = offlineLog.peek(backfillBin, OFFLINE_BACKFILL_RECORDS, bytes);
+  if (n == 0) return;
+  if (bytes == 0) {
+    offlineLog.consume(n);   // only unreadable slots: nothing to send
+    return;
+  }
+  if (!worker.start(backfillPath, "application/octet-stream", (const char*)backfillBin, bytes)) return;
+  uploadCount = n;
+  uploadIsBackfill = true;
+  lastBackfillMs = nowMs;
+
+  LOG_INFO("[WORKER] Backfilling %u of %lu offline reading(s)",
+           (unsigned)n, (unsigned long)offlineLog.pending());
+}
+
+// Collect the outcome of a finished upload
+static void finishUpload(uint32_t nowMs) {
+  int status;
+  if (!worker.finished(status)) return;
+
+  if (status == 200) {
+    LOG_DEBUG("[WORKER] ✓");
+    if (uploadIsBackfill) {
+      offlineLog.consume(uploadCount);
+    } else {
+      pendingUploads.drop(uploadCount);
+      power.noteUploadLatency(nowMs - uploadOldestMs);
     }
-    if (lastAqIndex >= AQ_THRESHOLD_LOW && lastAqIndex < AQ_THRESHOLD_HIGH &&
-        newIndex >= (AQ_THRESHOLD_LOW - AQ_HYSTERESIS_BAND) && 
-        newIndex < (AQ_THRESHOLD_HIGH + AQ_HYSTERESIS_BAND)) {
-      return lastAqIndex;  // Stay in yellow
+    lastUploadFailMs = 0;
+  } else if (status == 422 && uploadIsBackfill) {
+    // The Worker can't decode these records; a retry would stall the log on them
+    LOG_WARN("[WORKER] ✗ (422), dropping %u undecodable offline reading(s)", (unsigned)uploadCount);
+    offlineLog.consume(uploadCount);
+  } else {
+    LOG_WARN("[WORKER] ✗ (%d)", status);
+    lastUploadFailMs = nowMs;
+  }
+  uploadCount = 0;
+}
+
+// Move the oldest batch of the RAM queue to the offline log (one flash write per batch)
+static bool spillToFlash() {
+  size_t n = min<size_t>(pendingUploads.size(), BATCH_MAX_SAMPLES);
+  for (size_t i = 0; i < n; i++) {
+    encodeReadingBinary(stamped(pendingUploads.peek(i)), spillBin + i * READING_BIN_LEN, READING_BIN_LEN);
+  }
+  if (!offlineLog.append(spillBin, n)) return false;
+  pendingUploads.drop(n);
+  LOG_INFO("[OFFLINE] Spilled %u reading(s) to flash (%lu pending)",
+           (unsigned)n, (unsigned long)offlineLog.pending());
+  return true;
+}
+
+// Queue a reading for upload. A full queue spills its oldest batch to flash,
+// unless that batch is in flight; then the oldest entry is overwritten and the
+// in-flight batch shrinks so a successful POST doesn't drop a reading that was never sent.
+static void queueUpload(const Reading& r) {
+  bool liveInFlight = uploadCount > 0 && !uploadIsBackfill;
+  if (pendingUploads.full() && !liveInFlight) {
+    (void)spillToFlash();
+  }
+  if (!pendingUploads.push(r)) {
+    droppedUploads++;
+    if (liveInFlight && uploadCount > 0) uploadCount--;
+  }
+}
+
+// One bounded network step per loop(): MQTT and HTTP take turns
+static void pollNetwork(uint32_t nowMs) {
+  if (pollMqttNext) {
+    ScopedTimer timer(profiler, Stage::Mqtt);
+    WatchdogScope guard(watchdog, Stage::Mqtt);
+    mqttLink.poll();
+  } else {
+    ScopedTimer timer(profiler, Stage::Http);
+    WatchdogScope guard(watchdog, Stage::Http);
+    if (!ota.busy()) {
+      startUpload(nowMs);
+      startBackfill(nowMs);
     }
-    if (lastAqIndex >= AQ_THRESHOLD_HIGH && newIndex > (AQ_THRESHOLD_HIGH - AQ_HYSTERESIS_BAND)) {
-      return lastAqIndex;  // Stay in red
+    ota.poll(nowMs);  // starts a due check only if no upload took the connection
+    if (!ota.busy()) {
+      worker.poll();
+      finishUpload(nowMs);
     }
   }
-  return newIndex;
+  pollMqttNext = !pollMqttNext;
+
+  // Handshake cost on its own (the step timers above include it)
+  uint32_t cycles;
+  if (mqttLink.takeHandshake(cycles)) profiler.record(Stage::Tls, cycles);
+  if (worker.takeHandshake(cycles)) profiler.record(Stage::Tls, cycles);
 }
 
+// Low-power modes: open an upload window (radio on) when a batch is due, close
+// it once everything is delivered or after UPLOAD_WINDOW_MS. A window that
+// times out delays the next one by batchAgeMs.
+static void manageRadio(uint32_t nowMs) {
+  SleepState& st = power.state();
+  bool wanted = uploadDue(nowMs) || offlineLog.pending() > 0;
+
+  if (!power.radioIsOn()) {
+    bool allowed = anomalyDue || (int32_t)(nowMs - st.nextWindowMs) >= 0;
+    if (wanted && power.radioAvailable() && allowed) {
+      power.radioOn(nowMs);
+      wifi.resume();
+      windowStartMs = nowMs;
+    }
+    return;
+  }
 
-//Index →
-//0    LOW       HIGH          100
-//|----|----------|------------|
-// G      G→Y        Y→R
-static uint32_t colorForIndex(uint8_t idx) {
-  if (idx <= AQ_THRESHOLD_LOW) return leds.Color(0, 255, 0);
-  if (idx <= AQ_THRESHOLD_HIGH) {
-    float u = (idx - AQ_THRESHOLD_LOW) / (float)(AQ_THRESHOLD_HIGH - AQ_THRESHOLD_LOW);
-    return leds.Color((uint8_t)(255 * u), 255, 0);
+  // A firmware download keeps the window open (it times out on its own when stalled)
+  bool drained = !worker.busy() && !uploadDue(nowMs) && offlineLog.pending() == 0 &&
+                 mqttLink.queued() == 0;
+  bool expired = nowMs - windowStartMs >= UPLOAD_WINDOW_MS && !ota.busy();
+  if (drained || expired) {
+    worker.close();
+    finishUpload(nowMs);   // an upload cut off by the window closing counts as failed
+    wifi.suspend();
+    power.radioOff(nowMs);
+    st.nextWindowMs = drained ? nowMs : nowMs + settings.batchAgeMs;
+    anomalyDue = false;   // one early window per spike, even if it failed
   }
-  float u = (idx - AQ_THRESHOLD_HIGH) / (float)(100 - AQ_THRESHOLD_HIGH);
-  return leds.Color(255, (uint8_t)(255 * (1.0f - u)), 0);
 }
 
+// Time until the next sensor start or reading, whichever comes first
+static uint32_t untilNextSample(uint32_t nowMs) {
+  return min<uint32_t>(scheduler.untilNext(nowMs), extraSensors.untilNext(nowMs));
+}
+
+// Deep sleep until the next sample, carrying queued readings and sensor state in RTC memory
+static void enterDeepSleep(uint32_t nowMs) {
+  SleepState& st = power.state();
 
-// absolute humidity (mg/m^3) for SGP30 compensation
-static uint32_t absoluteHumidity_mgm3(float tempC, float rh) {
-  // saturation vapor pressure (hPa)
-  float svp = 6.112f * expf((17.62f * tempC) / (243.12f + tempC));
-  // actual vapor pressure (hPa)
-  float avp = svp * (rh / 100.0f);
-  // absolute humidity (g/m^3)
-  float ah = 2.1674f * avp * 100.0f / (273.15f + tempC);
-  return (uint32_t)(ah * 1000.0f);
+  // Whatever doesn't fit the RTC stash goes to the offline log
+  while (pendingUploads.size() > SLEEP_STASH_RECORDS && spillToFlash()) {}
+  while (pendingUploads.size() > SLEEP_STASH_RECORDS) pendingUploads.drop(1);
+
+  st.stashCount = (uint8_t)pendingUploads.size();
+  for (size_t i = 0; i < st.stashCount; i++) {
+    encodeReadingBinary(stamped(pendingUploads.peek(i)), st.stash + i * READING_BIN_LEN, READING_BIN_LEN);
+  }
+  st.clock = timekeeper.state();
+  st.report = reportFilter.state();
+  st.edge = edgeStats.state();
+  st.anomalyDue = anomalyDue && !pendingUploads.empty();
+  for (uint8_t i = 0; i < Scheduler::MAX_TASKS; i++) st.deadlines[i] = scheduler.deadline(i);
+  st.aqBand = aqBands.band();
+  st.hasBaseline = sgpOk && sgp.getIAQBaseline(&st.baselineEco2, &st.baselineTvoc);
+  st.warmupMs = warmupMs;
+  st.baselineTrusted = sgpBaseline.trusted();
+  st.baselineSavedMs = sgpBaseline.lastSaveMs();
+
+  uint32_t untilSample = untilNextSample(nowMs);
+  if (untilSample < 10) untilSample = 10;
+
+  // Calibrate the radio on wake only if that wake will open an upload window
+  uint32_t wakeMs = nowMs + untilSample;
+  bool batchFull = pendingUploads.size() + 1 >= settings.batchSamples;
+  bool batchOld = !pendingUploads.empty() && wakeMs - pendingUploads.peek(0).tsMs >= settings.batchAgeMs;
+  bool windowAllowed = (int32_t)(wakeMs - st.nextWindowMs) >= 0;
+  bool radioOnWake = st.anomalyDue || (windowAllowed && (batchFull || batchOld || offlineLog.pending() > 0));
+
+  power.deepSleep(untilSample, radioOnWake);
 }
 
-static void wifiConnect() {
-  Serial.print("Connecting to WiFi: ");
-  Serial.println(WIFI_SSID);
-  
-  WiFi.mode(WIFI_STA);
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-
-  uint32_t t0 = millis();
-  while (WiFi.status() != WL_CONNECTED && (millis() - t0) < 15000) {
-    Serial.print(".");
-    delay(250);
-  }
-  
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("\nWiFi connected!");
-    Serial.print("IP: ");
-    Serial.println(WiFi.localIP());
-    
-    // Configure TLS client
-    wifiClient.setInsecure();
+// Called at the end of every loop(): radio windows, then sleep until the next sample
+static void managePower(uint32_t nowMs) {
+  power.report(nowMs, POWER_REPORT_MS);
+  if (power.mode() == PowerMode::AlwaysOn) return;
+
+  manageRadio(nowMs);
+  if (power.radioIsOn()) return;  // window open: keep looping (sampling continues)
+  if (sensors.busy() || extraSensors.busy()) return;   // collect the measurements in flight first
+
+  if (power.mode() == PowerMode::DeepSleep) {
+    enterDeepSleep(nowMs);
   } else {
-    Serial.println("\nWiFi connection failed (continuing offline)");
+    // Modem sleep: radio is off, idle the CPU until the next task (or LED frame) is due
+    uint32_t untilSample = untilNextSample(nowMs);
+    uint32_t maxIdle = ledAnim.idle(nowMs) ? settings.sampleMs : LED_FRAME_MS;
+    if (untilSample > 0) delay(min<uint32_t>(untilSample, maxIdle));
   }
 }
 
-// Connect to HiveMQ MQTT broker
-static void mqttConnect() {
-  if (mqtt.connected()) return;
-  
-  // Build publish topic on first connection
-  if (mqttPub == nullptr) {
-    mqttPub = new Adafruit_MQTT_Publish(&mqtt, MQTT_TOPIC);
-  }
-  
-  Serial.print("[MQTT] Connecting to HiveMQ... ");
-  int8_t ret = mqtt.connect();
-  if (ret == 0) {
-    Serial.println("Connected!");
+// Scheduler tasks. A start that finds its sensor still converting counts as an overrun.
+static void tickSgp(uint32_t nowMs) {
+  ScopedTimer timer(profiler, Stage::I2c);
+  WatchdogScope guard(watchdog, Stage::I2c);
+  (void)sensors.startSgp(nowMs);
+}
+
+static void tickSht(uint32_t nowMs) {
+  ScopedTimer timer(profiler, Stage::I2c);
+  WatchdogScope guard(watchdog, Stage::I2c);
+  (void)sensors.startSht(nowMs);
+}
+
+// Every sampleMs: condition the latest sensor values into a Reading and hand it to the outputs
+static void emitReading(uint32_t now) {
+  ScopedTimer timer(profiler, Stage::Reading);
+  WatchdogScope guard(watchdog, Stage::Reading);
+  bool warmingUp = (now - bootMs) < warmupMs;
+
+  //Defensive initialization: invalid sensor readings stay NAN / 0
+  const SensorSample& sample = sensors.latest();
+  Reading r;
+  r.tsMs = now;
+  r.boot = bootCounter.count();
+  r.epochMs = timekeeper.toEpochMs(now);
+  r.tC = sample.tC;
+  r.rh = sample.rh;
+  r.tvoc = sample.sgpValid ? sample.tvoc : 0; // Total Volatile Organic Compounds
+  r.eco2 = sample.sgpValid ? sample.eco2 : 0; // Equivalent CO2
+  r.warmingUp = warmingUp;
+  extraSensors.fill(r.extra, now);
+
+  JsonWriter json(sampleJson, sizeof(sampleJson));
+  bool report = readingPipeline.step(r, sample.sgpValid, json,
+                                     MQTT_BINARY_PAYLOAD ? sampleBin : nullptr, sizeof(sampleBin));
+
+  // From power-on until the warm-up expires the LED ignores air quality and pulses blue
+  if (warmingUp) {
+    ledAnim.setPulse();
   } else {
-    Serial.print("Failed: ");
-    Serial.println(mqtt.connectErrorString(ret));
+    // Hysteresis has stabilized the band; log its transitions
+    AqBandEvent change;
+    if (aqBands.takeEvent(change)) {
+      LOG_INFO("[AQ] %s -> %s (index %u)", AQ_BAND_NAMES[change.from],
+               AQ_BAND_NAMES[change.to], (unsigned)change.index);
+    }
+    ledAnim.setTarget(readingPipeline.color(), r.aqIndex, now);
   }
-}
 
-// Publish JSON to HiveMQ
-static bool publishToMQTT(const String& json) {
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("[MQTT] WiFi not connected");
-    return false;
+  if (sgpOk && !sensors.sgpBusy()) sgpBaseline.poll(now - bootMs);
+
+  LOG_DEBUG_LINE(json.c_str());       // Serial log (every sample)
+
+  if (report) {
+    // HiveMQ MQTT publication (best-effort): compact binary or the same JSON
+    if (MQTT_BINARY_PAYLOAD && readingPipeline.binLength() > 0) {
+      (void)publishToMQTT(sampleBin, readingPipeline.binLength());
+    } else if (!MQTT_BINARY_PAYLOAD && json.ok()) {
+      (void)publishToMQTT((const uint8_t*)json.c_str(), json.length());
+    } else {
+      droppedPublishes++;
+      LOG_WARN("[MQTT] Reading longer than its buffer (%u B), not published",
+               (unsigned)(MQTT_BINARY_PAYLOAD ? sizeof(sampleBin) : sizeof(sampleJson)));
+    }
+
+    queueUpload(r);             // Cloudflare Worker for D1 storage: queued and sent in batches (best-effort)
   }
 
-  mqttConnect();
-  
-  if (!mqtt.connected() || mqttPub == nullptr) {
-    Serial.println("[MQTT] Broker not connected");
-    return false;
+  if (r.stats.anomalies) {
+    LOG_INFO("[EDGE] Spike:%s%s (tvoc %u ppb, %d/min; eco2 %u ppm, %d/min)",
+             (r.stats.anomalies & READING_ANOMALY_TVOC_SPIKE) ? " tvoc" : "",
+             (r.stats.anomalies & READING_ANOMALY_ECO2_SPIKE) ? " eco2" : "",
+             (unsigned)r.tvoc, (int)r.stats.tvocRate, (unsigned)r.eco2, (int)r.stats.eco2Rate);
+    anomalyDue = true;
   }
+}
 
-  Serial.print("[MQTT] Publishing to " + String(MQTT_TOPIC) + "... ");
-  bool ok = mqttPub->publish(json.c_str());
-  if (ok) {
-    Serial.println("✓");
-  } else {
-    Serial.println("✗");
+// A verified image is staged: keep what only RAM holds, then boot into it
+// (the SGP30 stays powered, so the restart restores its baseline as a warm start)
+static void restartIfUpdated() {
+  if (!ota.restartPending() || sensors.busy() || extraSensors.busy()) return;
+  while (!pendingUploads.empty() && spillToFlash()) {}
+  if (sgpOk) sgpBaseline.save();
+  LOG_INFO("[OTA] Restarting into the new image");
+  asyncLog.flush();
+  ESP.restart();
+}
+
+// Start a telemetry message; large windows are split into numbered parts
+static void beginTelemetry(JsonWriter& w, uint8_t part) {
+  w.reset();
+  w.beginObject();
+  w.field("device_id", DEVICE_ID);
+  w.field("seq", telemetrySeq);
+  w.field("part", (uint32_t)part);
+}
+
+static void sendTelemetry(JsonWriter& w) {
+  w.endObject();
+  if (!w.ok() || !mqttLink.publishTo(MQTT_TELEMETRY_TOPIC, (const uint8_t*)w.c_str(), w.length())) {
+    telemetryDropped++;
   }
-  return ok;
 }
 
-static bool postToWorker(const String& json) {
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("[WORKER] WiFi not connected");
-    return false;
+// Every TELEMETRY_MS: heap, link counters and per-stage latency histograms,
+// then a fresh profiling window. Skipped (but still reset) while MQTT is down.
+static void publishTelemetry(uint32_t nowMs) {
+  if (nowMs - lastTelemetryMs < TELEMETRY_MS) return;
+  lastTelemetryMs = nowMs;
+  telemetrySeq++;
+
+  if (mqttLink.online()) {
+    JsonWriter w(telemetryJson, sizeof(telemetryJson));
+    uint8_t part = 0;
+    beginTelemetry(w, part);
+    w.field("uptime_ms", nowMs);
+    w.field("fw", FIRMWARE_VERSION);
+    w.key("heap");
+    w.beginObject();
+    w.field("free", (uint32_t)ESP.getFreeHeap());
+    w.field("min_free", profiler.minFreeHeap());
+    w.field("max_block", (uint32_t)ESP.getMaxFreeBlockSize());
+    w.field("frag", (uint32_t)ESP.getHeapFragmentation());
+    w.field("tls_up_free", tlsUpFreeHeap);
+    w.field("tls_up_max_block", tlsUpMaxBlock);
+    w.endObject();
+    w.field("wifi_reconnects", wifi.reconnects());
+    w.field("mqtt_reconnects", mqttLink.reconnects());
+    w.field("mqtt_unacked", (uint32_t)mqttLink.queued());
+    w.field("mqtt_retx", mqttLink.retransmits());
+    w.field("log_dropped", asyncLog.dropped());
+    w.field("i2c_errors", sensors.errors());
+    w.key("tls");
+    w.beginObject();
+    w.field("mqtt", TlsTrust::name(mqttTrust.active()));
+    w.field("http", TlsTrust::name(workerTrust.active()));
+    w.endObject();
+    w.field("sensor_errors", extraSensors.errors());
+    w.field("anomalies", edgeStats.anomalies());
+    w.field("config_rev", settings.rev);
+    w.key("watchdog");
+    w.beginObject();
+    w.field("hw_resets", watchdog.hardResets());
+    w.field("http_resets", watchdog.resets(Watched::Http));
+    w.field("mqtt_resets", watchdog.resets(Watched::Mqtt));
+    w.key("stalls");
+    w.beginObject();
+    for (uint8_t i = 0; i < (uint8_t)Stage::Count; i++) {
+      if (watchdog.stalls((Stage)i) > 0) w.field(Profiler::name((Stage)i), watchdog.stalls((Stage)i));
+    }
+    w.endObject();
+    w.endObject();
+    w.field("uploads_dropped", droppedUploads);
+    w.field("publish_dropped", droppedPublishes);
+    w.field("telemetry_dropped", telemetryDropped);
+    w.field("offline_pending", offlineLog.pending());
+    // Histogram bucket edges (µs); the last bucket is open-ended
+    w.key("edges_us");
+    w.beginArray();
+    for (uint8_t b = 0; b + 1 < PROFILE_BUCKETS; b++) w.value(Profiler::bucketLimitUs(b));
+    w.endArray();
+
+    w.key("stages");
+    w.beginObject();
+    size_t stagesStart = w.length();
+    for (uint8_t i = 0; i < (uint8_t)Stage::Count; i++) {
+      Stage stage = (Stage)i;
+      const StageStats& st = profiler.stats(stage);
+      size_t mark = w.length();
+      w.key(Profiler::name(stage));
+      w.beginObject();
+      w.field("n", st.n);
+      w.field("avg_us", st.n ? st.sumUs / st.n : 0u);
+      w.field("p99_us", profiler.percentileUs(stage, 99));
+      w.field("max_us", st.maxUs);
+      w.key("hist");
+      w.beginArray();
+      uint8_t used = PROFILE_BUCKETS;
+      while (used > 0 && st.hist[used - 1] == 0) used--;   // trailing empty buckets are implied
+      for (uint8_t b = 0; b < used; b++) w.value(st.hist[b]);
+      w.endArray();
+      w.endObject();
+
+      // Doesn't fit: send what we have and carry on in the next part
+      // (a stage too big even for an empty part is dropped)
+      if (!w.ok()) {
+        w.truncate(mark);
+        if (mark == stagesStart) continue;
+        w.endObject();
+        sendTelemetry(w);
+        beginTelemetry(w, ++part);
+        w.key("stages");
+        w.beginObject();
+        stagesStart = w.length();
+        i--;
+      }
+    }
+    w.endObject();
+    sendTelemetry(w);
   }
 
-  BearSSL::WiFiClientSecure client;
-  client.setInsecure();
+  profiler.reset();
+}
 
-  if (!client.connect("airq-5xv.pages.dev", 443)) {
-    Serial.println("[WORKER] Connection failed");
-    return false;
+// A slave reset in the middle of a read can hold SDA low: clock out the rest of
+// its byte (at most 9 pulses) and send a STOP, then hand the pins back to Wire
+static void recoverI2cBus() {
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, OUTPUT_OPEN_DRAIN);
+  for (uint8_t i = 0; i < 9 && digitalRead(SDA) == LOW; i++) {
+    digitalWrite(SCL, LOW);
+    delayMicroseconds(5);
+    digitalWrite(SCL, HIGH);
+    delayMicroseconds(5);
   }
+  pinMode(SDA, OUTPUT_OPEN_DRAIN);
+  digitalWrite(SDA, LOW);
+  delayMicroseconds(5);
+  digitalWrite(SDA, HIGH);
+  Wire.begin();
+}
 
-  String post = String("POST /api/store HTTP/1.1\r\n") +
-                "Host: airq-5xv.pages.dev\r\n" +
-                "Content-Type: application/json\r\n" +
-                "Content-Length: " + json.length() + "\r\n" +
-                "Connection: close\r\n" +
-                "\r\n" +
-                json;
-
-  Serial.print("[WORKER] POSTing... ");
-  client.print(post);
-  
-  // Read response status line
-  String statusLine = client.readStringUntil('\n');
-  bool success = statusLine.indexOf("200") > 0;
-  
-  if (success) {
-    Serial.println("✓");
-  } else {
-    Serial.println("✗ (" + statusLine + ")");
+// Sensors that were missing at boot (or add-ons that stopped answering) are
+// probed again instead of staying off for the whole uptime. A late SGP30 starts
+// its IAQ algorithm (and warm-up) then.
+static void reprobeSensors(uint32_t nowMs) {
+  if ((shtOk && sgpOk && !extraSensors.missing()) || sensors.busy() || extraSensors.busy()) return;
+  if (nowMs - lastProbeMs < SENSOR_REPROBE_MS) return;
+  lastProbeMs = nowMs;
+
+  recoverI2cBus();
+  (void)extraSensors.reprobe(nowMs);
+  if (!shtOk && sht31.begin(SHT31_ADDR)) {
+    shtOk = true;
+    LOG_INFO("[SENSOR] SHT31 found at 0x%02X", SHT31_ADDR);
   }
+  if (!sgpOk && sgp.begin(&Wire, true)) {
+    sgpOk = true;
+    bootMs = nowMs;
+    warmupMs = settings.warmupMs;
+    if (fsOk && sgpBaseline.restore(false)) warmupMs = WARMUP_RESTORED_MS;
+    baselineAwaitsClock = fsOk && !sgpBaseline.restored();
+    LOG_INFO("[SENSOR] SGP30 found at 0x%02X, IAQ algorithm started", SGP30_ADDR);
+  }
+  sensors.enable(shtOk, sgpOk);
+}
 
-  client.stop();
-  return success;
+// Put settings in force in one go: everything they touch runs from loop(), so
+// no task sees part old, part new values. warmupMs is left to the caller.
+static void applySettings(const DeviceSettings& s) {
+  if (readingTask >= 0) scheduler.setInterval(readingTask, s.sampleMs);
+  reportFilter.setHeartbeat(s.heartbeatMs);
+  ledAnim.setBrightness(s.ledBrightness);
+  aqBandTable = makeAqBandTable<AQ_BAND_COUNT>({s.aqLow, s.aqHigh}, s.aqHysteresis);
+  aqColors = makeAqColorLut(s.aqLow, s.aqHigh);
 }
 
+// A message on MQTT_CONFIG_TOPIC: validated as a whole, persisted, then applied
+static void pollRemoteConfig(uint32_t nowMs) {
+  size_t len;
+  if (!mqttLink.takeMessage(configMsg, sizeof(configMsg), len) || len == 0) return;  // 0: retained copy cleared
+
+  DeviceSettings next;
+  const char* error = remoteConfig.parse((const char*)configMsg, len, next);
+  if (error) {
+    LOG_WARN("[CONFIG] Message rejected: %s", error);
+    return;
+  }
+  if (next.rev == settings.rev) return;   // already in force
+
+  if (!remoteConfig.accept(next)) LOG_WARN("[CONFIG] Not saved, rev %lu lasts until reboot", (unsigned long)next.rev);
+  applySettings(settings);
+  // Still warming up: the new length counts from the same start (a restored baseline keeps its short one)
+  if (nowMs - bootMs < warmupMs && !sgpBaseline.restored()) warmupMs = settings.warmupMs;
+
+  LOG_INFO("[CONFIG] rev %lu: sample %lu ms, batch %u / %lu ms, heartbeat %lu ms, LED %u, AQ %u/%u (hysteresis %u)",
+           (unsigned long)settings.rev, (unsigned long)settings.sampleMs, (unsigned)settings.batchSamples,
+           (unsigned long)settings.batchAgeMs, (unsigned long)settings.heartbeatMs,
+           (unsigned)settings.ledBrightness, (unsigned)settings.aqLow, (unsigned)settings.aqHigh,
+           (unsigned)settings.aqHysteresis);
+}
+
+// Network state machines that stop making progress are aborted on their own;
+// the uploads and QoS1 messages they carried are retried as after any failure
+static void superviseNetwork() {
+  uint32_t ms = millis();   // both machines track progress on millis()
+  if (watchdog.supervise(Watched::Http, worker.busy(), worker.lastProgressMs(), WATCHDOG_HTTP_MS, ms)) {
+    worker.abort();
+  }
+  if (watchdog.supervise(Watched::Mqtt, mqttLink.online(), mqttLink.lastRxMs(), WATCHDOG_MQTT_MS, ms)) {
+    mqttLink.reset("Watchdog: no inbound traffic");
+  }
+}
 
 void setup() {
-  bootMs = millis();
+  power.begin();
   Serial.begin(115200);
+  asyncLog.begin(Serial);
   delay(50);
+  watchdog.begin();   // reports a watchdog reset of the previous boot
+  mqttTrust.begin();  // key material parsed once, before the heap fragments
+  workerTrust.begin();
+
+  // After a deep-sleep wake the virtual clock, upload queue and LED state carry on
+  if (power.wokeFromSleep()) {
+    const SleepState& st = power.state();
+    bootMs = 0;  // warm-up is measured from power-on
+    aqBands.restore(st.aqBand);
+    warmupMs = st.warmupMs;
+    sgpBaseline.resume(st.baselineTrusted, st.baselineSavedMs);
+    timekeeper.restore(st.clock);
+    reportFilter.restore(st.report);
+    edgeStats.restore(st.edge);
+    anomalyDue = st.anomalyDue;
+    for (size_t i = 0; i < st.stashCount; i++) {
+      Reading r;
+      if (decodeReadingBinary(st.stash + i * READING_BIN_LEN, READING_BIN_LEN, r)) pendingUploads.push(r);
+    }
+  } else {
+    bootMs = power.uptimeMs();
+  }
 
   Wire.begin(); // D1 mini default I2C pins
 
-  leds.begin();
-  leds.clear();
-  leds.show();
+  ledAnim.begin(settings.ledBrightness, !power.wokeFromSleep());
 
-  shtOk = sht31.begin(0x45); 
+  shtOk = sht31.begin(SHT31_ADDR); 
   //When there is a SHT sensor, use I2C, talk to device at address 0x45 (BEWARE, NOT THE USUAL 0x44!), return if it is acknowledged.
-  sgpOk = sgp.begin();
+  // After deep sleep the SGP30 stayed powered and its on-chip IAQ algorithm is still
+  // running, so skip IAQinit; its baseline is also kept in RTC memory (SleepState).
+  sgpOk = sgp.begin(&Wire, !power.wokeFromSleep());
   // When there is a SGP sensor, use it at its only possible I2C address, return if it is acknowledged.
 
-  if (!shtOk) Serial.println("{\"error\":\"SHT3x not found\"}");
-  if (!sgpOk) Serial.println("{\"error\":\"SGP30 not found\"}");
-
-  if (sgpOk) sgp.IAQinit(); //Start internal air-quality algorithm and baseline tracking.
+  // Self-test: a sensor that didn't answer may sit behind a bus held low by an
+  // interrupted transfer; free the bus and probe once more
+  if (!shtOk || !sgpOk) {
+    recoverI2cBus();
+    if (!shtOk) shtOk = sht31.begin(SHT31_ADDR);
+    if (!sgpOk) sgpOk = sgp.begin(&Wire, !power.wokeFromSleep());
+  }
 
-  wifiConnect();
-}
+  sensors.enable(shtOk, sgpOk);
 
-void loop() {
-  uint32_t now = millis();
-  bool warmingUp = (now - bootMs) < WARMUP_MS;
+  if (!shtOk) LOG_ERROR("{\"error\":\"SHT3x not found\"}");
+  if (!sgpOk) LOG_ERROR("{\"error\":\"SGP30 not found\"}");
 
-  // Keep MQTT alive
-  mqtt.processPackets(10);
-  if (!mqtt.ping()) {
-    mqttConnect();
+  // Mounts LittleFS; readings left over from a previous outage are backfilled once uploads succeed
+  fsOk = offlineLog.begin();
+  if (!fsOk) LOG_ERROR("{\"error\":\"LittleFS unavailable, offline queue disabled\"}");
+  if (fsOk) bootCounter.begin(power.wokeFromSleep());
+  if (fsOk && remoteConfig.load()) {
+    applySettings(settings);
+    if (!power.wokeFromSleep()) warmupMs = settings.warmupMs;   // the baseline restore below may shorten it
+  }
+  ota.begin(!power.wokeFromSleep());  // counts the boot if this image is on trial
+  snprintf(backfillPath, sizeof(backfillPath), "/api/store?device_id=%s", DEVICE_ID);
+
+  if (sgpOk && !power.wokeFromSleep()) {
+    sgp.IAQinit(); //Start internal air-quality algorithm and baseline tracking.
+
+    // Skip the 12 h re-learning when a usable baseline snapshot exists.
+    // Any reset other than power-on (button, watchdog, OTA restart) left the sensor powered.
+    rst_info* info = ESP.getResetInfoPtr();
+    bool warmRestart = info != nullptr && info->reason != REASON_DEFAULT_RST;
+    if (fsOk && sgpBaseline.restore(warmRestart)) warmupMs = WARMUP_RESTORED_MS;
+    baselineAwaitsClock = fsOk && !sgpBaseline.restored();
   }
 
-  // Sample cadence (SGP30 IAQ wants ~1 Hz; keep SAMPLE_MS around 1000 in config.h)
-  if (now - lastSample >= SAMPLE_MS) {
-    lastSample = now;
+  timekeeper.begin(NTP_SERVER_1, NTP_SERVER_2);  // background SNTP, syncs once WiFi is up
 
-    //Defensive initialization
-    float tC = NAN;
-    float rh = NAN;
+  // Task deadlines run on the virtual clock and survive deep sleep
+  uint32_t now = power.uptimeMs();
+  scheduler.add("sgp30", SGP30_INTERVAL_MS, tickSgp, now);
+  scheduler.add("sht31", SHT_INTERVAL_MS, tickSht, now);
+  readingTask = scheduler.add("reading", settings.sampleMs, emitReading, now + READING_PHASE_MS);
 
-    // If SHT sensor is present and initialized, attempt to read temperature/humidity.  
-    if (shtOk) {
-      tC = sht31.readTemperature();
-      rh = sht31.readHumidity();
-    }
-    // If the SHT sensor readings are actually valid numerical values, do the math for absolute humidity into SGP compensation
-    if (!isnan(tC) && !isnan(rh)) {
-      uint32_t ah = absoluteHumidity_mgm3(tC, rh);
-      sgp.setHumidity(ah); // From Adafruit SGP30 library
-    }
+  if (SENSOR_PMS5003) {
+    pmsSerial.begin(9600);
+    (void)extraSensors.add(pms);
+  }
+  if (SENSOR_SCD4X) (void)extraSensors.add(scd4x);
+  extraSensors.begin(now);   // logs add-ons that didn't answer
+  if (power.wokeFromSleep()) {
+    for (uint8_t i = 0; i < Scheduler::MAX_TASKS; i++) scheduler.setDeadline(i, power.state().deadlines[i]);
+  }
 
-uint16_t tvoc = 0; // Total Volatile Organic Compounds
-uint16_t eco2 = 0; // Equivalent CO2
+  mqttLink.subscribe(MQTT_CONFIG_TOPIC);
 
-if (sgpOk) {
-  bool ok = sgp.IAQmeasure();  // Trigger single SGP measurement step
-  if (ok) {
-    tvoc = sgp.TVOC; // Total Volatile Organic Compounds
-    eco2 = sgp.eCO2; // Equivalent CO2
+  if (power.mode() == PowerMode::AlwaysOn) {
+    wifi.begin();  // non-blocking: sampling starts right away, uploads once associated
+  } else {
+    wifi.suspend();  // radio stays off until an upload window opens
   }
 }
 
+// After a power-on the baseline snapshot's age is unknown until SNTP has synced;
+// retry the restore then, as long as the sensor is still re-learning
+static void restoreBaselineOnSync(uint32_t nowMs) {
+  if (!baselineAwaitsClock || !timekeeper.synced() || sensors.busy()) return;
+  baselineAwaitsClock = false;
+  if (sgpBaseline.trusted() || !sgpBaseline.restore(false)) return;
+  if (warmupMs > WARMUP_RESTORED_MS) warmupMs = max<uint32_t>(WARMUP_RESTORED_MS, nowMs - bootMs);
+}
 
+void loop() {
+  uint32_t now = power.uptimeMs();
+  timekeeper.poll(now);
+  restoreBaselineOnSync(now);
+  reprobeSensors(now);
+
+  uint32_t loopStart = ESP.getCycleCount();
+
+  // Sensor ticks and readings are due on their own schedules; conversions
+  // complete in the background and are collected here
+  scheduler.run(now);
+  {
+    ScopedTimer timer(profiler, Stage::I2c);
+    WatchdogScope guard(watchdog, Stage::I2c);
+    sensors.poll(now);
+    extraSensors.poll(now);
+  }
 
-uint16_t idx = tvocToIndex(tvoc);
-
-    uint32_t ledColor;  //led color!
-    if (warmingUp) {
-      ledColor = pulsingBlue(now);
-    } else {
-      // Apply hysteresis to stabilize LED color transitions
-      idx = applyHysteresis(idx);
-      lastAqIndex = idx;
-      ledColor = colorForIndex(idx);
-    }
-
-setLed(ledColor);
-
-// Build a JSON payload manually (kept small to reduce heap usage on ESP8266)
-String json = "{";
-json += "\"ts_ms\":" + String(now) + ",";                 // Time since boot (ms)
-json += "\"device_id\":\"" + String(DEVICE_ID) + "\",";   // Device ID
-json += "\"t_c\":" + String(tC, 2) + ",";                 // Temp (°C)
-json += "\"rh\":" + String(rh, 2) + ",";                  // Humidity (%)
-json += "\"tvoc_ppb\":" + String(tvoc) + ",";             // TVOC (ppb)
-json += "\"eco2_ppm\":" + String(eco2) + ",";             // eCO2 (ppm)
-json += "\"aq_index\":" + String(idx) + ",";              // AQ index (0–100)
-json += "\"warming_up\":" + String(warmingUp ? "true" : "false"); // Warmup flag
-json += "}";  // End JSON
-
-Serial.println(json);      // Serial log
-(void)publishToMQTT(json);    // HiveMQ MQTT publication (best-effort)
-(void)postToWorker(json);     // Cloudflare Worker for D1 storage (best-effort)
-
+  // Sampling and the LED run first; network work gets one bounded step afterwards
+  {
+    ScopedTimer timer(profiler, Stage::Led);
+    WatchdogScope guard(watchdog, Stage::Led);
+    ledAnim.poll(now);
+  }
+  {
+    ScopedTimer timer(profiler, Stage::Wifi);
+    WatchdogScope guard(watchdog, Stage::Wifi);
+    wifi.poll();
   }
+  pollNetwork(now);
+  pollRemoteConfig(now);
+  superviseNetwork();
+  if (ota.onTrial() && mqttLink.acked() > 0) ota.confirm();  // came up and published
+  restartIfUpdated();
+  reportStats(now);
+  publishTelemetry(now);
+  asyncLog.poll();   // serial output: only what fits in the UART FIFO
+
+  // Loop time excludes the idle/sleep in managePower()
+  profiler.record(Stage::Loop, ESP.getCycleCount() - loopStart);
+  profiler.noteHeap();
+  managePower(now);
 }
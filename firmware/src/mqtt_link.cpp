@@ -0,0 +1,407 @@
+#include "mqtt_link.h"
+
+#include <ESP8266WiFi.h>
+
+#include "log.h"
+
+// Reconnect backoff: doubles from MIN to MAX after each failed attempt
+static const uint32_t MQTT_BACKOFF_MIN_MS = 2000;
+static const uint32_t MQTT_BACKOFF_MAX_MS = 60000;
+// Ping after this much silence; well inside the library's keepalive (MQTT_CONN_KEEPALIVE)
+static const uint32_t MQTT_PING_INTERVAL_MS = 60000;
+// A PUBACK or PINGRESP this late means the connection is dead
+static const uint32_t MQTT_ACK_TIMEOUT_MS = 15000;
+// Inbound bytes handled per poll()
+static const uint16_t MQTT_RX_BUDGET = 64;
+
+static const uint8_t MQTT_PUBLISH_QOS1 = 0x32;
+static const uint8_t MQTT_SUBSCRIBE = 0x82;
+static const uint8_t MQTT_PUBACK = 0x40;
+static const uint8_t MQTT_DUP_FLAG = 0x08;
+static const uint8_t MQTT_TYPE_PUBLISH = 3;
+static const uint8_t MQTT_TYPE_PUBACK = 4;
+static const uint8_t MQTT_TYPE_SUBACK = 9;
+static const uint8_t MQTT_TYPE_PINGRESP = 13;
+static const uint8_t MQTT_SUBACK_FAILURE = 0x80;
+
+MqttLink::MqttLink(const char* broker, uint16_t port, const char* user, const char* pass, const char* topic,
+                   uint8_t window, TlsTrust& trust)
+  : _trust(trust),
+    _mqtt(&_tls, broker, port, user, pass),
+    _port(port),
+    _topic(topic),
+    _window(constrain(window, 1, MQTT_OUTBOX_SLOTS)) {}
+
+void MqttLink::scheduleRetry(uint32_t nowMs) {
+  _backoffMs = (_backoffMs == 0) ? MQTT_BACKOFF_MIN_MS : min<uint32_t>(_backoffMs * 2, MQTT_BACKOFF_MAX_MS);
+  _nextAttemptMs = nowMs + _backoffMs;
+  _state = State::Backoff;
+}
+
+// Unacknowledged messages go back to the queue and are resent after the next CONNECT
+void MqttLink::requeueInFlight() {
+  for (uint8_t i = 0; i < _count; i++) {
+    Slot& s = slotAt(i);
+    if (s.state == SlotState::InFlight) s.state = SlotState::Queued;
+  }
+  _inFlight = 0;
+  _pingPending = false;
+  _in = Inbound();
+}
+
+void MqttLink::dropLink(uint32_t nowMs, const char* why) {
+  LOG_WARN("[MQTT] %s (%u unacknowledged)", why, (unsigned)_inFlight);
+  _mqtt.disconnect();
+  requeueInFlight();
+  scheduleRetry(nowMs);
+}
+
+void MqttLink::reset(const char* why) {
+  if (_state != State::Online && _state != State::Connecting) return;
+  dropLink(millis(), why);
+}
+
+bool MqttLink::takeHandshake(uint32_t& cycles) {
+  if (!_handshakeTimed) return false;
+  _handshakeTimed = false;
+  cycles = _handshakeCycles;
+  return true;
+}
+
+void MqttLink::connectNow() {
+  if (!_trust.apply(_tls, _port)) {
+    scheduleRetry(millis());
+    return;
+  }
+  _tls.setSession(&_session);  // resume the previous TLS session when the broker allows it
+  LOG_INFO("[MQTT] Connecting to HiveMQ...");
+
+  // Blocking: TLS handshake plus CONNACK wait, bounded by the library's CONNECT timeout
+  uint32_t start = ESP.getCycleCount();
+  int8_t ret = _mqtt.connect();
+  _handshakeCycles = ESP.getCycleCount() - start;
+  _handshakeTimed = true;
+  // -1: no connection (DNS, TCP or TLS, told apart by the BearSSL error); anything else got past TLS
+  _trust.noteHandshake(ret != -1, ret == -1 ? _tls.getLastSSLError() : 0);
+  uint32_t now = millis();
+  if (ret == 0) {
+    LOG_INFO("[MQTT] Connected (%u queued)", (unsigned)_count);
+    _state = State::Online;
+    _backoffMs = 0;
+    _lastTxMs = now;
+    _lastRxMs = now;
+    _reconnects++;
+    if (!sendSubscribe()) dropLink(now, "Subscribe failed");
+  } else {
+    char err[48];
+    strncpy_P(err, (PGM_P)_mqtt.connectErrorString(ret), sizeof(err) - 1);
+    err[sizeof(err) - 1] = '\0';
+    LOG_WARN("[MQTT] Connect failed: %s", err);
+    _mqtt.disconnect();
+    scheduleRetry(now);
+  }
+}
+
+// SUBSCRIBE (QoS1) to _subTopic; true if there is nothing to subscribe to
+bool MqttLink::sendSubscribe() {
+  if (_subTopic == nullptr || _subTopic[0] == '\0') return true;
+  size_t topicLen = strlen(_subTopic);
+  if (topicLen > MQTT_TOPIC_MAX) return false;
+  uint8_t pkt[2 + 2 + 2 + MQTT_TOPIC_MAX + 1];
+  size_t n = 0;
+  pkt[n++] = MQTT_SUBSCRIBE;
+  pkt[n++] = (uint8_t)(2 + 2 + topicLen + 1);   // < 128: one length byte
+  pkt[n++] = (uint8_t)(_nextPacketId >> 8);
+  pkt[n++] = (uint8_t)_nextPacketId;
+  pkt[n++] = (uint8_t)(topicLen >> 8);
+  pkt[n++] = (uint8_t)topicLen;
+  memcpy(pkt + n, _subTopic, topicLen);
+  n += topicLen;
+  pkt[n++] = 1;   // requested QoS
+  _nextPacketId = _nextPacketId == 0xFFFF ? 1 : _nextPacketId + 1;
+  _lastTxMs = millis();
+  return writeAll(pkt, n);
+}
+
+bool MqttLink::writeAll(const uint8_t* data, size_t len) {
+  while (len > 0) {
+    size_t n = _tls.write(data, len);
+    if (n == 0) return false;
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+// PUBLISH (QoS1): fixed header, remaining length, topic, packet id, payload
+bool MqttLink::sendPublish(Slot& slot, uint32_t nowMs) {
+  size_t topicLen = strlen(slot.topic);
+  if (topicLen > MQTT_TOPIC_MAX) return false;
+  uint8_t head[5 + 2 + MQTT_TOPIC_MAX + 2];
+  size_t n = 0;
+  head[n++] = MQTT_PUBLISH_QOS1 | (slot.dup ? MQTT_DUP_FLAG : 0);
+  uint32_t remaining = 2 + topicLen + 2 + slot.len;
+  do {
+    uint8_t b = remaining % 128;
+    remaining /= 128;
+    head[n++] = remaining ? (b | 0x80) : b;
+  } while (remaining);
+  head[n++] = (uint8_t)(topicLen >> 8);
+  head[n++] = (uint8_t)topicLen;
+  memcpy(head + n, slot.topic, topicLen);
+  n += topicLen;
+  head[n++] = (uint8_t)(slot.packetId >> 8);
+  head[n++] = (uint8_t)slot.packetId;
+  if (!writeAll(head, n) || !writeAll(_pool + slot.at, slot.len)) return false;
+
+  if (slot.dup) _retransmits++;
+  slot.dup = true;
+  slot.state = SlotState::InFlight;
+  slot.sentMs = nowMs;
+  _inFlight++;
+  _lastTxMs = nowMs;
+  return true;
+}
+
+// Oldest queued message, if the window has room. Returns true if a packet was sent.
+bool MqttLink::sendNext(uint32_t nowMs) {
+  if (_inFlight >= _window) return false;
+  for (uint8_t i = 0; i < _count; i++) {
+    Slot& s = slotAt(i);
+    if (s.state != SlotState::Queued) continue;
+    if (!sendPublish(s, nowMs)) dropLink(nowMs, "Publish failed");
+    return true;
+  }
+  return false;
+}
+
+void MqttLink::handlePuback(uint16_t packetId) {
+  for (uint8_t i = 0; i < _count; i++) {
+    Slot& s = slotAt(i);
+    if (s.state == SlotState::InFlight && s.packetId == packetId) {
+      s.state = SlotState::Acked;
+      _inFlight--;
+      _acked++;
+      break;
+    }
+  }
+  // Release acknowledged slots from the front (PUBACKs normally arrive in order)
+  while (_count > 0 && slotAt(0).state == SlotState::Acked) {
+    uint16_t freed = slotAt(0).at;
+    slotAt(0).state = SlotState::Free;
+    _head = (_head + 1) % MQTT_OUTBOX_SLOTS;
+    _count--;
+    if (_count > 0 && slotAt(0).at < freed) _poolWrapped = false;   // the oldest payload is now the wrapped one
+  }
+}
+
+// Contiguous room for len payload bytes after the newest one
+bool MqttLink::reserve(size_t len, uint16_t& at) {
+  if (_count == 0) {
+    _poolTail = 0;
+    _poolWrapped = false;
+  }
+  uint16_t oldest = (_count > 0) ? slotAt(0).at : 0;
+  if (_poolWrapped) {
+    if (len > (size_t)(oldest - _poolTail)) return false;
+    at = _poolTail;
+  } else if (len <= MQTT_OUTBOX_BYTES - _poolTail) {
+    at = _poolTail;
+  } else if (len < oldest) {
+    at = 0;
+    _poolWrapped = true;
+  } else {
+    return false;
+  }
+  _poolTail = at + len;
+  return true;
+}
+
+// Inbound PUBLISH (QoS0/1): topic, packet id if QoS1, payload
+void MqttLink::handlePublish() {
+  const Inbound& in = _in;
+  uint8_t qos = (in.header >> 1) & 0x03;
+  if (in.stored < 2) return;
+  uint16_t topicLen = (uint16_t)((in.body[0] << 8) | in.body[1]);
+  size_t at = 2 + topicLen + (qos ? 2 : 0);
+  if (at > in.length || at > in.stored) {
+    dropLink(millis(), "Malformed PUBLISH");
+    return;
+  }
+
+  // Acknowledge even what is dropped below, or the broker redelivers it
+  if (qos == 1) {
+    uint8_t ack[4] = {MQTT_PUBACK, 0x02, in.body[at - 2], in.body[at - 1]};
+    if (!writeAll(ack, sizeof(ack))) {
+      dropLink(millis(), "PUBACK failed");
+      return;
+    }
+    _lastTxMs = millis();
+  }
+
+  bool ours = _subTopic != nullptr && strlen(_subTopic) == topicLen &&
+              memcmp(in.body + 2, _subTopic, topicLen) == 0;
+  size_t len = in.length - at;
+  if (!ours) return;
+  if (len > MQTT_INBOX_MAX) {
+    LOG_WARN("[MQTT] Message on %s too long (%u B), dropped", _subTopic, (unsigned)len);
+    return;
+  }
+  memcpy(_inbox, in.body + at, len);
+  _inboxLen = (uint16_t)len;
+  _inboxReady = true;
+}
+
+void MqttLink::handlePacket() {
+  uint8_t type = _in.header >> 4;
+  if (type == MQTT_TYPE_PUBACK && _in.stored >= 2) {
+    handlePuback((uint16_t)((_in.body[0] << 8) | _in.body[1]));
+  } else if (type == MQTT_TYPE_PINGRESP) {
+    _pingPending = false;
+  } else if (type == MQTT_TYPE_PUBLISH) {
+    handlePublish();
+  } else if (type == MQTT_TYPE_SUBACK && _in.stored >= 3) {
+    if (_in.body[2] == MQTT_SUBACK_FAILURE) {
+      LOG_WARN("[MQTT] Subscription to %s refused", _subTopic);
+    } else {
+      LOG_INFO("[MQTT] Subscribed to %s", _subTopic);
+    }
+  }
+  // Anything else is ignored
+}
+
+bool MqttLink::takeMessage(uint8_t* out, size_t cap, size_t& len) {
+  if (!_inboxReady || _inboxLen > cap) return false;
+  _inboxReady = false;
+  memcpy(out, _inbox, _inboxLen);
+  len = _inboxLen;
+  return true;
+}
+
+// Parse inbound packets incrementally from whatever bytes have arrived
+void MqttLink::readInbound() {
+  _lastRxMs = millis();
+  for (uint16_t budget = MQTT_RX_BUDGET; budget > 0 && _tls.available() > 0; budget--) {
+    int c = _tls.read();
+    if (c < 0) return;
+    uint8_t b = (uint8_t)c;
+    Inbound& in = _in;
+
+    if (in.header == 0) {
+      in = Inbound();
+      in.header = b;
+      in.multiplier = 1;
+      continue;
+    }
+    if (!in.lenDone) {
+      in.remaining += (b & 0x7F) * in.multiplier;
+      in.multiplier *= 128;
+      in.lenBytes++;
+      if (!(b & 0x80)) {
+        in.lenDone = true;
+        in.length = in.remaining;
+      } else if (in.lenBytes == 4) {
+        dropLink(millis(), "Malformed packet");
+        return;
+      }
+    } else {
+      if (in.stored < sizeof(in.body)) in.body[in.stored++] = b;
+      in.remaining--;
+    }
+    if (in.lenDone && in.remaining == 0) {
+      handlePacket();
+      in.header = 0;
+    }
+  }
+}
+
+void MqttLink::poll() {
+  uint32_t now = millis();
+
+  if (WiFi.status() != WL_CONNECTED) {
+    if (_state == State::Online) {
+      _mqtt.disconnect();
+      requeueInFlight();
+    }
+    _state = State::Offline;
+    return;
+  }
+
+  switch (_state) {
+    case State::Offline:
+      _state = State::Connecting;
+      return;
+
+    case State::Backoff:
+      if ((int32_t)(now - _nextAttemptMs) >= 0) _state = State::Connecting;
+      return;
+
+    case State::Connecting:
+      connectNow();
+      return;
+
+    case State::Online:
+      if (!_mqtt.connected()) {
+        LOG_WARN("[MQTT] Connection lost");
+        requeueInFlight();
+        scheduleRetry(now);
+        return;
+      }
+      if (_tls.available() > 0) {
+        readInbound();
+        return;
+      }
+      if (sendNext(now)) return;
+
+      // The oldest in-flight message is the first to time out
+      for (uint8_t i = 0; i < _count; i++) {
+        const Slot& s = slotAt(i);
+        if (s.state != SlotState::InFlight) continue;
+        if (now - s.sentMs >= MQTT_ACK_TIMEOUT_MS) {
+          dropLink(now, "PUBACK timeout");
+          return;
+        }
+        break;
+      }
+      if (_pingPending) {
+        if (now - _pingSentMs >= MQTT_ACK_TIMEOUT_MS) dropLink(now, "Ping timeout");
+        return;
+      }
+      // Publishes already keep the connection alive; only ping an idle link
+      if (now - _lastTxMs >= MQTT_PING_INTERVAL_MS) {
+        static const uint8_t PINGREQ[2] = {0xC0, 0x00};
+        if (!writeAll(PINGREQ, sizeof(PINGREQ))) {
+          dropLink(now, "Ping failed");
+          return;
+        }
+        _pingPending = true;
+        _pingSentMs = now;
+        _lastTxMs = now;
+      }
+      return;
+  }
+}
+
+bool MqttLink::publish(const uint8_t* payload, size_t len) {
+  return publishTo(_topic, payload, len);
+}
+
+bool MqttLink::publishTo(const char* topic, const uint8_t* payload, size_t len) {
+  uint16_t at;
+  if (_state != State::Online || _count >= MQTT_OUTBOX_SLOTS || len > MQTT_PAYLOAD_MAX ||
+      strlen(topic) > MQTT_TOPIC_MAX || !reserve(len, at)) {
+    _rejected++;
+    return false;
+  }
+  Slot& s = slotAt(_count);
+  s.state = SlotState::Queued;
+  s.dup = false;
+  s.topic = topic;
+  s.packetId = _nextPacketId;
+  s.at = at;
+  s.len = (uint16_t)len;
+  memcpy(_pool + at, payload, len);
+  _count++;
+  _nextPacketId = _nextPacketId == 0xFFFF ? 1 : _nextPacketId + 1;
+  return true;
+}
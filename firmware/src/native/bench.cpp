@@ -0,0 +1,154 @@
+#include <stdlib.h>
+
+#include "host.h"
+
+#include "config.example.h"
+#include "edge_stats.h"
+#include "humidity.h"
+#include "reading_codec.h"
+#include "reading_json.h"
+
+// Inputs are cycled through so the compiler can't fold the calls
+static const size_t INPUTS = 1024;
+static volatile uint32_t sink;
+
+// Time fn(i) over iterations calls; prints ns/call and heap allocations per call
+template <typename Fn>
+static void bench(const char* name, uint32_t iterations, Fn fn) {
+  for (uint32_t i = 0; i < iterations / 10; i++) sink = sink + fn(i);   // warm caches
+  uint64_t a0 = hostAllocations();
+  uint64_t t0 = hostNowNs();
+  for (uint32_t i = 0; i < iterations; i++) sink = sink + fn(i);
+  uint64_t ns = hostNowNs() - t0;
+  uint64_t allocs = hostAllocations() - a0;
+  printf("%-28s %10.1f ns/call %8.3f allocs/call\n", name,
+         (double)ns / iterations, (double)allocs / iterations);
+}
+
+// The float formula absoluteHumidityMgM3() replaced, for comparison
+static uint32_t absoluteHumidityFloat(float tC, float rh) {
+  float svp = 6.112f * expf((17.62f * tC) / (243.12f + tC));
+  return (uint32_t)(1000.0f * 216.7f * (rh / 100.0f * svp) / (273.15f + tC));
+}
+
+// absoluteHumidityMgM3() against the same formula in double precision over the
+// SHT31 range (0.05 °C, 0.25 %RH steps): within 0.21 % once the rounding to whole
+// mg/m³ is allowed for. Prints the worst case; false if any point is outside.
+static bool checkHumidityAccuracy() {
+  const double limit = 0.0021;
+  double worst = 0;
+  int32_t worstT = 0, worstRh = 0;
+  for (int32_t t = -4000; t <= 8500; t += 5) {
+    double tC = t / 100.0;
+    double svp = 6.112 * exp((17.62 * tC) / (243.12 + tC));
+    for (int32_t rh = 0; rh <= 10000; rh += 25) {
+      double exact = 1000.0 * 216.74 * (rh / 10000.0 * svp) / (273.15 + tC);
+      if (exact <= 0) continue;
+      double err = fabs(absoluteHumidityMgM3(t, rh) - exact) - 0.5;
+      if (err / exact > worst) {
+        worst = err / exact;
+        worstT = t;
+        worstRh = rh;
+      }
+    }
+  }
+  bool ok = worst <= limit;
+  printf("%-28s %9.3f %% max error at %.2f C, %.2f %%RH (limit %.2f %%): %s\n", "absoluteHumidityMgM3 check",
+         worst * 100, worstT / 100.0, worstRh / 100.0, limit * 100, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+// Synthetic trace: slow temperature/humidity drift with TVOC bursts
+static TraceSample syntheticSample(uint32_t i) {
+  TraceSample s;
+  s.tsMs = i * SAMPLE_MS;
+  s.tC = 21.0f + 3.0f * sinf(i / 500.0f);
+  s.rh = 45.0f + 10.0f * sinf(i / 700.0f);
+  s.tvoc = (uint16_t)(60 + (i % 300 < 40 ? (i % 300) * 20 : 0) + (i * 7919) % 15);
+  s.eco2 = (uint16_t)(400 + s.tvoc / 2);
+  return s;
+}
+
+int runBench(int argc, char** argv) {
+  uint32_t n = argc >= 1 ? (uint32_t)strtoul(argv[0], nullptr, 10) : 1000000;
+  if (n < 1000) n = 1000;
+
+  static TraceSample samples[INPUTS];
+  static Reading readings[INPUTS];
+  static uint8_t records[INPUTS][READING_BIN_LEN];
+  for (size_t i = 0; i < INPUTS; i++) {
+    samples[i] = syntheticSample(i);
+    Reading& r = readings[i];
+    r = Reading{};
+    r.tsMs = samples[i].tsMs;
+    r.epochMs = 1760443200000ULL + r.tsMs;
+    r.tC = samples[i].tC;
+    r.rh = samples[i].rh;
+    r.tvoc = samples[i].tvoc;
+    r.eco2 = samples[i].eco2;
+    r.aqIndex = tvocToIndex(r.tvoc);
+    r.span = {30, r.tvoc, r.tvoc, r.tvoc, r.eco2, r.eco2, r.eco2, r.tC, r.tC, r.tC, r.rh, r.rh, r.rh};
+    encodeReadingBinary(r, records[i], READING_BIN_LEN);
+  }
+  static const AqColorLut lut = makeAqColorLut(AQ_THRESHOLD_LOW, AQ_THRESHOLD_HIGH);
+  static const AqBandTable<AQ_BAND_COUNT> bands = makeAqBandTable<AQ_BAND_COUNT>({AQ_THRESHOLD_LOW, AQ_THRESHOLD_HIGH}, AQ_HYSTERESIS_BAND);
+  AqBandClassifier<AQ_BAND_COUNT> classifier(bands);
+  ReportFilter filter({DEADBAND_TVOC_PPB, DEADBAND_ECO2_PPM, DEADBAND_T_C, DEADBAND_RH}, REPORT_HEARTBEAT_MS);
+  EdgeStats edge({SPIKE_TVOC_RISE_PPB, SPIKE_TVOC_PPB_PER_MIN}, {SPIKE_ECO2_RISE_PPM, SPIKE_ECO2_PPM_PER_MIN},
+                 EDGE_EWMA_SHIFT);
+  char json[READING_JSON_MAX];
+  uint8_t bin[READING_BIN_LEN];
+
+  bool accurate = checkHumidityAccuracy();
+
+  printf("%u iterations per benchmark\n", (unsigned)n);
+  bench("tvocToIndex", n, [&](uint32_t i) {
+    return (uint32_t)tvocToIndex(samples[i % INPUTS].tvoc);
+  });
+  bench("AqBandClassifier::apply", n, [&](uint32_t i) {
+    return (uint32_t)classifier.apply(readings[i % INPUTS].aqIndex);
+  });
+  bench("aqColorAt", n, [&](uint32_t i) {
+    return aqColorAt(lut, readings[i % INPUTS].aqIndex);
+  });
+  bench("absoluteHumidityMgM3", n, [&](uint32_t i) {
+    const TraceSample& s = samples[i % INPUTS];
+    return absoluteHumidityMgM3(scaledCenti(s.tC, -4000, 8500), scaledCenti(s.rh, 0, 10000));
+  });
+  bench("absoluteHumidity (float)", n, [&](uint32_t i) {
+    const TraceSample& s = samples[i % INPUTS];
+    return absoluteHumidityFloat(s.tC, s.rh);
+  });
+  bench("ReportFilter::offer", n, [&](uint32_t i) {
+    Reading r = readings[i % INPUTS];
+    r.tsMs = i * SAMPLE_MS;
+    return (uint32_t)filter.offer(r);
+  });
+  bench("EdgeStats::offer", n, [&](uint32_t i) {
+    Reading r = readings[i % INPUTS];
+    r.tsMs = i * SAMPLE_MS;
+    edge.offer(r, true);
+    return (uint32_t)r.stats.tvocEwma + r.stats.anomalies;
+  });
+  bench("writeReadingJson", n / 10, [&](uint32_t i) {
+    JsonWriter w(json, sizeof(json));
+    writeReadingJson(w, readings[i % INPUTS], DEVICE_ID);
+    return (uint32_t)w.length();
+  });
+  bench("encodeReadingBinary", n, [&](uint32_t i) {
+    return (uint32_t)encodeReadingBinary(readings[i % INPUTS], bin, sizeof(bin));
+  });
+  bench("decodeReadingBinary", n, [&](uint32_t i) {
+    Reading r;
+    return (uint32_t)decodeReadingBinary(records[i % INPUTS], READING_BIN_LEN, r) + r.tvoc;
+  });
+
+  // Whole per-reading path; the allocation count is per sample
+  HostPipeline pipeline;
+  bench("HostPipeline::step", n / 10, [&](uint32_t i) {
+    TraceSample s = samples[i % INPUTS];
+    s.tsMs = i * SAMPLE_MS;
+    return (uint32_t)pipeline.step(s);
+  });
+  return accurate ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+// Host-side harness for the platform-independent pipeline (env:native):
+// trace replay and micro-benchmarks. Never built into the firmware.
+
+#include "hal.h"
+
+#include "config.example.h"
+#include "aq_index.h"
+#include "edge_stats.h"
+#include "json_writer.h"
+#include "led_color.h"
+#include "reading.h"
+#include "reading_codec.h"
+#include "reading_json.h"
+#include "reading_pipeline.h"
+#include "report_filter.h"
+
+// main.cpp's READING_JSON_MAX with every add-on sensor field
+static const size_t READING_JSON_MAX = readingJsonMax(DEVICE_ID, READING_EXTRA_MAX);
+
+// One row of a recorded sensor trace
+struct TraceSample {
+  uint32_t tsMs;
+  float tC;        // NAN if the SHT31 had no value
+  float rh;
+  uint16_t tvoc;
+  uint16_t eco2;
+};
+
+// Reads traces captured from the device: either the serial log (one reading
+// JSON object per line, other lines are skipped) or CSV
+// "ts_ms,t_c,rh,tvoc_ppb,eco2_ppm" with '#' comments and an optional header.
+class TraceReader {
+public:
+  bool open(const char* path);   // "-" reads stdin
+  bool next(TraceSample& s);
+  void close();
+  uint32_t skipped() const { return _skipped; }
+
+private:
+  bool parseJson(const char* line, TraceSample& s);
+  bool parseCsv(const char* line, TraceSample& s);
+
+  FILE* _f = nullptr;
+  uint32_t _skipped = 0;
+  char _line[512];
+};
+
+// emitReading() in main.cpp with config.example.h defaults: the shared
+// ReadingPipeline (reading_pipeline.h), the warm-up pulse, and the SGP30
+// compensation humidity the sensor reader computes.
+class HostPipeline {
+public:
+  HostPipeline();
+
+  // Condition one sample; returns true if it would be reported
+  bool step(const TraceSample& s);
+
+  const Reading& reading() const { return _reading; }
+  const char* json() const { return _json; }
+  size_t jsonLength() const { return _jsonLen; }
+  bool jsonOk() const { return _jsonOk; }   // false if the last reading didn't fit READING_JSON_MAX
+  uint32_t color() const { return _color; }
+  uint32_t humidityMgM3() const { return _humidity; }
+  const ReportFilter& filter() const { return _filter; }
+  const EdgeStats& edge() const { return _edge; }
+  uint32_t bandTransitions() const { return _bands.transitions(); }
+
+private:
+  AqBandClassifier<AQ_BAND_COUNT> _bands;
+  ReportFilter _filter;
+  EdgeStats _edge;
+  ReadingPipeline _pipeline;
+  Reading _reading = {};
+  uint32_t _bootMs = 0;
+  bool _started = false;
+  uint32_t _color = 0;
+  uint32_t _humidity = 0;
+  size_t _jsonLen = 0;
+  bool _jsonOk = true;
+  char _json[READING_JSON_MAX];
+  uint8_t _bin[READING_BIN_LEN];
+};
+
+// Heap allocations since start (operator new is counted in host_main.cpp)
+uint64_t hostAllocations();
+
+// Monotonic nanoseconds
+uint64_t hostNowNs();
+
+int runReplay(int argc, char** argv);
+int runBench(int argc, char** argv);
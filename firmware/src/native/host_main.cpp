@@ -0,0 +1,40 @@
+#include <chrono>
+#include <new>
+#include <stdlib.h>
+
+#include "host.h"
+
+// Counting allocator: the pipeline must not touch the heap per sample
+static uint64_t allocations = 0;
+
+void* operator new(size_t n) {
+  allocations++;
+  void* p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+uint64_t hostAllocations() { return allocations; }
+
+uint64_t hostNowNs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: airq_host replay <trace|-> [--json]   replay a recorded trace\n"
+          "       airq_host bench [iterations]          micro-benchmarks\n");
+}
+
+int main(int argc, char** argv) {
+  if (argc >= 2 && strcmp(argv[1], "replay") == 0) return runReplay(argc - 2, argv + 2);
+  if (argc >= 2 && strcmp(argv[1], "bench") == 0) return runBench(argc - 2, argv + 2);
+  usage();
+  return 2;
+}
@@ -0,0 +1,46 @@
+#include "host.h"
+
+#include "config.example.h"
+#include "humidity.h"
+
+static const AqColorLut AQ_COLORS = makeAqColorLut(AQ_THRESHOLD_LOW, AQ_THRESHOLD_HIGH);
+static const AqBandTable<AQ_BAND_COUNT> AQ_BANDS = makeAqBandTable<AQ_BAND_COUNT>({AQ_THRESHOLD_LOW, AQ_THRESHOLD_HIGH}, AQ_HYSTERESIS_BAND);
+
+HostPipeline::HostPipeline()
+  : _bands(AQ_BANDS),
+    _filter({DEADBAND_TVOC_PPB, DEADBAND_ECO2_PPM, DEADBAND_T_C, DEADBAND_RH}, REPORT_HEARTBEAT_MS),
+    _edge({SPIKE_TVOC_RISE_PPB, SPIKE_TVOC_PPB_PER_MIN}, {SPIKE_ECO2_RISE_PPM, SPIKE_ECO2_PPM_PER_MIN},
+          EDGE_EWMA_SHIFT),
+    _pipeline(_bands, AQ_COLORS, _edge, _filter, DEVICE_ID) {
+  _json[0] = '\0';
+}
+
+bool HostPipeline::step(const TraceSample& s) {
+  if (!_started) {
+    _bootMs = s.tsMs;
+    _started = true;
+  }
+  bool warmingUp = (s.tsMs - _bootMs) < WARMUP_MS;
+
+  // SGP30 compensation input, as the sensor reader computes it per SHT31 sample
+  if (!isnan(s.tC) && !isnan(s.rh)) {
+    _humidity = absoluteHumidityMgM3(scaledCenti(s.tC, -4000, 8500), scaledCenti(s.rh, 0, 10000));
+  }
+
+  Reading& r = _reading;
+  r = Reading{};
+  r.tsMs = s.tsMs;
+  r.epochMs = 0;
+  r.tC = s.tC;
+  r.rh = s.rh;
+  r.tvoc = s.tvoc;
+  r.eco2 = s.eco2;
+  r.warmingUp = warmingUp;
+
+  JsonWriter w(_json, sizeof(_json));
+  bool report = _pipeline.step(r, true, w, _bin, sizeof(_bin));
+  _jsonOk = w.ok();
+  _jsonLen = w.length();
+  _color = warmingUp ? pulsingBlueAt(s.tsMs) : _pipeline.color();
+  return report;
+}
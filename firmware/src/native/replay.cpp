@@ -0,0 +1,139 @@
+#include <stdlib.h>
+
+#include "host.h"
+
+bool TraceReader::open(const char* path) {
+  close();
+  _skipped = 0;
+  _f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  return _f != nullptr;
+}
+
+void TraceReader::close() {
+  if (_f && _f != stdin) fclose(_f);
+  _f = nullptr;
+}
+
+bool TraceReader::next(TraceSample& s) {
+  while (_f && fgets(_line, sizeof(_line), _f)) {
+    const char* p = _line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') continue;
+    if (*p == '{' ? parseJson(p, s) : parseCsv(p, s)) return true;
+    _skipped++;   // serial log noise ([MQTT] ... lines), CSV header
+  }
+  return false;
+}
+
+// Number after "key": in a flat JSON object; NAN for null or a missing key
+static float jsonNumber(const char* line, const char* key) {
+  char pattern[32];
+  snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+  const char* p = strstr(line, pattern);
+  if (!p) return NAN;
+  p += strlen(pattern);
+  char* end;
+  float v = strtof(p, &end);
+  return end == p ? NAN : v;
+}
+
+bool TraceReader::parseJson(const char* line, TraceSample& s) {
+  float ts = jsonNumber(line, "ts_ms");
+  float tvoc = jsonNumber(line, "tvoc_ppb");
+  float eco2 = jsonNumber(line, "eco2_ppm");
+  if (isnan(ts) || isnan(tvoc) || isnan(eco2)) return false;
+  // ts_ms exceeds float precision after ~4.6 h: parse it as an integer
+  const char* p = strstr(line, "\"ts_ms\":");
+  s.tsMs = (uint32_t)strtoul(p + 8, nullptr, 10);
+  s.tC = jsonNumber(line, "t_c");
+  s.rh = jsonNumber(line, "rh");
+  s.tvoc = (uint16_t)tvoc;
+  s.eco2 = (uint16_t)eco2;
+  return true;
+}
+
+bool TraceReader::parseCsv(const char* line, TraceSample& s) {
+  char* end;
+  const char* p = line;
+  unsigned long ts = strtoul(p, &end, 10);
+  if (end == p || *end != ',') return false;
+  float f[4];
+  for (int i = 0; i < 4; i++) {
+    p = end + 1;
+    f[i] = strtof(p, &end);
+    if (end == p) f[i] = NAN;   // empty field: sensor had no value
+    if (i < 3 && *end != ',') return false;
+  }
+  if (isnan(f[2]) || isnan(f[3])) return false;
+  s.tsMs = (uint32_t)ts;
+  s.tC = f[0];
+  s.rh = f[1];
+  s.tvoc = (uint16_t)f[2];
+  s.eco2 = (uint16_t)f[3];
+  return true;
+}
+
+// Feed a trace through the pipeline: prints the reading JSON per sample with
+// --json (same lines as the device's serial log), then a summary
+int runReplay(int argc, char** argv) {
+  if (argc < 1) {
+    fprintf(stderr, "replay: trace path required\n");
+    return 2;
+  }
+  bool echo = argc >= 2 && strcmp(argv[1], "--json") == 0;
+
+  TraceReader trace;
+  if (!trace.open(argv[0])) {
+    fprintf(stderr, "replay: cannot open %s\n", argv[0]);
+    return 1;
+  }
+
+  HostPipeline pipeline;
+  TraceSample s;
+  uint32_t samples = 0;
+  uint32_t colorChanges = 0;
+  uint32_t lastColor = 0;
+  uint32_t firstMs = 0;
+  uint32_t lastMs = 0;
+  size_t jsonBytes = 0;
+  uint64_t stepNs = 0;
+  uint64_t allocs = 0;
+
+  while (trace.next(s)) {
+    uint64_t a0 = hostAllocations();
+    uint64_t t0 = hostNowNs();
+    pipeline.step(s);
+    stepNs += hostNowNs() - t0;
+    allocs += hostAllocations() - a0;
+    if (!pipeline.jsonOk()) {
+      fprintf(stderr, "replay: reading at %u ms is longer than READING_JSON_MAX (%u B)\n",
+              (unsigned)s.tsMs, (unsigned)READING_JSON_MAX);
+      return 1;
+    }
+
+    if (echo) puts(pipeline.json());
+    if (samples == 0) firstMs = s.tsMs;
+    else if (pipeline.color() != lastColor && !pipeline.reading().warmingUp) colorChanges++;
+    lastColor = pipeline.color();
+    lastMs = s.tsMs;
+    jsonBytes += pipeline.jsonLength();
+    samples++;
+  }
+  trace.close();
+
+  if (samples == 0) {
+    fprintf(stderr, "replay: no samples in %s\n", argv[0]);
+    return 1;
+  }
+  const ReportFilter& f = pipeline.filter();
+  fprintf(stderr, "[REPLAY] %u samples over %.1f min (%u lines skipped)\n",
+          (unsigned)samples, (lastMs - firstMs) / 60000.0, (unsigned)trace.skipped());
+  fprintf(stderr, "[REPLAY] reported=%u suppressed=%u (%.1f%% sent)\n",
+          (unsigned)f.reported(), (unsigned)f.suppressed(), 100.0 * f.reported() / samples);
+  fprintf(stderr, "[REPLAY] band transitions=%u, led color changes=%u, spikes=%u, mean json=%zu B\n",
+          (unsigned)pipeline.bandTransitions(), (unsigned)colorChanges,
+          (unsigned)pipeline.edge().anomalies(), jsonBytes / samples);
+  fprintf(stderr, "[REPLAY] %.0f ns/sample, %.2f allocations/sample\n",
+          (double)stepNs / samples, (double)allocs / samples);
+  return 0;
+}
@@ -0,0 +1,342 @@
+#include "offline_log.h"
+
+#include <LittleFS.h>
+
+#include "log.h"
+
+// The directory is tied to the record layout: segments are fixed-stride and
+// peek() reads record lengths with this image's decoder, so a READING_BIN_VERSION
+// bump (or a new READING_EXTRA_MAX) starts a fresh log. The
+// previous directory goes into OFFLINE_LEGACY with its stride, so readings an
+// older image left behind (e.g. the RAM queue spilled before an OTA restart)
+// are still delivered.
+static const char* OFFLINE_DIR = "/q7";
+static const char* OFFLINE_CURSOR = "/q7/cursor";
+static_assert(READING_BIN_VERSION == 7 && READING_BIN_LEN == 88,
+              "record layout changed: move the offline log to a new directory");
+
+struct LegacyLog {
+  const char* dir;
+  uint8_t stride;
+};
+// Oldest first: drained in this order
+static const LegacyLog OFFLINE_LEGACY[] = {
+  {"/q", 15},    // version 1
+  {"/q2", 21},   // version 2
+  {"/q3", 47},   // version 3
+  {"/q4", 68},   // version 4, 4 extra slots
+  {"/q5", 86},   // version 5
+  {"/q6", 88},   // version 6
+};
+static const int8_t OFFLINE_LEGACY_COUNT = sizeof(OFFLINE_LEGACY) / sizeof(OFFLINE_LEGACY[0]);
+
+// Persisted read position: which segment, and how far into it
+struct OfflineCursor {
+  uint32_t seq;
+  uint16_t offset;
+};
+
+OfflineLog::OfflineLog(uint16_t segmentRecords, uint8_t maxSegments)
+  : _segmentRecords(segmentRecords), _maxSegments(maxSegments) {}
+
+void OfflineLog::segmentPath(uint32_t seq, char* out, size_t cap) const {
+  snprintf(out, cap, "%s/%08lu", OFFLINE_DIR, (unsigned long)seq);
+}
+
+uint32_t OfflineLog::segmentRecords(uint32_t seq) const {
+  char path[24];
+  segmentPath(seq, path, sizeof(path));
+  File f = LittleFS.open(path, "r");
+  if (!f) return 0;
+  uint32_t n = f.size() / READING_BIN_LEN;
+  f.close();
+  return n;
+}
+
+static bool segmentSeq(const String& name, uint32_t& seq) {
+  char* end = nullptr;
+  seq = strtoul(name.c_str(), &end, 10);
+  return end != name.c_str() && *end == '\0';   // not a segment (e.g. the cursor)
+}
+
+static bool readCursor(const char* path, OfflineCursor& cursor) {
+  File f = LittleFS.open(path, "r");
+  if (!f) return false;
+  bool ok = f.read((uint8_t*)&cursor, sizeof(cursor)) == sizeof(cursor);
+  f.close();
+  return ok;
+}
+
+static void writeCursor(const char* path, const OfflineCursor& cursor) {
+  File f = LittleFS.open(path, "w");
+  if (!f) return;
+  f.write((const uint8_t*)&cursor, sizeof(cursor));
+  f.close();
+}
+
+void OfflineLog::removeDir(const char* path, const char* why) {
+  if (!LittleFS.exists(path)) return;
+  char file[32];
+  Dir dir = LittleFS.openDir(path);
+  while (dir.next()) {
+    snprintf(file, sizeof(file), "%s/%s", path, dir.fileName().c_str());
+    LittleFS.remove(file);
+  }
+  LittleFS.rmdir(path);
+  LOG_INFO("[OFFLINE] Removed log %s (%s)", path, why);
+}
+
+// Oldest segment of the legacy log being drained; false if it has none left
+bool OfflineLog::oldestLegacySegment(uint32_t& seq, uint32_t& records) const {
+  const LegacyLog& legacy = OFFLINE_LEGACY[_legacy];
+  bool found = false;
+  Dir dir = LittleFS.openDir(legacy.dir);
+  while (dir.next()) {
+    uint32_t s;
+    if (!segmentSeq(dir.fileName(), s) || (found && s > seq)) continue;
+    seq = s;
+    records = dir.fileSize() / legacy.stride;
+    found = true;
+  }
+  return found;
+}
+
+// Move to the next legacy log holding undelivered records, removing the
+// empty ones; false once all are drained
+bool OfflineLog::openLegacy() {
+  _legacyPending = 0;
+  for (_legacy++; _legacy < OFFLINE_LEGACY_COUNT; _legacy++) {
+    const LegacyLog& legacy = OFFLINE_LEGACY[_legacy];
+    if (!LittleFS.exists(legacy.dir)) continue;
+    if (!oldestLegacySegment(_legacySeq, _legacyRecords)) {
+      removeDir(legacy.dir, "drained");
+      continue;
+    }
+
+    Dir dir = LittleFS.openDir(legacy.dir);
+    while (dir.next()) {
+      uint32_t s;
+      if (segmentSeq(dir.fileName(), s)) _legacyPending += dir.fileSize() / legacy.stride;
+    }
+    char path[24];
+    snprintf(path, sizeof(path), "%s/cursor", legacy.dir);
+    OfflineCursor cursor;
+    _legacyOffset = 0;
+    if (readCursor(path, cursor) && cursor.seq == _legacySeq) {
+      _legacyOffset = min<uint32_t>(cursor.offset, _legacyRecords);
+    }
+    _legacyPending -= min<uint32_t>(_legacyPending, _legacyOffset);
+    LOG_INFO("[OFFLINE] %lu reading(s) to backfill from %s (older record format)",
+             (unsigned long)_legacyPending, legacy.dir);
+    return true;
+  }
+  _legacy = -1;
+  return false;
+}
+
+void OfflineLog::consumeLegacy(size_t n) {
+  const LegacyLog& legacy = OFFLINE_LEGACY[_legacy];
+  char path[24];
+  _legacyOffset += n;
+  _legacyPending -= min<uint32_t>(_legacyPending, n);
+  if (_legacyOffset < _legacyRecords) {
+    snprintf(path, sizeof(path), "%s/cursor", legacy.dir);
+    writeCursor(path, {_legacySeq, _legacyOffset});
+    return;
+  }
+
+  snprintf(path, sizeof(path), "%s/%08lu", legacy.dir, (unsigned long)_legacySeq);
+  LittleFS.remove(path);
+  _legacyOffset = 0;
+  if (oldestLegacySegment(_legacySeq, _legacyRecords)) return;
+  removeDir(legacy.dir, "drained");
+  openLegacy();
+}
+
+bool OfflineLog::begin() {
+  if (!LittleFS.begin()) {
+    LOG_WARN("[OFFLINE] LittleFS mount failed, formatting");
+    if (!LittleFS.format() || !LittleFS.begin()) return false;
+  }
+  _mounted = true;
+  _legacy = -1;
+  openLegacy();
+  LittleFS.mkdir(OFFLINE_DIR);
+
+  // Recover the segment range from the directory listing
+  _segments = 0;
+  _pending = 0;
+  Dir dir = LittleFS.openDir(OFFLINE_DIR);
+  while (dir.next()) {
+    uint32_t seq;
+    if (!segmentSeq(dir.fileName(), seq)) continue;
+
+    if (_segments == 0 || seq < _firstSeq) _firstSeq = seq;
+    if (_segments == 0 || seq > _lastSeq) _lastSeq = seq;
+    _segments++;
+    _pending += dir.fileSize() / READING_BIN_LEN;
+  }
+  if (_segments == 0) {
+    LittleFS.remove(OFFLINE_CURSOR);
+    return true;
+  }
+
+  // Segments are contiguous unless we lost power mid-rotation; trust the range anyway
+  _lastFill = segmentRecords(_lastSeq);
+  _readOffset = 0;
+
+  // A reset mid-append can leave a partial record at the end; cut it off so
+  // new records start on the stride
+  char path[24];
+  segmentPath(_lastSeq, path, sizeof(path));
+  File f = LittleFS.open(path, "r+");
+  if (f) {
+    if (f.size() != _lastFill * READING_BIN_LEN) f.truncate(_lastFill * READING_BIN_LEN);
+    f.close();
+  }
+
+  OfflineCursor cursor;
+  if (readCursor(OFFLINE_CURSOR, cursor) && cursor.seq == _firstSeq) {
+    _readOffset = min<uint16_t>(cursor.offset, segmentRecords(_firstSeq));
+  }
+  _pending -= min<uint32_t>(_pending, _readOffset);
+
+  LOG_INFO("[OFFLINE] %u segment(s), %lu reading(s) to backfill",
+           (unsigned)_segments, (unsigned long)_pending);
+  return true;
+}
+
+// Delete the oldest segment; returns how many undelivered records it held
+uint32_t OfflineLog::dropOldest() {
+  char path[24];
+  uint32_t records = segmentRecords(_firstSeq);
+  uint32_t left = records > _readOffset ? records - _readOffset : 0;
+  segmentPath(_firstSeq, path, sizeof(path));
+  LittleFS.remove(path);
+
+  _pending -= min<uint32_t>(_pending, left);
+  _firstSeq++;
+  _segments--;
+  _readOffset = 0;
+  if (_segments == 0) _lastFill = 0;
+  return left;
+}
+
+bool OfflineLog::append(const uint8_t* records, size_t count) {
+  if (!_mounted) return false;
+
+  while (count > 0) {
+    bool fresh = _segments == 0 || _lastFill >= _segmentRecords;
+    if (fresh && _segments >= _maxSegments) {
+      // Reuse the oldest slot when the ring is full
+      _overwritten += dropOldest();
+    }
+
+    // A new segment is only counted once its file exists
+    uint32_t seq = fresh ? _lastSeq + 1 : _lastSeq;
+    char path[24];
+    segmentPath(seq, path, sizeof(path));
+    File f = LittleFS.open(path, "a");
+    if (!f) return false;
+    if (fresh) {
+      _lastSeq = seq;
+      if (_segments == 0) _firstSeq = seq;
+      _segments++;
+      _lastFill = 0;
+    }
+
+    size_t n = min<size_t>(count, _segmentRecords - _lastFill);
+    size_t bytes = n * READING_BIN_LEN;
+    size_t wrote = f.write(records, bytes);
+    if (wrote != bytes) {
+      // Cut a partial record off, so later appends stay on the record stride
+      f.truncate(_lastFill * READING_BIN_LEN);
+      f.close();
+      LOG_WARN("[OFFLINE] Short write to segment %lu (%u of %u bytes)",
+               (unsigned long)seq, (unsigned)wrote, (unsigned)bytes);
+      return false;
+    }
+    f.close();
+
+    _lastFill += n;
+    _pending += n;
+    records += bytes;
+    count -= n;
+  }
+  return true;
+}
+
+size_t OfflineLog::peek(uint8_t* out, size_t maxRecords, size_t& bytes) {
+  bytes = 0;
+  if (!_mounted || pending() == 0) return 0;
+
+  // Older records first, at their own stride
+  char path[24];
+  uint32_t offset = _readOffset;
+  size_t stride = READING_BIN_LEN;
+  if (_legacy >= 0) {
+    stride = OFFLINE_LEGACY[_legacy].stride;
+    offset = _legacyOffset;
+    snprintf(path, sizeof(path), "%s/%08lu", OFFLINE_LEGACY[_legacy].dir, (unsigned long)_legacySeq);
+  } else {
+    // A missing or fully read oldest segment (lost to a failed write) would
+    // stall the log: drop it and read the next one
+    while (_segments > 0 && segmentRecords(_firstSeq) <= _readOffset) {
+      LOG_WARN("[OFFLINE] Segment %lu has no records left, dropping it", (unsigned long)_firstSeq);
+      dropOldest();
+      if (_segments > 0) saveCursor();
+    }
+    if (_segments == 0) {
+      _pending = 0;
+      return 0;
+    }
+    _peekSeq = _firstSeq;
+    segmentPath(_firstSeq, path, sizeof(path));
+  }
+  File f = LittleFS.open(path, "r");
+  if (!f) return 0;
+  size_t n = 0;
+  if (f.seek(offset * stride, SeekSet)) {
+    n = f.read(out, maxRecords * stride) / stride;
+  }
+  f.close();
+  if (_legacy >= 0) {
+    bytes = n * stride;   // older layouts have fixed-length records
+    return n;
+  }
+
+  // Pack the records out of their slots (an unreadable slot is left out)
+  for (size_t i = 0; i < n; i++) {
+    size_t len = readingBinaryLength(out + i * stride, stride);
+    memmove(out + bytes, out + i * stride, len);
+    bytes += len;
+  }
+  return n;
+}
+
+void OfflineLog::saveCursor() {
+  writeCursor(OFFLINE_CURSOR, {_firstSeq, _readOffset});
+}
+
+void OfflineLog::consume(size_t n) {
+  if (!_mounted) return;
+  if (_legacy >= 0) {
+    consumeLegacy(n);
+    return;
+  }
+  if (_segments == 0) return;
+  if (_peekSeq != _firstSeq) {
+    LOG_WARN("[OFFLINE] Segment %lu was overwritten during its upload", (unsigned long)_peekSeq);
+    return;
+  }
+
+  _readOffset += n;
+  _pending -= min<uint32_t>(_pending, n);
+
+  // A fully delivered segment is deleted; appends then start a fresh one
+  uint32_t inFirst = (_segments == 1) ? _lastFill : segmentRecords(_firstSeq);
+  if (_readOffset >= inFirst) {
+    dropOldest();
+  }
+  saveCursor();
+}
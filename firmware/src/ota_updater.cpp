@@ -0,0 +1,275 @@
+#include "ota_updater.h"
+
+#include <ESP8266WiFi.h>
+#include <LittleFS.h>
+#include <Updater.h>
+
+#include "log.h"
+#include "rtc_store.h"
+
+static const char* OTA_STATE_PATH = "/ota_state";
+static const uint32_t OTA_STATE_MAGIC = 0x4F544131;  // "OTA1"
+
+// A failed check or download is retried after this long (rollbacks included)
+static const uint32_t OTA_RETRY_MS = 60000;
+
+static int hexNibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool parseHex(const char* hex, uint8_t* out, size_t len) {
+  if (strlen(hex) != len * 2) return false;
+  for (size_t i = 0; i < len; i++) {
+    int hi = hexNibble(hex[2 * i]);
+    int lo = hexNibble(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    out[i] = (uint8_t)(hi << 4 | lo);
+  }
+  return true;
+}
+
+static void copyVersion(char* dst, const char* src) {
+  strncpy(dst, src, OTA_VERSION_MAX - 1);
+  dst[OTA_VERSION_MAX - 1] = '\0';
+}
+
+OtaUpdater::OtaUpdater(HttpsKeepAlive& http, const char* deviceId, uint32_t checkIntervalMs,
+                       uint32_t confirmMs, uint8_t trialBoots)
+  : _http(http), _deviceId(deviceId), _checkIntervalMs(checkIntervalMs),
+    _confirmMs(confirmMs), _trialBoots(trialBoots) {}
+
+void OtaUpdater::begin(bool coldBoot) {
+  bool ok = false;
+  File f = LittleFS.open(OTA_STATE_PATH, "r");
+  if (f) {
+    ok = f.read((uint8_t*)&_state, sizeof(_state)) == sizeof(_state) &&
+         _state.magic == OTA_STATE_MAGIC &&
+         _state.crc == crc32((const uint8_t*)&_state, offsetof(TrialState, crc));
+    f.close();
+  }
+  if (!ok) {
+    memset(&_state, 0, sizeof(_state));
+    copyVersion(_state.good, FIRMWARE_VERSION);
+  }
+
+  bool running = _state.trial[0] != '\0' && strcmp(_state.trial, FIRMWARE_VERSION) == 0;
+  if (!coldBoot) {
+    _onTrial = running;  // deep-sleep wake: same boot as far as the trial goes
+    return;
+  }
+
+  if (running) {
+    _onTrial = true;
+    _state.boots++;
+    saveState();
+    LOG_INFO("[OTA] %s on trial (boot %u of %u)", FIRMWARE_VERSION, (unsigned)_state.boots,
+             (unsigned)_trialBoots);
+    if (_state.boots > _trialBoots) rejectTrial("resets during trial");
+  } else if (_state.trial[0] != '\0') {
+    // eboot didn't apply the image, or another one was flashed over serial
+    LOG_WARN("[OTA] %s installed but %s booted, trial dropped", _state.trial, FIRMWARE_VERSION);
+    _state.trial[0] = '\0';
+    _state.boots = 0;
+    copyVersion(_state.good, FIRMWARE_VERSION);
+    saveState();
+  } else if (strcmp(_state.good, FIRMWARE_VERSION) != 0) {
+    // Flashed over serial: that build is the one to come back to
+    copyVersion(_state.good, FIRMWARE_VERSION);
+    saveState();
+  }
+}
+
+void OtaUpdater::confirm() {
+  if (!_onTrial) return;
+  _onTrial = false;
+  copyVersion(_state.good, _state.trial);
+  _state.trial[0] = '\0';
+  _state.boots = 0;
+  saveState();
+  LOG_INFO("[OTA] %s confirmed", _state.good);
+}
+
+void OtaUpdater::rejectTrial(const char* why) {
+  _onTrial = false;
+  copyVersion(_state.failed, _state.trial);
+  _state.trial[0] = '\0';
+  _state.boots = 0;
+  saveState();
+
+  if (strcmp(_state.failed, _state.good) == 0) {
+    // The rollback image itself failed: nothing left to go back to
+    LOG_ERROR("[OTA] %s failed (%s), no earlier version to install", _state.failed, why);
+    return;
+  }
+  LOG_WARN("[OTA] %s failed (%s), rolling back to %s", _state.failed, why, _state.good);
+  _rollback = true;
+  _checkNow = true;
+}
+
+void OtaUpdater::saveState() {
+  _state.magic = OTA_STATE_MAGIC;
+  _state.crc = crc32((const uint8_t*)&_state, offsetof(TrialState, crc));
+  File f = LittleFS.open(OTA_STATE_PATH, "w");
+  if (!f) return;
+  f.write((const uint8_t*)&_state, sizeof(_state));
+  f.close();
+}
+
+void OtaUpdater::scheduleCheck(uint32_t nowMs, uint32_t afterMs) {
+  _checkNow = false;
+  _nextCheckMs = nowMs + afterMs;
+}
+
+void OtaUpdater::poll(uint32_t nowMs) {
+  switch (_phase) {
+    case Phase::Idle: {
+      if (_onTrial) {
+        if (nowMs < _confirmMs) return;  // no updates while the running image is on trial
+        rejectTrial("not confirmed in time");
+      }
+      if (!_rollback && _checkIntervalMs == 0) return;
+      bool due = _checkNow || (int32_t)(nowMs - _nextCheckMs) >= 0;
+      if (!due || _http.busy() || WiFi.status() != WL_CONNECTED) return;
+      scheduleCheck(nowMs, OTA_RETRY_MS);  // replaced by the full interval once the check succeeds
+      startCheck();
+      return;
+    }
+
+    case Phase::Checking:
+    case Phase::Downloading: {
+      _http.poll();
+      int status;
+      if (!_http.finished(status)) return;
+
+      if (_phase == Phase::Downloading) {
+        finishDownload(status);
+        if (_phase == Phase::Idle) scheduleCheck(nowMs, OTA_RETRY_MS);
+        return;
+      }
+
+      _phase = Phase::Idle;
+      if (status == 204) {
+        LOG_DEBUG("[OTA] %s is up to date", FIRMWARE_VERSION);
+        scheduleCheck(nowMs, _checkIntervalMs);
+      } else if (status == 200 && parseManifest()) {
+        startDownload();
+        if (_phase == Phase::Idle) scheduleCheck(nowMs, _checkIntervalMs);
+      } else {
+        LOG_WARN("[OTA] Update check failed (%d)", status);
+      }
+      return;
+    }
+
+    case Phase::Ready:
+      return;
+  }
+}
+
+void OtaUpdater::startCheck() {
+  char path[sizeof(_path)];
+  int n = _rollback
+      ? snprintf(path, sizeof(path), "/api/firmware?device_id=%s&version=%s&want=%s",
+                 _deviceId, FIRMWARE_VERSION, _state.good)
+      : snprintf(path, sizeof(path), "/api/firmware?device_id=%s&version=%s",
+                 _deviceId, FIRMWARE_VERSION);
+  if (n <= 0 || (size_t)n >= sizeof(path)) return;
+
+  _manifestLen = 0;
+  if (_http.get(path, onManifest, this)) _phase = Phase::Checking;
+}
+
+bool OtaUpdater::onManifest(void* ctx, const uint8_t* data, size_t len) {
+  OtaUpdater* self = (OtaUpdater*)ctx;
+  if (self->_manifestLen + len >= sizeof(self->_manifest)) return false;
+  memcpy(self->_manifest + self->_manifestLen, data, len);
+  self->_manifestLen += len;
+  return true;
+}
+
+bool OtaUpdater::parseManifest() {
+  _manifest[_manifestLen] = '\0';
+  char hex[65];
+  unsigned size = 0;
+  if (sscanf(_manifest, "%15s %127s %u %64s", _version, _path, &size, hex) != 4 ||
+      size == 0 || !parseHex(hex, _expected, sizeof(_expected))) {
+    LOG_WARN("[OTA] Unreadable update check response");
+    return false;
+  }
+  _size = size;
+  return true;
+}
+
+void OtaUpdater::startDownload() {
+  if (strcmp(_version, FIRMWARE_VERSION) == 0) return;
+  if (!_rollback && strcmp(_version, _state.failed) == 0) {
+    LOG_DEBUG("[OTA] %s offered but failed its trial here, skipped", _version);
+    return;
+  }
+  if (!Update.begin(_size)) {
+    LOG_ERROR("[OTA] %s (%lu B) doesn't fit, updater error %u", _version, (unsigned long)_size,
+              (unsigned)Update.getError());
+    return;
+  }
+  br_sha256_init(&_sha);
+  _written = 0;
+  if (!_http.get(_path, onImage, this)) {
+    Update.end();  // incomplete: discards the update
+    return;
+  }
+  _phase = Phase::Downloading;
+  LOG_INFO("[OTA] Downloading %s (%lu B)%s", _version, (unsigned long)_size,
+           _rollback ? " to roll back" : "");
+}
+
+bool OtaUpdater::onImage(void* ctx, const uint8_t* data, size_t len) {
+  return ((OtaUpdater*)ctx)->writeImage(data, len);
+}
+
+bool OtaUpdater::writeImage(const uint8_t* data, size_t len) {
+  if (_written + len > _size) return false;  // longer than announced
+  br_sha256_update(&_sha, data, len);
+
+  // The final byte is only written after the hash matched: an update one byte
+  // short of complete is discarded by Update.end()
+  size_t n = len;
+  if (_written + len == _size) {
+    _lastByte = data[len - 1];
+    n--;
+  }
+  if (n > 0 && Update.write((uint8_t*)data, n) != n) return false;
+  _written += len;
+  return true;
+}
+
+void OtaUpdater::finishDownload(int status) {
+  _phase = Phase::Idle;
+  if (status != 200 || _written != _size || Update.hasError()) {
+    LOG_WARN("[OTA] Download of %s failed (%d, %lu of %lu B, updater error %u)", _version, status,
+             (unsigned long)_written, (unsigned long)_size, (unsigned)Update.getError());
+    Update.end();
+    return;
+  }
+
+  uint8_t digest[sizeof(_expected)];
+  br_sha256_out(&_sha, digest);
+  if (memcmp(digest, _expected, sizeof(digest)) != 0) {
+    LOG_ERROR("[OTA] %s: SHA-256 mismatch, image discarded", _version);
+    Update.end();
+    return;
+  }
+  if (Update.write(&_lastByte, 1) != 1 || !Update.end()) {
+    LOG_ERROR("[OTA] %s rejected by the updater (error %u)", _version, (unsigned)Update.getError());
+    return;
+  }
+
+  // Boots into the new image on trial; the previous good version stays recorded
+  copyVersion(_state.trial, _version);
+  _state.boots = 0;
+  saveState();
+  _rollback = false;
+  _phase = Phase::Ready;
+  LOG_INFO("[OTA] %s verified and staged, restart to boot it", _version);
+}
@@ -0,0 +1,82 @@
+#include "pms5003.h"
+
+// Host commands: 42 4D <cmd> <data hi> <data lo> <sum hi> <sum lo>
+static const uint8_t PMS_CMD_MODE = 0xE1;   // data 0: passive
+static const uint8_t PMS_CMD_READ = 0xE2;
+static const size_t PMS_FRAME_LEN = 32;     // 42 4D, length 28, 13 data words, checksum
+static const size_t PMS_ACK_LEN = 8;        // answer to the mode command
+
+// 32 bytes at 9600 Bd take 33 ms; a late frame gets a few more steps
+static const uint32_t PMS_FRAME_MS = 40;
+static const uint8_t PMS_MAX_WAITS = 3;
+static const uint32_t PMS_PROBE_MS = 100;
+
+// The sensor updates every ~1 s (2.3 s when the concentration is steady)
+static const SensorField PMS_FIELDS[] = {SensorField::Pm1, SensorField::Pm25, SensorField::Pm10};
+static const SensorSpec PMS_SPEC = {"PMS5003", PMS_FRAME_MS, 5000, PMS_FIELDS, 3};
+
+static uint16_t be16(const uint8_t* p) {
+  return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+// 16-bit sum of every byte except the checksum itself
+static uint16_t frameSum(const uint8_t* frame, size_t len) {
+  uint16_t sum = 0;
+  for (size_t i = 0; i + 2 < len; i++) sum += frame[i];
+  return sum;
+}
+
+Pms5003::Pms5003(Stream& uart) : SensorDriver(PMS_SPEC), _uart(uart) {}
+
+void Pms5003::send(uint8_t cmd, uint16_t data) {
+  uint8_t msg[7] = {0x42, 0x4D, cmd, (uint8_t)(data >> 8), (uint8_t)data, 0, 0};
+  uint16_t sum = 0;
+  for (uint8_t i = 0; i < 5; i++) sum += msg[i];
+  msg[5] = (uint8_t)(sum >> 8);
+  msg[6] = (uint8_t)sum;
+  _uart.write(msg, sizeof(msg));
+}
+
+void Pms5003::drain() {
+  while (_uart.available() > 0) _uart.read();
+}
+
+// Passive mode; present if the acknowledgement comes back
+bool Pms5003::probe() {
+  drain();
+  send(PMS_CMD_MODE, 0);
+  uint32_t start = millis();
+  while ((size_t)_uart.available() < PMS_ACK_LEN) {
+    if (millis() - start >= PMS_PROBE_MS) return false;
+    delay(1);
+  }
+  uint8_t ack[PMS_ACK_LEN];
+  _uart.readBytes(ack, sizeof(ack));
+  return ack[0] == 0x42 && ack[1] == 0x4D && be16(ack + 2) == PMS_ACK_LEN - 4 &&
+         be16(ack + 6) == frameSum(ack, sizeof(ack));
+}
+
+bool Pms5003::start() {
+  drain();   // a frame we gave up on must not be taken for this one
+  send(PMS_CMD_READ, 0);
+  _waits = 0;
+  return true;
+}
+
+SensorStep Pms5003::collect(int32_t* values) {
+  if ((size_t)_uart.available() < PMS_FRAME_LEN) {
+    return ++_waits < PMS_MAX_WAITS ? SensorStep::Again : SensorStep::Failed;
+  }
+  uint8_t frame[PMS_FRAME_LEN];
+  _uart.readBytes(frame, sizeof(frame));
+  if (frame[0] != 0x42 || frame[1] != 0x4D || be16(frame + 2) != PMS_FRAME_LEN - 4 ||
+      be16(frame + 30) != frameSum(frame, sizeof(frame))) {
+    return SensorStep::Failed;
+  }
+
+  // Data words 4..6: PM1.0, PM2.5, PM10 under atmospheric conditions (µg/m³)
+  values[0] = be16(frame + 10);
+  values[1] = be16(frame + 12);
+  values[2] = be16(frame + 14);
+  return SensorStep::Done;
+}
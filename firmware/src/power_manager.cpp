@@ -0,0 +1,99 @@
+#include "power_manager.h"
+
+#include "log.h"
+#include "rtc_store.h"
+
+static const uint32_t SLEEP_STATE_MAGIC = 0x534C5036;  // "SLP6", bump on SleepState layout changes
+static_assert(sizeof(RtcRecord<SleepState>) <= (RTC_SLOT_WATCHDOG - RTC_SLOT_SLEEP) * 4, "SleepState overflows its RTC slot");
+
+// Nominal ESP8266 module current draw for the budget estimate (sensors and LED excluded)
+static const float CURRENT_RADIO_MA = 70.0f;
+static const float CURRENT_CPU_MA = 15.0f;
+static const float CURRENT_DEEP_SLEEP_MA = 0.02f;
+
+PowerManager::PowerManager(PowerMode mode) : _mode(mode) {
+  _state = SleepState();
+}
+
+void PowerManager::begin() {
+  rst_info* info = ESP.getResetInfoPtr();
+  bool sleepWake = info != nullptr && info->reason == REASON_DEEP_SLEEP_AWAKE;
+
+  if (sleepWake && rtcLoad(RTC_SLOT_SLEEP, SLEEP_STATE_MAGIC, _state)) {
+    _woke = true;
+    _radioAvailable = _state.radioOnWake != 0;
+  } else {
+    _state = SleepState();
+  }
+  // A wake without RF calibration can't use the radio until the next sleep
+  _radioOn = _radioAvailable && _mode == PowerMode::AlwaysOn;
+  _awakeSinceMs = uptimeMs();
+  _radioSinceMs = _awakeSinceMs;
+}
+
+void PowerManager::radioOn(uint32_t nowMs) {
+  if (_radioOn) return;
+  _radioOn = true;
+  _radioSinceMs = nowMs;
+  _state.stats.windows++;
+}
+
+void PowerManager::radioOff(uint32_t nowMs) {
+  if (!_radioOn) return;
+  _radioOn = false;
+  _state.stats.radioMs += nowMs - _radioSinceMs;
+}
+
+void PowerManager::noteUploadLatency(uint32_t ageMs) {
+  _state.stats.latencySumMs += ageMs;
+  _state.stats.latencyCount++;
+}
+
+void PowerManager::accountAwake(uint32_t nowMs) {
+  _state.stats.awakeMs += nowMs - _awakeSinceMs;
+  _awakeSinceMs = nowMs;
+  if (_radioOn) {
+    _state.stats.radioMs += nowMs - _radioSinceMs;
+    _radioSinceMs = nowMs;
+  }
+}
+
+void PowerManager::deepSleep(uint32_t ms, bool radioOnWake) {
+  uint32_t now = uptimeMs();
+  accountAwake(now);
+  _state.stats.sleepMs += ms;
+
+  // The virtual clock resumes where it will be when we wake
+  _state.uptimeMs = now + ms;
+  _state.radioOnWake = radioOnWake ? 1 : 0;
+  rtcSave(RTC_SLOT_SLEEP, SLEEP_STATE_MAGIC, _state);
+
+  asyncLog.flush();
+  ESP.deepSleep((uint64_t)ms * 1000ULL, radioOnWake ? WAKE_RF_DEFAULT : WAKE_RF_DISABLED);
+  for (;;) delay(1000);  // not reached
+}
+
+void PowerManager::report(uint32_t nowMs, uint32_t intervalMs) {
+  if (nowMs - _lastReportMs < intervalMs) return;
+  _lastReportMs = nowMs;
+  accountAwake(nowMs);
+
+  const PowerStats& s = _state.stats;
+  float total = (float)(s.awakeMs + s.sleepMs);
+  if (total <= 0) return;
+
+  float radioPct = 100.0f * s.radioMs / total;
+  float awakePct = 100.0f * s.awakeMs / total;
+  float cpuOnlyMs = (float)(s.awakeMs > s.radioMs ? s.awakeMs - s.radioMs : 0);
+  float avgMa = (s.radioMs * CURRENT_RADIO_MA + cpuOnlyMs * CURRENT_CPU_MA + s.sleepMs * CURRENT_DEEP_SLEEP_MA) / total;
+  uint32_t latency = s.latencyCount ? s.latencySumMs / s.latencyCount : 0;
+
+  static const char* names[] = {"always-on", "modem-sleep", "deep-sleep"};
+  LOG_INFO("[POWER] mode=%s awake=%u.%u%% radio=%u.%u%% windows=%lu est=%u.%u mA upload_latency=%lu ms",
+           names[(uint8_t)_mode],
+           (unsigned)awakePct, (unsigned)(awakePct * 10) % 10,
+           (unsigned)radioPct, (unsigned)(radioPct * 10) % 10,
+           (unsigned long)s.windows,
+           (unsigned)avgMa, (unsigned)(avgMa * 10) % 10,
+           (unsigned long)latency);
+}
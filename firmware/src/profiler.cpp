@@ -0,0 +1,48 @@
+#include "profiler.h"
+
+static const char* STAGE_NAMES[] = {"loop", "i2c", "reading", "led", "wifi", "mqtt", "http", "tls"};
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == (size_t)Stage::Count, "one name per stage");
+
+void Profiler::record(Stage stage, uint32_t cycles) {
+  uint32_t us = cycles / ESP.getCpuFreqMHz();
+  StageStats& s = _stats[(uint8_t)stage];
+  s.n++;
+  s.sumUs += us;
+  if (us > s.maxUs) s.maxUs = us;
+
+  // Bucket b holds [16·4^(b-1), 16·4^b) µs
+  uint8_t b = 0;
+  for (uint32_t limit = 16; b < PROFILE_BUCKETS - 1 && us >= limit; limit <<= 2) b++;
+  s.hist[b]++;
+}
+
+void Profiler::reset() {
+  for (StageStats& s : _stats) s = StageStats();
+  _minFreeHeap = UINT32_MAX;
+}
+
+void Profiler::noteHeap() {
+  uint32_t free = ESP.getFreeHeap();
+  if (free < _minFreeHeap) _minFreeHeap = free;
+}
+
+uint32_t Profiler::percentileUs(Stage stage, uint8_t pct) const {
+  const StageStats& s = stats(stage);
+  if (s.n == 0) return 0;
+  uint32_t target = (uint32_t)(((uint64_t)s.n * pct + 99) / 100);
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+    seen += s.hist[b];
+    if (seen >= target) return min(bucketLimitUs(b), s.maxUs);
+  }
+  return s.maxUs;
+}
+
+const char* Profiler::name(Stage stage) {
+  return STAGE_NAMES[(uint8_t)stage];
+}
+
+uint32_t Profiler::bucketLimitUs(uint8_t bucket) {
+  if (bucket >= PROFILE_BUCKETS - 1) return UINT32_MAX;
+  return 16UL << (2 * bucket);
+}
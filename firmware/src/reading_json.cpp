@@ -0,0 +1,75 @@
+#include "reading_json.h"
+
+static const int32_t POW10[] = {1, 10, 100, 1000, 10000};
+
+// One key per present field (sensor_fields.h); fields without a value are left out
+static void writeReadingExtras(JsonWriter& w, const ReadingExtras& ex) {
+  for (uint8_t i = 0; i < ex.count; i++) {
+    const SensorFieldInfo& info = sensorFieldInfo(ex.field[i]);
+    if (info.key == nullptr) continue;
+    if (info.decimals == 0) {
+      w.field(info.key, ex.value[i]);
+    } else {
+      w.fieldFixed(info.key, (float)ex.value[i] / POW10[min<uint8_t>(info.decimals, 4)], info.decimals);
+    }
+  }
+}
+
+// Edge analytics: [ewma, window min, window max, change per minute] per field,
+// and the fields whose spike started with this sample
+static void writeReadingStats(JsonWriter& w, const ReadingStats& st) {
+  if (st.samples == 0) return;
+  w.key("stats");
+  w.beginObject();
+  w.field("n", (uint32_t)st.samples);
+  w.key("tvoc_ppb");
+  w.beginArray(); w.value((uint32_t)st.tvocEwma); w.value((uint32_t)st.tvocMin); w.value((uint32_t)st.tvocMax); w.value((int32_t)st.tvocRate); w.endArray();
+  w.key("eco2_ppm");
+  w.beginArray(); w.value((uint32_t)st.eco2Ewma); w.value((uint32_t)st.eco2Min); w.value((uint32_t)st.eco2Max); w.value((int32_t)st.eco2Rate); w.endArray();
+  w.endObject();
+  if (st.anomalies) {
+    w.key("spike");
+    w.beginArray();
+    if (st.anomalies & READING_ANOMALY_TVOC_SPIKE) w.value("tvoc_ppb");
+    if (st.anomalies & READING_ANOMALY_ECO2_SPIKE) w.value("eco2_ppm");
+    w.endArray();
+  }
+}
+
+void writeReadingJson(JsonWriter& w, const Reading& r, const char* deviceId) {
+  w.beginObject();
+  w.field("ts_ms", r.tsMs);                      // Time since boot (ms)
+  if (r.boot) w.field("boot", (uint32_t)r.boot); // Boot count: with ts_ms, identifies the reading
+  if (r.epochMs) {
+    w.field("ts_epoch_ms", r.epochMs);           // Measurement time (Unix ms), null until SNTP sync
+  } else {
+    w.key("ts_epoch_ms");
+    w.null();
+  }
+  w.field("device_id", deviceId);                // Device ID
+  w.fieldFixed("t_c", r.tC, 2);                  // Temp (°C), null if unavailable
+  w.fieldFixed("rh", r.rh, 2);                   // Humidity (%), null if unavailable
+  w.field("tvoc_ppb", (uint32_t)r.tvoc);         // TVOC (ppb)
+  w.field("eco2_ppm", (uint32_t)r.eco2);         // eCO2 (ppm)
+  w.field("aq_index", (uint32_t)r.aqIndex);      // AQ index (0–100)
+  w.field("warming_up", r.warmingUp);            // Warmup flag
+  writeReadingExtras(w, r.extra);                // Add-on sensors, when fitted
+  writeReadingStats(w, r.stats);                 // Rolling statistics and spikes
+  if (r.span.samples > 1) {
+    // Samples suppressed since the previous report: [min, mean, max] per field
+    const ReadingSpan& sp = r.span;
+    w.key("agg");
+    w.beginObject();
+    w.field("n", (uint32_t)sp.samples);
+    w.key("tvoc_ppb");
+    w.beginArray(); w.value((uint32_t)sp.tvocMin); w.value((uint32_t)sp.tvocMean); w.value((uint32_t)sp.tvocMax); w.endArray();
+    w.key("eco2_ppm");
+    w.beginArray(); w.value((uint32_t)sp.eco2Min); w.value((uint32_t)sp.eco2Mean); w.value((uint32_t)sp.eco2Max); w.endArray();
+    w.key("t_c");
+    w.beginArray(); w.fixed(sp.tMin, 2); w.fixed(sp.tMean, 2); w.fixed(sp.tMax, 2); w.endArray();
+    w.key("rh");
+    w.beginArray(); w.fixed(sp.rhMin, 2); w.fixed(sp.rhMean, 2); w.fixed(sp.rhMax, 2); w.endArray();
+    w.endObject();
+  }
+  w.endObject();
+}
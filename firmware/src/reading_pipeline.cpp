@@ -0,0 +1,27 @@
+#include "reading_pipeline.h"
+
+#include "reading_codec.h"
+#include "reading_json.h"
+
+ReadingPipeline::ReadingPipeline(AqBandClassifier<AQ_BAND_COUNT>& bands, const AqColorLut& colors,
+                                 EdgeStats& edge, ReportFilter& filter, const char* deviceId)
+  : _bands(bands), _colors(colors), _edge(edge), _filter(filter), _deviceId(deviceId) {}
+
+bool ReadingPipeline::step(Reading& r, bool sgpValid, JsonWriter& json, uint8_t* bin, size_t binCap) {
+  uint8_t idx = tvocToIndex(r.tvoc);
+  // Until the warm-up expires the band isn't updated (the LED pulses instead)
+  if (!r.warmingUp) {
+    idx = _bands.apply(idx);
+    _color = aqColorAt(_colors, idx);
+  }
+  r.aqIndex = idx;
+  r.aqBand = _bands.band();
+  _edge.offer(r, sgpValid);
+
+  // Deadbands and heartbeat decide whether this sample leaves the device
+  bool report = _filter.offer(r);
+
+  writeReadingJson(json, r, _deviceId);
+  _binLen = (report && bin) ? encodeReadingBinary(r, bin, binCap) : 0;
+  return report;
+}
@@ -0,0 +1,152 @@
+#include "remote_config.h"
+
+#include <LittleFS.h>
+
+#include "log.h"
+#include "rtc_store.h"
+
+static const char* REMOTE_CONFIG_PATH = "/remote_config";
+static const uint32_t REMOTE_CONFIG_MAGIC = 0x52434631;  // "RCF1"
+static const size_t REMOTE_KEY_MAX = 24;
+
+RemoteConfig::RemoteConfig(const DeviceSettings& defaults)
+  : _settings(defaults), _batchMax(defaults.batchSamples) {}
+
+const char* RemoteConfig::check(const DeviceSettings& s) const {
+  if (s.sampleMs < REMOTE_SAMPLE_MS_MIN || s.sampleMs > REMOTE_SAMPLE_MS_MAX) return "sample_ms out of range";
+  if (s.warmupMs > REMOTE_WARMUP_MS_MAX) return "warmup_ms out of range";
+  if (s.heartbeatMs > REMOTE_HEARTBEAT_MS_MAX) return "heartbeat_ms out of range";
+  if (s.batchAgeMs < REMOTE_BATCH_AGE_MS_MIN || s.batchAgeMs > REMOTE_BATCH_AGE_MS_MAX) return "batch_age_ms out of range";
+  if (s.batchSamples < 1 || s.batchSamples > _batchMax) return "batch_samples out of range";
+  if (s.aqLow < 1 || s.aqLow >= s.aqHigh || s.aqHigh >= 100) return "aq thresholds must satisfy 0 < low < high < 100";
+  if (s.aqHysteresis > REMOTE_HYSTERESIS_MAX) return "aq_hysteresis out of range";
+  return nullptr;
+}
+
+bool RemoteConfig::load() {
+  File f = LittleFS.open(REMOTE_CONFIG_PATH, "r");
+  if (!f) return false;
+  Stored stored;
+  bool ok = f.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored);
+  f.close();
+
+  if (!ok || stored.magic != REMOTE_CONFIG_MAGIC ||
+      stored.crc != crc32((const uint8_t*)&stored, offsetof(Stored, crc))) {
+    return false;
+  }
+  // Written by an image with other limits (e.g. a larger batch buffer)
+  const char* error = check(stored.settings);
+  if (error) {
+    LOG_WARN("[CONFIG] Stored rev %lu not usable: %s", (unsigned long)stored.settings.rev, error);
+    return false;
+  }
+  _settings = stored.settings;
+  LOG_INFO("[CONFIG] Loaded rev %lu", (unsigned long)_settings.rev);
+  return true;
+}
+
+bool RemoteConfig::accept(const DeviceSettings& next) {
+  _settings = next;
+
+  Stored stored;
+  stored.magic = REMOTE_CONFIG_MAGIC;
+  stored.settings = next;
+  stored.crc = crc32((const uint8_t*)&stored, offsetof(Stored, crc));
+  File f = LittleFS.open(REMOTE_CONFIG_PATH, "w");
+  if (!f) return false;
+  bool ok = f.write((const uint8_t*)&stored, sizeof(stored)) == sizeof(stored);
+  f.close();
+  return ok;
+}
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// A flat JSON object of "key": unsigned integer pairs, nothing else
+const char* RemoteConfig::parse(const char* msg, size_t len, DeviceSettings& next) const {
+  next = _settings;
+  bool hasRev = false;
+  uint32_t rev = 0;
+
+  size_t i = 0;
+  auto skipSpace = [&]() { while (i < len && isSpace(msg[i])) i++; };
+
+  skipSpace();
+  if (i >= len || msg[i++] != '{') return "not a JSON object";
+  skipSpace();
+  bool empty = i < len && msg[i] == '}';
+  while (!empty) {
+    // Key: no escapes needed for ours
+    skipSpace();
+    if (i >= len || msg[i++] != '"') return "expected a key";
+    char key[REMOTE_KEY_MAX + 1];
+    size_t k = 0;
+    while (i < len && msg[i] != '"') {
+      if (k >= REMOTE_KEY_MAX || msg[i] == '\\') return "bad key";
+      key[k++] = msg[i++];
+    }
+    if (i++ >= len) return "unterminated key";
+    key[k] = '\0';
+    skipSpace();
+    if (i >= len || msg[i++] != ':') return "expected ':'";
+    skipSpace();
+
+    // Value: unsigned 32-bit integer
+    if (i >= len || msg[i] < '0' || msg[i] > '9') return "values must be unsigned integers";
+    uint64_t v = 0;
+    while (i < len && msg[i] >= '0' && msg[i] <= '9') {
+      v = v * 10 + (uint64_t)(msg[i++] - '0');
+      if (v > UINT32_MAX) return "value too large";
+    }
+    uint32_t u = (uint32_t)v;
+    bool byte = u <= UINT8_MAX;
+
+    if (strcmp(key, "rev") == 0) {
+      rev = u;
+      hasRev = true;
+    } else if (strcmp(key, "sample_ms") == 0) {
+      next.sampleMs = u;
+    } else if (strcmp(key, "warmup_ms") == 0) {
+      next.warmupMs = u;
+    } else if (strcmp(key, "heartbeat_ms") == 0) {
+      next.heartbeatMs = u;
+    } else if (strcmp(key, "batch_age_ms") == 0) {
+      next.batchAgeMs = u;
+    } else if (strcmp(key, "batch_samples") == 0) {
+      if (!byte) return "batch_samples out of range";
+      next.batchSamples = (uint8_t)u;
+    } else if (strcmp(key, "led_brightness") == 0) {
+      if (!byte) return "led_brightness out of range";
+      next.ledBrightness = (uint8_t)u;
+    } else if (strcmp(key, "aq_low") == 0) {
+      if (!byte) return "aq thresholds must satisfy 0 < low < high < 100";
+      next.aqLow = (uint8_t)u;
+    } else if (strcmp(key, "aq_high") == 0) {
+      if (!byte) return "aq thresholds must satisfy 0 < low < high < 100";
+      next.aqHigh = (uint8_t)u;
+    } else if (strcmp(key, "aq_hysteresis") == 0) {
+      if (!byte) return "aq_hysteresis out of range";
+      next.aqHysteresis = (uint8_t)u;
+    }
+    // Other keys are for newer firmware
+
+    skipSpace();
+    if (i >= len) return "unterminated object";
+    char c = msg[i++];
+    if (c == '}') break;
+    if (c != ',') return "expected ',' or '}'";
+  }
+  if (empty) i++;
+  skipSpace();
+  if (i != len) return "trailing data";
+
+  if (!hasRev) return "rev missing";
+  if (rev == _settings.rev) {
+    next = _settings;   // redelivered (the retained copy after a reconnect)
+    return nullptr;
+  }
+  if (rev < _settings.rev) return "rev older than the applied one";
+  next.rev = rev;
+  return check(next);
+}
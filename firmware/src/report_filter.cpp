@@ -0,0 +1,128 @@
+#include "report_filter.h"
+
+// Outside the deadband, or the value appeared/disappeared
+static bool movedU16(uint16_t a, uint16_t b, uint16_t band) {
+  return (a > b ? a - b : b - a) >= band;
+}
+
+static bool movedFloat(float a, float b, float band) {
+  if (isnan(a) || isnan(b)) return isnan(a) != isnan(b);
+  return fabsf(a - b) >= band;
+}
+
+// A field moved by its deadband, or appeared/disappeared (a sensor came or went)
+static bool movedExtras(const ReadingExtras& now, const ReadingExtras& last) {
+  if (now.count != last.count) return true;
+  for (uint8_t i = 0; i < now.count; i++) {
+    if (now.field[i] != last.field[i]) return true;
+    int32_t d = now.value[i] - last.value[i];
+    if ((d < 0 ? -d : d) >= sensorFieldInfo(now.field[i]).deadband) return true;
+  }
+  return false;
+}
+
+// The span of a single sample
+static void singleSpan(const Reading& r, ReadingSpan& span) {
+  span.samples = 1;
+  span.tvocMin = span.tvocMean = span.tvocMax = r.tvoc;
+  span.eco2Min = span.eco2Mean = span.eco2Max = r.eco2;
+  span.tMin = span.tMean = span.tMax = r.tC;
+  span.rhMin = span.rhMean = span.rhMax = r.rh;
+}
+
+ReportFilter::ReportFilter(const Deadbands& bands, uint32_t heartbeatMs)
+  : _bands(bands), _heartbeatMs(heartbeatMs) {
+  _state = State();
+  startWindow();
+}
+
+void ReportFilter::startWindow() {
+  _state.n = _state.tN = _state.rhN = 0;
+  _state.tvocSum = _state.eco2Sum = 0;
+  _state.tSum = _state.rhSum = 0.0f;
+}
+
+bool ReportFilter::changed(const Reading& r) const {
+  const State& s = _state;
+  if (!s.hasLast) return true;
+  if (r.tsMs - s.lastReportMs >= _heartbeatMs) return true;
+  if (r.aqBand != s.lastAqBand || r.warmingUp != (s.lastWarmingUp != 0)) return true;
+  if (r.stats.anomalies) return true;
+  return movedU16(r.tvoc, s.lastTvoc, _bands.tvocPpb) ||
+         movedU16(r.eco2, s.lastEco2, _bands.eco2Ppm) ||
+         movedFloat(r.tC, s.lastTC, _bands.tC) ||
+         movedFloat(r.rh, s.lastRh, _bands.rh) ||
+         movedExtras(r.extra, s.lastExtra);
+}
+
+void ReportFilter::accumulate(const Reading& r) {
+  State& s = _state;
+  bool first = s.n == 0;
+  s.tvocMin = first ? r.tvoc : min(s.tvocMin, r.tvoc);
+  s.tvocMax = first ? r.tvoc : max(s.tvocMax, r.tvoc);
+  s.eco2Min = first ? r.eco2 : min(s.eco2Min, r.eco2);
+  s.eco2Max = first ? r.eco2 : max(s.eco2Max, r.eco2);
+  s.tvocSum += r.tvoc;
+  s.eco2Sum += r.eco2;
+  s.n++;
+
+  if (!isnan(r.tC)) {
+    s.tMin = s.tN == 0 ? r.tC : min(s.tMin, r.tC);
+    s.tMax = s.tN == 0 ? r.tC : max(s.tMax, r.tC);
+    s.tSum += r.tC;
+    s.tN++;
+  }
+  if (!isnan(r.rh)) {
+    s.rhMin = s.rhN == 0 ? r.rh : min(s.rhMin, r.rh);
+    s.rhMax = s.rhN == 0 ? r.rh : max(s.rhMax, r.rh);
+    s.rhSum += r.rh;
+    s.rhN++;
+  }
+}
+
+void ReportFilter::summarize(ReadingSpan& span) const {
+  const State& s = _state;
+  span.samples = s.n;
+  span.tvocMin = s.tvocMin;
+  span.tvocMax = s.tvocMax;
+  span.tvocMean = (uint16_t)((s.tvocSum + s.n / 2) / s.n);
+  span.eco2Min = s.eco2Min;
+  span.eco2Max = s.eco2Max;
+  span.eco2Mean = (uint16_t)((s.eco2Sum + s.n / 2) / s.n);
+  span.tMin = s.tN ? s.tMin : NAN;
+  span.tMax = s.tN ? s.tMax : NAN;
+  span.tMean = s.tN ? s.tSum / s.tN : NAN;
+  span.rhMin = s.rhN ? s.rhMin : NAN;
+  span.rhMax = s.rhN ? s.rhMax : NAN;
+  span.rhMean = s.rhN ? s.rhSum / s.rhN : NAN;
+}
+
+bool ReportFilter::offer(Reading& r) {
+  bool report = changed(r);
+
+  // The window can't outgrow its counters (only reachable with a huge heartbeat)
+  if (_state.n == UINT16_MAX) report = true;
+
+  accumulate(r);
+  if (!report) {
+    singleSpan(r, r.span);
+    _suppressed++;
+    return false;
+  }
+
+  summarize(r.span);
+  startWindow();
+
+  State& s = _state;
+  s.lastReportMs = r.tsMs;
+  s.lastTvoc = r.tvoc;
+  s.lastEco2 = r.eco2;
+  s.lastTC = r.tC;
+  s.lastRh = r.rh;
+  s.lastExtra = r.extra;
+  s.lastAqBand = r.aqBand;
+  s.lastWarmingUp = r.warmingUp;
+  s.hasLast = 1;
+  _reported++;
+  return true;
+}
@@ -0,0 +1,47 @@
+#include "scd4x.h"
+
+#include "sensirion_i2c.h"
+
+// Commands and max execution times (SCD4x datasheet, table 9)
+static const uint16_t SCD_CMD_START_PERIODIC = 0x21B1;
+static const uint16_t SCD_CMD_READ_MEASUREMENT = 0xEC05;
+static const uint16_t SCD_CMD_DATA_READY = 0xE4B8;
+static const uint32_t SCD_COMMAND_MS = 1;
+
+// The sensor updates every 5 s in periodic mode
+static const SensorField SCD_FIELDS[] = {SensorField::Co2};
+static const SensorSpec SCD_SPEC = {"SCD4x", SCD_COMMAND_MS + 1, 5000, SCD_FIELDS, 1};
+
+Scd4x::Scd4x(TwoWire& wire, uint8_t addr) : SensorDriver(SCD_SPEC), _wire(wire), _addr(addr) {}
+
+bool Scd4x::probe() {
+  if (sensirionCommand(_wire, _addr, SCD_CMD_START_PERIODIC)) return true;
+
+  // Already measuring (it rejects start_periodic then): it still answers status reads
+  uint16_t status;
+  if (!sensirionCommand(_wire, _addr, SCD_CMD_DATA_READY)) return false;
+  delay(SCD_COMMAND_MS);
+  return sensirionRead(_wire, _addr, &status, 1);
+}
+
+bool Scd4x::start() {
+  _phase = Phase::Ready;
+  return sensirionCommand(_wire, _addr, SCD_CMD_DATA_READY);
+}
+
+SensorStep Scd4x::collect(int32_t* values) {
+  if (_phase == Phase::Ready) {
+    uint16_t status;
+    if (!sensirionRead(_wire, _addr, &status, 1)) return SensorStep::Failed;
+    if ((status & 0x07FF) == 0) return SensorStep::Unchanged;   // low 11 bits clear: nothing new
+    if (!sensirionCommand(_wire, _addr, SCD_CMD_READ_MEASUREMENT)) return SensorStep::Failed;
+    _phase = Phase::Read;
+    return SensorStep::Again;
+  }
+
+  // CO2 (ppm), then the sensor's own temperature and humidity (unused: the SHT31 is better placed)
+  uint16_t words[3];
+  if (!sensirionRead(_wire, _addr, words, 3)) return SensorStep::Failed;
+  values[0] = words[0];
+  return SensorStep::Done;
+}
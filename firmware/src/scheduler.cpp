@@ -0,0 +1,54 @@
+#include "scheduler.h"
+
+#include "log.h"
+
+int8_t Scheduler::add(const char* name, uint32_t intervalMs, TaskFn fn, uint32_t firstMs) {
+  if (_count >= MAX_TASKS || intervalMs == 0) return -1;
+  Task& t = _tasks[_count];
+  t.name = name;
+  t.intervalMs = intervalMs;
+  t.nextMs = firstMs;
+  t.fn = fn;
+  t.stats = TaskStats();
+  return (int8_t)_count++;
+}
+
+void Scheduler::run(uint32_t nowMs) {
+  for (uint8_t i = 0; i < _count; i++) {
+    Task& t = _tasks[i];
+    int32_t late = (int32_t)(nowMs - t.nextMs);
+    if (late < 0) continue;
+
+    t.stats.runs++;
+    t.stats.lateSumMs += (uint32_t)late;
+    if ((uint32_t)late > t.stats.lateMaxMs) t.stats.lateMaxMs = (uint32_t)late;
+
+    // Advance from the deadline, skipping any slots that already passed
+    uint32_t slots = (uint32_t)late / t.intervalMs + 1;
+    t.stats.missed += slots - 1;
+    t.nextMs += slots * t.intervalMs;
+
+    t.fn(nowMs);
+  }
+}
+
+uint32_t Scheduler::untilNext(uint32_t nowMs) const {
+  uint32_t soonest = UINT32_MAX;
+  for (uint8_t i = 0; i < _count; i++) {
+    int32_t until = (int32_t)(_tasks[i].nextMs - nowMs);
+    if (until <= 0) return 0;
+    if ((uint32_t)until < soonest) soonest = (uint32_t)until;
+  }
+  return soonest;
+}
+
+void Scheduler::report() {
+  for (uint8_t i = 0; i < _count; i++) {
+    Task& t = _tasks[i];
+    uint32_t avg = t.stats.runs ? t.stats.lateSumMs / t.stats.runs : 0;
+    LOG_INFO("[SCHED] %s every %lu ms: %lu run(s), late avg %lu ms max %lu ms, %lu missed",
+             t.name, (unsigned long)t.intervalMs, (unsigned long)t.stats.runs,
+             (unsigned long)avg, (unsigned long)t.stats.lateMaxMs, (unsigned long)t.stats.missed);
+    t.stats = TaskStats();
+  }
+}
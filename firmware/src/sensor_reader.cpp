@@ -0,0 +1,117 @@
+#include "sensor_reader.h"
+
+#include "humidity.h"
+#include "sensirion_i2c.h"
+
+// SHT3x single shot, high repeatability, no clock stretching: max 15.5 ms
+static const uint16_t SHT_CMD_MEASURE = 0x2400;
+static const uint32_t SHT_MEASURE_MS = 16;
+
+// SGP30 commands and their max durations (datasheet table 10)
+static const uint16_t SGP_CMD_MEASURE_IAQ = 0x2008;
+static const uint32_t SGP_MEASURE_MS = 12;
+static const uint16_t SGP_CMD_SET_HUMIDITY = 0x2061;
+static const uint32_t SGP_SET_HUMIDITY_MS = 10;
+
+SensorReader::SensorReader(TwoWire& wire, uint8_t shtAddr, uint8_t sgpAddr)
+  : _wire(wire), _shtAddr(shtAddr), _sgpAddr(sgpAddr) {
+  _sample = SensorSample();
+  _sample.tC = _sample.rh = NAN;
+}
+
+bool SensorReader::command(uint8_t addr, uint16_t cmd, const uint16_t* args, uint8_t count) {
+  if (sensirionCommand(_wire, addr, cmd, args, count)) return true;
+  _errors++;
+  return false;
+}
+
+bool SensorReader::readWords(uint8_t addr, uint16_t* words, uint8_t count) {
+  if (sensirionRead(_wire, addr, words, count)) return true;
+  _errors++;
+  return false;
+}
+
+bool SensorReader::startSht(uint32_t nowMs) {
+  if (!_shtOn) return false;
+  if (_shtPending) {
+    _overruns++;
+    return false;
+  }
+  _shtStartMs = nowMs;
+  _shtPending = command(_shtAddr, SHT_CMD_MEASURE);
+  if (!_shtPending) _sample.shtValid = false;
+  return _shtPending;
+}
+
+bool SensorReader::startSgp(uint32_t nowMs) {
+  if (!_sgpOn) return false;
+  if (_sgp != SgpPhase::Idle) {
+    _overruns++;
+    return false;
+  }
+  _sgpStartMs = nowMs;
+  if (!command(_sgpAddr, SGP_CMD_MEASURE_IAQ)) {
+    _sample.sgpValid = false;
+    return false;
+  }
+  _sgp = SgpPhase::Measuring;
+  return true;
+}
+
+void SensorReader::readSht() {
+  uint16_t raw[2];
+  SensorSample& s = _sample;
+  s.shtMs = _shtStartMs;
+  s.shtValid = readWords(_shtAddr, raw, 2);
+  if (!s.shtValid) {
+    s.tC = s.rh = NAN;
+    return;
+  }
+
+  // T = -45 + 175·raw/65535, RH = 100·raw/65535 (in hundredths)
+  s.tCenti = -4500 + (int32_t)((17500UL * raw[0] + 32767) / 65535);
+  s.rhCenti = (int32_t)((10000UL * raw[1] + 32767) / 65535);
+  s.tC = s.tCenti / 100.0f;
+  s.rh = s.rhCenti / 100.0f;
+
+  // Compensation for the SGP30, in the sensor's 8.8 fixed g/m³
+  uint32_t ahMg = absoluteHumidityMgM3(s.tCenti, s.rhCenti);
+  _ahScaled = (uint16_t)min<uint32_t>((ahMg * 256 + 500) / 1000, 0xFFFF);
+  _ahPending = true;
+}
+
+void SensorReader::readSgp(uint32_t nowMs) {
+  // measure_iaq returns eCO2 then TVOC
+  uint16_t raw[2];
+  SensorSample& s = _sample;
+  s.sgpMs = _sgpStartMs;
+  s.sgpValid = readWords(_sgpAddr, raw, 2);
+  if (s.sgpValid) {
+    s.eco2 = raw[0];
+    s.tvoc = raw[1];
+  }
+
+  // The sensor is idle until the next tick: apply fresh compensation now
+  _sgp = SgpPhase::Idle;
+  if (_ahPending && _ahScaled != 0 && command(_sgpAddr, SGP_CMD_SET_HUMIDITY, &_ahScaled, 1)) {
+    _ahPending = false;
+    _sgp = SgpPhase::Settling;
+    _sgpStartMs = nowMs;
+  }
+}
+
+uint8_t SensorReader::poll(uint32_t nowMs) {
+  uint8_t done = 0;
+  if (_sgp == SgpPhase::Measuring && nowMs - _sgpStartMs >= SGP_MEASURE_MS) {
+    readSgp(nowMs);
+    done |= SENSOR_SGP;
+  } else if (_sgp == SgpPhase::Settling && nowMs - _sgpStartMs >= SGP_SET_HUMIDITY_MS) {
+    _sgp = SgpPhase::Idle;
+  }
+  if (_shtPending && nowMs - _shtStartMs >= SHT_MEASURE_MS) {
+    _shtPending = false;
+    readSht();
+    done |= SENSOR_SHT;
+  }
+  return done;
+}
@@ -0,0 +1,160 @@
+#include "sensor_registry.h"
+
+#include "log.h"
+
+// First starts land between the 1 Hz SGP30 ticks and apart from each other
+static const uint32_t SENSOR_PHASE_MS = 500;
+static const uint32_t SENSOR_STAGGER_MS = 100;
+
+bool SensorRegistry::add(SensorDriver& driver) {
+  const SensorSpec& spec = driver.spec();
+  if (_count >= MAX_DRIVERS || _fields + spec.fieldCount > READING_EXTRA_MAX) {
+    LOG_ERROR("[SENSOR] No room for %s (%u field(s))", spec.name, (unsigned)spec.fieldCount);
+    return false;
+  }
+  if (spec.intervalMs == 0 || spec.measureMs >= spec.intervalMs) {
+    LOG_ERROR("[SENSOR] %s can't measure in %lu ms every %lu ms", spec.name,
+              (unsigned long)spec.measureMs, (unsigned long)spec.intervalMs);
+    return false;
+  }
+  Slot& s = _slots[_count++];
+  s = Slot();
+  s.driver = &driver;
+  s.phase = Phase::Out;
+  s.firstValue = _fields;
+  _fields += spec.fieldCount;
+  return true;
+}
+
+void SensorRegistry::begin(uint32_t nowMs) {
+  for (uint8_t i = 0; i < _count; i++) {
+    Slot& s = _slots[i];
+    s.nextMs = nowMs + SENSOR_PHASE_MS + i * SENSOR_STAGGER_MS;
+    s.phase = s.driver->probe() ? Phase::Idle : Phase::Out;
+    if (s.phase == Phase::Out) LOG_ERROR("[SENSOR] %s not found", s.driver->spec().name);
+  }
+}
+
+bool SensorRegistry::reprobe(uint32_t nowMs) {
+  bool found = false;
+  for (uint8_t i = 0; i < _count; i++) {
+    Slot& s = _slots[i];
+    if (s.phase != Phase::Out || !s.driver->probe()) continue;
+    s.phase = Phase::Idle;
+    s.failures = 0;
+    s.nextMs = nowMs;
+    found = true;
+    LOG_INFO("[SENSOR] %s found", s.driver->spec().name);
+  }
+  return found;
+}
+
+// Next deadline on the grid after nowMs (skipped slots keep the phase)
+void SensorRegistry::advance(Slot& s, uint32_t nowMs) {
+  uint32_t interval = s.driver->spec().intervalMs;
+  s.nextMs += ((nowMs - s.nextMs) / interval + 1) * interval;
+}
+
+void SensorRegistry::start(Slot& s, uint32_t nowMs) {
+  advance(s, nowMs);
+  s.stepMs = nowMs;
+  if (s.driver->start()) {
+    s.phase = Phase::Measuring;
+  } else {
+    fail(s);
+  }
+}
+
+void SensorRegistry::collect(Slot& s, uint32_t nowMs) {
+  s.stepMs = nowMs;
+  switch (s.driver->collect(_values + s.firstValue)) {
+    case SensorStep::Done:
+      s.valid = true;
+      s.updatedMs = nowMs;
+      s.failures = 0;
+      s.phase = Phase::Idle;
+      return;
+    case SensorStep::Unchanged:
+      s.failures = 0;
+      s.phase = Phase::Idle;
+      return;
+    case SensorStep::Again:
+      return;   // still Measuring, from this transfer on
+    case SensorStep::Failed:
+      fail(s);
+      return;
+  }
+}
+
+void SensorRegistry::fail(Slot& s) {
+  _errors++;
+  s.phase = Phase::Idle;
+  if (++s.failures < SENSOR_FAILURE_LIMIT) return;
+  s.phase = Phase::Out;
+  s.valid = false;
+  LOG_WARN("[SENSOR] %s stopped answering", s.driver->spec().name);
+}
+
+void SensorRegistry::poll(uint32_t nowMs) {
+  // A finished conversion first: its result has been waiting longest
+  for (uint8_t i = 0; i < _count; i++) {
+    Slot& s = _slots[i];
+    if (s.phase == Phase::Measuring && nowMs - s.stepMs >= s.driver->spec().measureMs) {
+      collect(s, nowMs);
+      return;
+    }
+  }
+
+  for (uint8_t k = 0; k < _count; k++) {
+    uint8_t i = (_nextStart + k) % _count;
+    Slot& s = _slots[i];
+    if (s.phase == Phase::Out || (int32_t)(nowMs - s.nextMs) < 0) continue;
+    if (s.phase == Phase::Measuring) {
+      _overruns++;
+      advance(s, nowMs);
+      continue;
+    }
+    start(s, nowMs);
+    _nextStart = (uint8_t)((i + 1) % _count);
+    return;
+  }
+}
+
+void SensorRegistry::fill(ReadingExtras& out, uint32_t nowMs) const {
+  out.count = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    const Slot& s = _slots[i];
+    const SensorSpec& spec = s.driver->spec();
+    if (!s.valid || nowMs - s.updatedMs > 3 * spec.intervalMs) continue;
+    for (uint8_t f = 0; f < spec.fieldCount; f++) {
+      out.field[out.count] = spec.fields[f];
+      out.value[out.count] = _values[s.firstValue + f];
+      out.count++;
+    }
+  }
+}
+
+bool SensorRegistry::busy() const {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_slots[i].phase == Phase::Measuring) return true;
+  }
+  return false;
+}
+
+bool SensorRegistry::missing() const {
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_slots[i].phase == Phase::Out) return true;
+  }
+  return false;
+}
+
+uint32_t SensorRegistry::untilNext(uint32_t nowMs) const {
+  uint32_t next = UINT32_MAX;
+  for (uint8_t i = 0; i < _count; i++) {
+    const Slot& s = _slots[i];
+    if (s.phase == Phase::Out) continue;
+    int32_t until = (int32_t)(s.nextMs - nowMs);
+    next = min<uint32_t>(next, until > 0 ? (uint32_t)until : 0);
+  }
+  return next;
+}
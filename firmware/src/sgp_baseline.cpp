@@ -0,0 +1,79 @@
+#include "sgp_baseline.h"
+
+#include <LittleFS.h>
+#include <time.h>
+
+#include "log.h"
+#include "rtc_store.h"
+
+static const char* BASELINE_PATH = "/sgp_baseline";
+static const uint32_t BASELINE_MAGIC = 0x53475031;  // "SGP1"
+
+// Sensirion: store the baseline hourly, only after 12 h of operation from a
+// fresh start, and don't restore one older than 7 days
+static const uint32_t BASELINE_SAVE_INTERVAL_MS = 3600000UL;
+static const uint32_t BASELINE_LEARN_MS = 12UL * 3600000UL;
+static const uint32_t BASELINE_MAX_AGE_S = 7UL * 24 * 3600;
+
+// Anything earlier means the clock was never set
+static const time_t EPOCH_VALID_AFTER = 1600000000;
+
+SgpBaseline::SgpBaseline(Adafruit_SGP30& sgp) : _sgp(sgp) {}
+
+bool SgpBaseline::restore(bool warmRestart) {
+  File f = LittleFS.open(BASELINE_PATH, "r");
+  if (!f) return false;
+  Snapshot snap;
+  bool ok = f.read((uint8_t*)&snap, sizeof(snap)) == sizeof(snap);
+  f.close();
+
+  if (!ok || snap.magic != BASELINE_MAGIC ||
+      snap.crc != crc32((const uint8_t*)&snap, offsetof(Snapshot, crc))) {
+    return false;
+  }
+
+  if (!warmRestart) {
+    time_t now = time(nullptr);
+    bool ageKnown = snap.savedEpoch != 0 && now > EPOCH_VALID_AFTER;
+    if (!ageKnown || (uint32_t)(now - snap.savedEpoch) > BASELINE_MAX_AGE_S) {
+      LOG_INFO("[SGP30] Stored baseline may be stale, relearning");
+      return false;
+    }
+  }
+
+  _restored = _sgp.setIAQBaseline(snap.eco2, snap.tvoc);
+  _trusted = _restored;
+  if (_restored) {
+    LOG_INFO("[SGP30] Baseline restored (eCO2 0x%04X, TVOC 0x%04X)", snap.eco2, snap.tvoc);
+  }
+  return _restored;
+}
+
+void SgpBaseline::poll(uint32_t algoMs) {
+  // Without a restored baseline the algorithm must learn for 12 h before a snapshot is meaningful
+  if (!_trusted) {
+    if (algoMs < BASELINE_LEARN_MS) return;
+    _trusted = true;
+  }
+  uint32_t since = (_lastSaveMs != 0) ? algoMs - _lastSaveMs : algoMs;
+  if (since < BASELINE_SAVE_INTERVAL_MS) return;
+  _lastSaveMs = algoMs;
+  save();
+}
+
+void SgpBaseline::save() {
+  if (!_trusted) return;
+
+  Snapshot snap;
+  if (!_sgp.getIAQBaseline(&snap.eco2, &snap.tvoc)) return;
+  time_t now = time(nullptr);
+  snap.magic = BASELINE_MAGIC;
+  snap.savedEpoch = now > EPOCH_VALID_AFTER ? (uint32_t)now : 0;
+  snap.crc = crc32((const uint8_t*)&snap, offsetof(Snapshot, crc));
+
+  File f = LittleFS.open(BASELINE_PATH, "w");
+  if (!f) return;
+  f.write((const uint8_t*)&snap, sizeof(snap));
+  f.close();
+  LOG_INFO("[SGP30] Baseline saved");
+}
@@ -0,0 +1,56 @@
+#include "timekeeper.h"
+
+#include <coredecls.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "log.h"
+
+// Drift is only estimated over spans long enough for ms rounding to be noise
+static const uint32_t DRIFT_MIN_SPAN_MS = 600000;
+// Clamp: a crystal is within ~±100 ppm, deep-sleep timing within a few %
+static const int32_t DRIFT_MAX_PPM = 50000;
+
+// Set from the SNTP callback (SDK context), consumed in poll()
+static volatile bool sntpSynced = false;
+
+void Timekeeper::begin(const char* server1, const char* server2) {
+  settimeofday_cb([]() { sntpSynced = true; });
+  configTime(0, 0, server1, server2);  // UTC; the server stores epoch ms
+}
+
+uint64_t Timekeeper::toEpochMs(uint32_t uptimeMs) const {
+  if (!synced()) return 0;
+
+  // Signed span: uptime timestamps from before the sync are mapped backwards
+  int64_t span = (int32_t)(uptimeMs - _state.syncUptimeMs);
+  int64_t corrected = span + span * _state.driftPpm / 1000000;
+  return (uint64_t)((int64_t)_state.syncEpochMs + corrected);
+}
+
+void Timekeeper::poll(uint32_t uptimeMs) {
+  if (!sntpSynced) return;
+  sntpSynced = false;
+
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  uint64_t epochMs = (uint64_t)tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+
+  if (synced()) {
+    uint32_t span = uptimeMs - _state.syncUptimeMs;
+    if (span >= DRIFT_MIN_SPAN_MS) {
+      // Error of the uptime clock since the last sync, folded into a running estimate
+      int64_t predicted = (int64_t)toEpochMs(uptimeMs);
+      int64_t errorMs = (int64_t)epochMs - predicted;
+      int32_t ppm = _state.driftPpm + (int32_t)(errorMs * 1000000 / span);
+      ppm = constrain(ppm, -DRIFT_MAX_PPM, DRIFT_MAX_PPM);
+      _state.driftPpm = (_state.driftPpm + ppm) / 2;
+    }
+  }
+
+  _state.syncEpochMs = epochMs;
+  _state.syncUptimeMs = uptimeMs;
+  _state.syncs++;
+
+  LOG_INFO("[TIME] SNTP sync #%lu, drift %ld ppm", (unsigned long)_state.syncs, (long)_state.driftPpm);
+}
@@ -0,0 +1,149 @@
+#include "tls_trust.h"
+
+#include <time.h>
+#include <bearssl/bearssl.h>
+
+#include "log.h"
+
+// Before the first SNTP sync time() is near 0 and no certificate is valid yet
+static const time_t TLS_MIN_EPOCH = 1700000000;   // Nov 2023
+
+// Record sizes for setBufferSizes() (BearSSL adds its own overhead to each).
+// Requests are small and leave in several records, so TX stays at the minimum;
+// RX needs a full 16 KB record unless the server agreed to a smaller one.
+static const uint16_t TLS_RX_MFLN = 1024;
+static const uint16_t TLS_RX_FULL = 16384;
+static const uint16_t TLS_TX = 512;
+
+// Hosts sharing a root CA PEM share its parsed copy
+static PGM_P sharedRootsPem = nullptr;
+static BearSSL::X509List* sharedRoots = nullptr;
+
+static bool configured(PGM_P pem) {
+  return pem != nullptr && pgm_read_byte(pem) != '\0';
+}
+
+// The server failed verification: certificate/chain errors, or a signature
+// that doesn't match the pinned key. I/O errors and timeouts are not this.
+static bool rejectedKey(int sslError) {
+  return (sslError > BR_ERR_X509_OK && sslError <= BR_ERR_X509_NOT_TRUSTED) || sslError == BR_ERR_BAD_SIGNATURE;
+}
+
+TlsTrust::TlsTrust(const char* host, PGM_P pinPem, PGM_P caPem, bool allowInsecure)
+  : _host(host), _pinPem(pinPem), _caPem(caPem), _allowInsecure(allowInsecure) {}
+
+const char* TlsTrust::name(Mode mode) {
+  switch (mode) {
+    case Mode::Pinned: return "pinned";
+    case Mode::RootCa: return "root_ca";
+    case Mode::Insecure: return "insecure";
+    default: return "none";
+  }
+}
+
+void TlsTrust::begin() {
+  if (configured(_pinPem)) {
+    _pin = new BearSSL::PublicKey(_pinPem);
+    if (!_pin->isRSA() && !_pin->isEC()) {
+      LOG_ERROR("[TLS] %s: pinned public key unreadable", _host);
+      delete _pin;
+      _pin = nullptr;
+    }
+  }
+  if (configured(_caPem)) {
+    if (sharedRootsPem != _caPem) {
+      sharedRootsPem = _caPem;
+      sharedRoots = new BearSSL::X509List(_caPem);
+      if (sharedRoots->getCount() == 0) LOG_ERROR("[TLS] Root CA unreadable");
+    }
+    if (sharedRoots->getCount() > 0) _roots = sharedRoots;
+  }
+
+  _mode = _pin ? Mode::Pinned : _roots ? Mode::RootCa : _allowInsecure ? Mode::Insecure : Mode::None;
+  if (_mode == Mode::None) {
+    LOG_ERROR("[TLS] %s: no pinned key or root CA, not connecting", _host);
+  } else if (_mode == Mode::Insecure) {
+    LOG_WARN("[TLS] %s: server NOT verified (TLS_ALLOW_INSECURE)", _host);
+  } else {
+    LOG_INFO("[TLS] %s: %s%s", _host, name(_mode), _mode == Mode::Pinned && _roots ? ", root CA fallback" : "");
+  }
+}
+
+TlsTrust::Mode TlsTrust::active() const {
+  return _mode == Mode::Pinned && _fallback ? Mode::RootCa : _mode;
+}
+
+// The probe is one more blocking TCP connect and ClientHello, so it runs once;
+// a failed probe is retried until a real connect shows the network was up
+void TlsTrust::sizeBuffers(BearSSL::WiFiClientSecure& client, uint16_t port) {
+  if (_mfln == Mfln::Unknown || _mfln == Mfln::Unconfirmed) {
+    bool ok = BearSSL::WiFiClientSecure::probeMaxFragmentLength(_host, port, TLS_RX_MFLN);
+    _mfln = ok ? Mfln::Supported : Mfln::Unconfirmed;
+    LOG_INFO("[TLS] %s: max fragment length %u %s", _host, (unsigned)TLS_RX_MFLN,
+             ok ? "supported" : "not supported (16 KB receive buffer)");
+  }
+  client.setBufferSizes(_mfln == Mfln::Supported ? TLS_RX_MFLN : TLS_RX_FULL, TLS_TX);
+}
+
+bool TlsTrust::apply(BearSSL::WiFiClientSecure& client, uint16_t port) {
+  bool ok = false;
+  _usedPin = false;
+  if (_fallback && (int32_t)(millis() - _retryPinMs) >= 0) {
+    // One more rejection sets the pin aside again
+    _fallback = false;
+    _pinFailures = TLS_PIN_FAILURES - 1;
+    LOG_INFO("[TLS] %s: retrying the pinned key", _host);
+  }
+
+  switch (_mode) {
+    case Mode::Pinned: {
+      // Before the first SNTP sync the root CA can't be checked; the pin can
+      if (!_fallback || time(nullptr) < TLS_MIN_EPOCH) {
+        client.setKnownKey(_pin);
+        _usedPin = true;
+      } else {
+        client.setX509Time(time(nullptr));
+        client.setTrustAnchors(_roots);
+      }
+      ok = true;
+      break;
+    }
+
+    case Mode::RootCa: {
+      time_t now = time(nullptr);
+      if (now < TLS_MIN_EPOCH) {
+        LOG_DEBUG("[TLS] %s: waiting for SNTP to check certificate dates", _host);
+        break;
+      }
+      client.setX509Time(now);
+      client.setTrustAnchors(_roots);
+      ok = true;
+      break;
+    }
+
+    case Mode::Insecure:
+      client.setInsecure();
+      ok = true;
+      break;
+
+    default:
+      break;
+  }
+  if (ok) sizeBuffers(client, port);
+  return ok;
+}
+
+void TlsTrust::noteHandshake(bool ok, int sslError) {
+  if (ok && _mfln == Mfln::Unconfirmed) _mfln = Mfln::Unsupported;
+  if (!_usedPin) return;
+  if (ok) {
+    _pinFailures = 0;
+    return;
+  }
+  if (!rejectedKey(sslError)) return;   // never got as far as checking the key
+  if (++_pinFailures < TLS_PIN_FAILURES || _roots == nullptr) return;
+  _fallback = true;
+  _retryPinMs = millis() + TLS_PIN_RETRY_MS;
+  LOG_WARN("[TLS] %s: pinned key rejected %u times (BearSSL error %d), using the root CA for %u min",
+           _host, (unsigned)_pinFailures, sslError, (unsigned)(TLS_PIN_RETRY_MS / 60000));
+}
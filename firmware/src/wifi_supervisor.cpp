@@ -0,0 +1,142 @@
+#include "wifi_supervisor.h"
+
+#include "log.h"
+#include "rtc_store.h"
+
+static const uint32_t WIFI_CACHE_MAGIC = 0x57494631;  // "WIF1"
+
+// Association timeouts: a cached BSSID/channel either works quickly or not at all
+static const uint32_t WIFI_FAST_TIMEOUT_MS = 3000;
+static const uint32_t WIFI_FULL_TIMEOUT_MS = 15000;
+// Backoff between failed attempts: doubles from MIN to MAX
+static const uint32_t WIFI_BACKOFF_MIN_MS = 1000;
+static const uint32_t WIFI_BACKOFF_MAX_MS = 300000;
+
+WifiSupervisor::WifiSupervisor(const char* ssid, const char* password, bool cacheStaticIp)
+  : _ssid(ssid), _password(password), _cacheStaticIp(cacheStaticIp) {}
+
+void WifiSupervisor::begin() {
+  // The SDK would otherwise write credentials to flash on every begin() and
+  // retry on its own schedule; this class owns both
+  WiFi.persistent(false);
+  WiFi.setAutoReconnect(false);
+  WiFi.mode(WIFI_STA);
+  _begun = true;
+
+  _cacheValid = rtcLoad(RTC_SLOT_WIFI, WIFI_CACHE_MAGIC, _cache);
+  startAttempt(millis());
+}
+
+void WifiSupervisor::suspend() {
+  WiFi.disconnect();
+  WiFi.mode(WIFI_OFF);
+  WiFi.forceSleepBegin();
+  _state = State::Idle;
+}
+
+void WifiSupervisor::resume() {
+  if (_state != State::Idle) return;
+  WiFi.forceSleepWake();
+  if (!_begun) {
+    begin();
+    return;
+  }
+  WiFi.mode(WIFI_STA);
+  _backoffMs = 0;
+  startAttempt(millis());
+}
+
+void WifiSupervisor::startAttempt(uint32_t nowMs) {
+  _fastAttempt = _cacheValid;
+  _attemptStartMs = nowMs;
+  _state = State::Connecting;
+
+  LOG_INFO("[WIFI] %s to %s", _fastAttempt ? "Fast-connecting" : "Connecting", _ssid);
+
+  if (_fastAttempt && _cache.hasIp && _cacheStaticIp) {
+    WiFi.config(IPAddress(_cache.ip), IPAddress(_cache.gateway), IPAddress(_cache.subnet), IPAddress(_cache.dns));
+  } else {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));  // back to DHCP
+  }
+
+  if (_fastAttempt) {
+    WiFi.begin(_ssid, _password, _cache.channel, _cache.bssid);
+  } else {
+    WiFi.begin(_ssid, _password);
+  }
+}
+
+void WifiSupervisor::onConnected(uint32_t nowMs) {
+  _state = State::Connected;
+  _backoffMs = 0;
+  _lastConnectMs = nowMs - _attemptStartMs;
+  _reconnects++;
+
+  IPAddress ip = WiFi.localIP();
+  LOG_INFO("[WIFI] Connected in %lu ms, IP: %u.%u.%u.%u", (unsigned long)_lastConnectMs,
+           ip[0], ip[1], ip[2], ip[3]);
+
+  // Refresh the cache from the association we just got
+  memcpy(_cache.bssid, WiFi.BSSID(), sizeof(_cache.bssid));
+  _cache.channel = (uint8_t)WiFi.channel();
+  _cache.hasIp = 1;
+  _cache.ip = WiFi.localIP();
+  _cache.gateway = WiFi.gatewayIP();
+  _cache.subnet = WiFi.subnetMask();
+  _cache.dns = WiFi.dnsIP();
+  _cacheValid = rtcSave(RTC_SLOT_WIFI, WIFI_CACHE_MAGIC, _cache);
+}
+
+void WifiSupervisor::onFailed(uint32_t nowMs) {
+  WiFi.disconnect();
+
+  if (_fastAttempt) {
+    // The AP moved channel or the lease is gone; retry right away with a full scan and DHCP
+    LOG_WARN("[WIFI] Fast connect failed, falling back to full scan");
+    _cacheValid = false;
+    rtcClear(RTC_SLOT_WIFI);
+    startAttempt(nowMs);
+    return;
+  }
+
+  _backoffMs = (_backoffMs == 0) ? WIFI_BACKOFF_MIN_MS : min<uint32_t>(_backoffMs * 2, WIFI_BACKOFF_MAX_MS);
+  uint32_t wait = _backoffMs + (uint32_t)random(_backoffMs / 4 + 1);  // jitter spreads a fleet's retries
+  _nextAttemptMs = nowMs + wait;
+  _state = State::Backoff;
+
+  LOG_WARN("[WIFI] Connection failed, retrying in %lu s", (unsigned long)(wait / 1000));
+}
+
+void WifiSupervisor::poll() {
+  uint32_t now = millis();
+  wl_status_t status = WiFi.status();
+
+  switch (_state) {
+    case State::Idle:
+      return;
+
+    case State::Connecting: {
+      if (status == WL_CONNECTED) {
+        onConnected(now);
+        return;
+      }
+      uint32_t timeout = _fastAttempt ? WIFI_FAST_TIMEOUT_MS : WIFI_FULL_TIMEOUT_MS;
+      if (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL || now - _attemptStartMs >= timeout) {
+        onFailed(now);
+      }
+      return;
+    }
+
+    case State::Connected:
+      if (status != WL_CONNECTED) {
+        LOG_WARN("[WIFI] Connection lost");
+        // The cached BSSID/channel are still the best guess for the first retry
+        startAttempt(now);
+      }
+      return;
+
+    case State::Backoff:
+      if ((int32_t)(now - _nextAttemptMs) >= 0) startAttempt(now);
+      return;
+  }
+}
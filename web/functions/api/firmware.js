@@ -0,0 +1,47 @@
+// AirQ firmware update check - Cloudflare Pages Function
+// GET /api/firmware?device_id=<id>&version=<running>[&want=<version>]
+//
+// Images are static assets listed in public/firmware/manifest.json:
+//   { "latest": "1.1.0",
+//     "images": { "1.1.0": { "path": "/firmware/airq-1.1.0.bin.gz", "size": 301234, "sha256": "<hex>" } } }
+// The device gets one text line "<version> <path> <size> <sha256>" for the
+// latest image (or the one it asks for with want=, to roll back), and 204 when
+// it already runs it. Plain text keeps the device side to a single sscanf().
+
+const VERSION = /^[0-9A-Za-z._-]{1,15}$/;
+
+function textResponse(body, status = 200) {
+  return new Response(body, {
+    status,
+    headers: { "Content-Type": "text/plain", "Cache-Control": "no-store" }
+  });
+}
+
+export async function onRequestGet(context) {
+  const params = new URL(context.request.url).searchParams;
+  const running = params.get('version') || '';
+  const want = params.get('want');
+  if (want !== null && !VERSION.test(want)) return textResponse("Invalid version\n", 400);
+
+  let manifest;
+  try {
+    const res = await context.env.ASSETS.fetch(new URL('/firmware/manifest.json', context.request.url));
+    if (!res.ok) return textResponse("No firmware manifest\n", 404);
+    manifest = await res.json();
+  } catch (error) {
+    console.error("Firmware manifest error:", error);
+    return textResponse("Unreadable firmware manifest\n", 500);
+  }
+
+  const version = want ?? manifest.latest;
+  if (!version || version === running) return new Response(null, { status: 204 });
+
+  const image = manifest.images && manifest.images[version];
+  if (!image || !VERSION.test(version) || !(image.size > 0) || !/^[0-9a-f]{64}$/i.test(image.sha256 || '') ||
+      !/^\/\S{1,126}$/.test(image.path || '')) {
+    return textResponse("Unknown firmware version\n", 404);
+  }
+
+  console.log(`[${params.get('device_id') || '?'}] firmware ${running} -> ${version}${want ? ' (rollback)' : ''}`);
+  return textResponse(`${version} ${image.path} ${image.size} ${image.sha256.toLowerCase()}\n`);
+}
@@ -0,0 +1,54 @@
+import { queryRollups, toRollup } from '../../lib/readings-store.js';
+
+const MAX_DAYS = 365;
+
+// Hourly averages for the dashboard's history charts, from rollup_1h.
+// ?days=<n> (default 7), ?device=<id> limits to one device.
+export async function onRequestGet(context) {
+  try {
+    if (!context.env.DB) {
+      return new Response(JSON.stringify({ success: false, error: "Database not configured" }), {
+        status: 500,
+        headers: { "Content-Type": "application/json" }
+      });
+    }
+
+    const params = new URL(context.request.url).searchParams;
+    const days = Math.min(Math.max(parseInt(params.get('days'), 10) || 7, 1), MAX_DAYS);
+    const now = Date.now();
+    const rows = await queryRollups(context.env.DB, {
+      resolution: '1h',
+      fromMs: now - days * 24 * 3600 * 1000,
+      toMs: now + 3600 * 1000,
+      deviceId: params.get('device') || null,
+      limit: MAX_DAYS * 24 * 16
+    });
+
+    const data = rows.map(toRollup).map(r => ({
+      timestamp: new Date(r.ts).toISOString(),
+      device_id: r.device_id,
+      samples: r.n,
+      temp_c_avg: r.t_c,
+      rh_avg: r.rh,
+      tvoc_ppb_avg: r.tvoc_ppb,
+      eco2_ppm_avg: r.eco2_ppm,
+      aq_index_avg: r.aq_index,
+      tvoc_ppb_max: r.max.tvoc_ppb,
+      eco2_ppm_max: r.max.eco2_ppm
+    }));
+
+    return new Response(JSON.stringify({ success: true, data }), {
+      headers: {
+        "Content-Type": "application/json",
+        "Access-Control-Allow-Origin": "*"
+      }
+    });
+
+  } catch (error) {
+    console.error("History API error:", error);
+    return new Response(JSON.stringify({ success: false, error: "Failed to fetch history" }), {
+      status: 500,
+      headers: { "Content-Type": "application/json" }
+    });
+  }
+}
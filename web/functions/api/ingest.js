@@ -1,52 +1,120 @@
 // AirQ Ingest API - Cloudflare Pages Function
 // Receives sensor data from ESP8266 firmware and stores in D1
+// Accepts either a single reading object or a JSON array of readings (batched upload),
+// or binary records (application/octet-stream, see airq-payload.js) with the
+// device given by ?device_id= or the X-Device-Id header
+//
+// With the INGEST_BUFFER Durable Object bound (workers/ingest-buffer), readings
+// are handed to a per-shard buffer that coalesces many devices' uploads into a
+// few multi-row inserts; without it they are written directly, one batch per request.
 
-export async function onRequestPost(context) {
-  try {
-    const data = await context.request.json();
-    
-    // Basic validation
-    if (!data.device_id || typeof data.tvoc_ppb === 'undefined') {
-      return new Response(JSON.stringify({ error: "Missing required fields" }), {
-        status: 400,
-        headers: { "Content-Type": "application/json" }
-      });
-    }
+import { decodeReadings } from '../../public/airq-payload.js';
+import { toRows, writeRows } from '../../lib/readings-store.js';
 
-    // Save to D1 database
-    if (context.env.DB) {
-      await context.env.DB.prepare(
-        `INSERT INTO readings (device_id, ts_ms, temperature, humidity, tvoc_ppb, eco2_ppm, aq_index, warming_up)
-         VALUES (?, ?, ?, ?, ?, ?, ?, ?)`
-      ).bind(
-        data.device_id,
-        data.ts_ms,
-        data.t_c || null,
-        data.rh || null,
-        data.tvoc_ppb,
-        data.eco2_ppm || null,
-        data.aq_index || null,
-        data.warming_up ? 1 : 0
-      ).run();
-    }
+// Upper bound on readings per request (firmware sends BATCH_MAX_SAMPLES, default 15)
+const MAX_BATCH_SIZE = 500;
+
+// Buffer shards (Durable Object instances); devices map to a fixed shard
+const DEFAULT_INGEST_SHARDS = 8;
+
+function isValidReading(data) {
+  return data && data.device_id && typeof data.tvoc_ppb !== 'undefined';
+}
+
+function jsonResponse(body, status = 200) {
+  return new Response(JSON.stringify(body), {
+    status,
+    headers: { "Content-Type": "application/json" }
+  });
+}
 
-    console.log(`[${data.device_id}] TVOC=${data.tvoc_ppb}ppb AQ=${data.aq_index}`);
+async function parseReadings(request) {
+  const type = request.headers.get("Content-Type") || "";
+  if (type.startsWith("application/octet-stream")) {
+    const url = new URL(request.url);
+    const deviceId = url.searchParams.get("device_id") || request.headers.get("X-Device-Id");
+    const bytes = new Uint8Array(await request.arrayBuffer());
+    const { readings, consumed } = decodeReadings(bytes, deviceId);
+    return { batch: true, readings, undecoded: bytes.length - consumed };
+  }
+
+  const body = await request.json();
+  const batch = Array.isArray(body);
+  return { batch, readings: batch ? body : [body] };
+}
 
-    return new Response(JSON.stringify({ 
-      success: true,
-      device_id: data.device_id
-    }), {
-      status: 200,
-      headers: { "Content-Type": "application/json" }
+// FNV-1a, so a device always lands in the same shard
+function shardOf(deviceId, shards) {
+  let h = 0x811c9dc5;
+  for (let i = 0; i < deviceId.length; i++) {
+    h ^= deviceId.charCodeAt(i);
+    h = Math.imul(h, 0x01000193);
+  }
+  return (h >>> 0) % shards;
+}
+
+// Hand rows to the buffer shards; resolves once each shard has stored them durably
+async function bufferRows(env, rows) {
+  const shards = Number(env.INGEST_SHARDS) || DEFAULT_INGEST_SHARDS;
+  const byShard = new Map();
+  for (const row of rows) {
+    const shard = shardOf(row[0], shards);
+    if (!byShard.has(shard)) byShard.set(shard, []);
+    byShard.get(shard).push(row);
+  }
+  await Promise.all([...byShard].map(async ([shard, shardRows]) => {
+    const stub = env.INGEST_BUFFER.get(env.INGEST_BUFFER.idFromName(`shard-${shard}`));
+    const res = await stub.fetch('https://ingest-buffer/rows', {
+      method: 'POST',
+      body: JSON.stringify(shardRows)
     });
+    if (!res.ok) throw new Error(`ingest buffer shard ${shard}: ${res.status}`);
+  }));
+}
 
+export async function onRequestPost(context) {
+  let parsed;
+  try {
+    parsed = await parseReadings(context.request);
   } catch (error) {
     console.error("Ingest error:", error);
-    return new Response(JSON.stringify({ error: "Invalid request" }), {
-      status: 400,
-      headers: { "Content-Type": "application/json" }
-    });
+    return jsonResponse({ error: "Invalid request" }, 400);
   }
+  const { batch, readings, undecoded } = parsed;
+
+  // Store all of a binary batch or none of it: a record that doesn't decode
+  // (unknown version, truncated upload) would otherwise drop the rest silently
+  if (undecoded) {
+    return jsonResponse({ error: "Undecodable binary record", decoded: readings.length, undecoded }, 422);
+  }
+
+  // Basic validation
+  if (readings.length === 0 || readings.length > MAX_BATCH_SIZE || !readings.every(isValidReading)) {
+    return jsonResponse({ error: "Missing required fields" }, 400);
+  }
+
+  const { env } = context;
+  const rows = toRows(readings, Date.now());
+  let buffered = false;
+  try {
+    if (env.INGEST_BUFFER) {
+      await bufferRows(env, rows);
+      buffered = true;
+    } else if (env.DB) {
+      await writeRows(env.DB, rows);
+    }
+  } catch (error) {
+    // Storage failure: 5xx so the device keeps the readings and retries
+    console.error("Ingest storage error:", error);
+    return jsonResponse({ error: "Storage unavailable" }, 503);
+  }
+
+  const last = readings[readings.length - 1];
+  console.log(`[${last.device_id}] ${readings.length} reading(s), TVOC=${last.tvoc_ppb}ppb AQ=${last.aq_index}`);
+
+  return jsonResponse(batch
+    ? { success: true, device_id: last.device_id, count: readings.length, buffered }
+    : { success: true, device_id: last.device_id, buffered });
 }
 
 // Health check
@@ -59,5 +127,3 @@ export async function onRequestGet() {
     headers: { "Content-Type": "application/json" }
   });
 }
-
-
@@ -1,4 +1,31 @@
-// Get recent readings from last hour
+import { ROLLUPS, queryReadings, queryRollups, toReading, toRollup } from '../../lib/readings-store.js';
+
+// Window (minutes) served by default and the most each resolution may cover
+const DEFAULT_MINUTES = 60;
+const MAX_MINUTES = { raw: 24 * 60, '1m': 7 * 24 * 60, '1h': 90 * 24 * 60 };
+
+// Rows per response; a client that gets a full page polls again with the new cursor
+const PAGE_ROWS = 5000;
+
+// Edge/browser cache lifetime (s): about one device sample interval, longer for hourly data
+const MAX_AGE = { raw: 5, '1m': 10, '1h': 60 };
+
+// FNV-1a of the response body, as a weak validator
+function etagOf(body) {
+  let h = 0x811c9dc5;
+  for (let i = 0; i < body.length; i++) {
+    h ^= body.charCodeAt(i);
+    h = Math.imul(h, 0x01000193);
+  }
+  return `W/"${(h >>> 0).toString(16)}-${body.length.toString(16)}"`;
+}
+
+// Get recent readings, by default the last hour.
+// ?device=<id> limits to one device; ?resolution=raw|1m|1h picks the stored
+// readings or the 1 min / 1 h rollups (default 1m); ?minutes=<n> sets the window.
+// ?since=<cursor> returns only what is newer than a previous response: pass
+// back its X-Cursor header (raw: readings with a later ts; rollups: the
+// buckets from the cursor's on, as the newest one is still filling).
 export async function onRequestGet(context) {
   try {
     if (!context.env.DB) {
@@ -8,32 +35,67 @@ export async function onRequestGet(context) {
       });
     }
 
-    // Get readings from last hour
-    const { results } = await context.env.DB.prepare(
-      `SELECT device_id, ts_ms, temperature, humidity, tvoc_ppb, eco2_ppm, aq_index, warming_up, created_at
-       FROM readings
-       WHERE created_at >= datetime('now', '-1 hour')
-       ORDER BY created_at ASC`
-    ).all();
-
-    // Transform to match firmware JSON format
-    const readings = results.map(r => ({
-      ts_ms: r.ts_ms,
-      device_id: r.device_id,
-      t_c: r.temperature,
-      rh: r.humidity,
-      tvoc_ppb: r.tvoc_ppb,
-      eco2_ppm: r.eco2_ppm,
-      aq_index: r.aq_index,
-      warming_up: r.warming_up === 1
-    }));
-
-    return new Response(JSON.stringify(readings), {
-      headers: { 
-        "Content-Type": "application/json",
-        "Access-Control-Allow-Origin": "*"
+    const url = new URL(context.request.url);
+    const params = url.searchParams;
+    const resolution = params.get('resolution') || '1m';
+    if (resolution !== 'raw' && !ROLLUPS[resolution]) {
+      return new Response(JSON.stringify({ error: "resolution must be raw, 1m or 1h" }), {
+        status: 400,
+        headers: { "Content-Type": "application/json" }
+      });
+    }
+
+    // Clients polling the same URL within MAX_AGE share one D1 query
+    const cache = typeof caches !== 'undefined' ? caches.default : null;
+    let response = cache ? await cache.match(context.request) : null;
+    if (!response) {
+      const minutes = Math.min(Math.max(parseInt(params.get('minutes'), 10) || DEFAULT_MINUTES, 1), MAX_MINUTES[resolution]);
+      const deviceId = params.get('device') || null;
+      const since = parseInt(params.get('since'), 10);
+
+      const now = Date.now();
+      let fromMs = now - minutes * 60 * 1000;
+      if (Number.isFinite(since)) {
+        fromMs = resolution === 'raw'
+          ? Math.max(fromMs, since + 1)
+          : Math.max(fromMs, since - since % ROLLUPS[resolution].ms);
       }
-    });
+      const range = { fromMs, toMs: now + 60 * 1000, deviceId, limit: PAGE_ROWS };
+
+      // Raw rows are transformed to match the firmware JSON format; rollups keep
+      // that shape with the bucket averages, plus n/min/max
+      const readings = resolution === 'raw'
+        ? (await queryReadings(context.env.DB, range)).map(toReading)
+        : (await queryRollups(context.env.DB, { ...range, resolution })).map(toRollup);
+
+      // Newest ts served; on a full page, step back so rows sharing the last
+      // ts with ones cut off are sent again rather than skipped
+      let cursor = Number.isFinite(since) ? since : fromMs - 1;
+      if (readings.length > 0) {
+        const last = readings[readings.length - 1].ts;
+        cursor = readings.length === PAGE_ROWS && resolution === 'raw' ? last - 1 : last;
+      }
+
+      const body = JSON.stringify(readings);
+      response = new Response(body, {
+        headers: { 
+          "Content-Type": "application/json",
+          "Access-Control-Allow-Origin": "*",
+          "Access-Control-Expose-Headers": "ETag, X-Cursor",
+          "Cache-Control": `public, max-age=${MAX_AGE[resolution]}`,
+          "ETag": etagOf(body),
+          "X-Cursor": String(cursor)
+        }
+      });
+      if (cache) context.waitUntil(cache.put(context.request, response.clone()));
+    }
+
+    const etag = response.headers.get("ETag");
+    const match = context.request.headers.get("If-None-Match");
+    if (etag && match && match.split(',').some(tag => tag.trim() === etag)) {
+      return new Response(null, { status: 304, headers: response.headers });
+    }
+    return response;
 
   } catch (error) {
     console.error("Latest API error:", error);
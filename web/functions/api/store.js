@@ -0,0 +1,3 @@
+// AirQ Store API - Cloudflare Pages Function
+// The firmware POSTs to /api/store; served by the same handler as /api/ingest
+export { onRequestPost, onRequestGet } from './ingest.js';
@@ -0,0 +1,272 @@
+// AirQ readings storage in D1, shared by the ingest function and the ingest buffer Worker.
+//
+// Readings live in monthly tables (readings_v2_YYYYMM, UTC) keyed by
+// (device_id, reading_id): small per-table indexes, cheap retention (DROP TABLE)
+// and idempotent writes, so a re-sent upload batch or QoS1 duplicate is ignored.
+// reading_id comes from what the device sent, never from the receive time:
+// boot × 2^32 + ts_ms for firmware that counts its boots, -ts for older
+// firmware (whose estimated ts still moves when a batch is re-sent).
+// reading_buckets lists the tables and the ts range each covers; readers go
+// through it instead of hard-coding table names. Tables from before reading_id
+// (readings, readings_YYYYMM keyed by (device_id, ts)) stay readable.
+//
+// Every write also folds the new rows into per-device rollups at 1 min and 1 h
+// (rollup_1m, rollup_1h: count/min/max/sum per metric), so charts over long
+// ranges read a bounded number of rows. A report that stands for several
+// suppressed samples (agg) contributes its own min/mean/max and sample count,
+// attributed to the bucket of its ts.
+//
+// ts is the measurement time (Unix ms): the device's ts_epoch_ms, or for
+// readings taken before its first SNTP sync an estimate from the receive time
+// and the reading's age relative to the newest reading in the same upload
+// (ts_source = 1).
+
+export const TS_DEVICE = 0;
+export const TS_ESTIMATED = 1;
+
+// Columns in insert order; rows are bound as one JSON array per statement
+const COLUMNS = [
+  'device_id', 'ts', 'ts_source', 'ts_ms', 'boot', 'reading_id', 'temperature', 'humidity', 'tvoc_ppb',
+  'eco2_ppm', 'aq_index', 'warming_up', 'sample_count', 'tvoc_min', 'tvoc_mean', 'tvoc_max', 'eco2_min',
+  'eco2_mean', 'eco2_max', 'temp_min', 'temp_mean', 'temp_max', 'rh_min', 'rh_mean', 'rh_max', 'received_ms'
+];
+const AT = Object.fromEntries(COLUMNS.map((c, i) => [c, i]));
+// Columns every bucket has, the older ones included
+const READ_COLUMNS = COLUMNS.filter(c => c !== 'boot' && c !== 'reading_id');
+
+// Rows per INSERT ... SELECT FROM json_each(?): ~250 B of JSON each, well under D1's value size limit
+const ROWS_PER_STATEMENT = 500;
+
+const NO_SPAN = [null, null, null];
+const BUCKET_NAME = /^readings(_\d{6}|_v2_\d{6})?$/;
+
+function bucketOf(ts) {
+  const d = new Date(ts);
+  const y = d.getUTCFullYear();
+  const m = d.getUTCMonth();
+  return {
+    name: `readings_v2_${y}${String(m + 1).padStart(2, '0')}`,
+    start: Date.UTC(y, m, 1),
+    end: Date.UTC(y, m + 1, 1)
+  };
+}
+
+function createBucketSql(name) {
+  return [
+    `CREATE TABLE IF NOT EXISTS ${name} (
+       device_id TEXT NOT NULL,
+       ts INTEGER NOT NULL,
+       ts_source INTEGER NOT NULL,
+       ts_ms INTEGER NOT NULL,
+       boot INTEGER,
+       reading_id INTEGER NOT NULL,
+       temperature REAL, humidity REAL,
+       tvoc_ppb INTEGER, eco2_ppm INTEGER, aq_index INTEGER, warming_up INTEGER,
+       sample_count INTEGER NOT NULL DEFAULT 1,
+       tvoc_min INTEGER, tvoc_mean INTEGER, tvoc_max INTEGER,
+       eco2_min INTEGER, eco2_mean INTEGER, eco2_max INTEGER,
+       temp_min REAL, temp_mean REAL, temp_max REAL,
+       rh_min REAL, rh_mean REAL, rh_max REAL,
+       received_ms INTEGER NOT NULL,
+       PRIMARY KEY (device_id, reading_id)
+     ) WITHOUT ROWID`,
+    `CREATE INDEX IF NOT EXISTS idx_${name}_device_ts ON ${name}(device_id, ts)`,
+    `CREATE INDEX IF NOT EXISTS idx_${name}_ts ON ${name}(ts)`
+  ];
+}
+
+const INSERT_SELECT = COLUMNS.map((c, i) => `json_extract(value, '$[${i}]')`).join(', ');
+
+// Firmware JSON readings (single, batch or decoded binary) → storage rows.
+// Report-by-exception: "agg" summarizes the samples the device suppressed
+// before this reading ([min, mean, max] per field); absent means a single sample.
+export function toRows(readings, receivedMs) {
+  // Newest uptime per device anchors readings without a device clock
+  const newest = new Map();
+  for (const r of readings) {
+    newest.set(r.device_id, Math.max(newest.get(r.device_id) ?? 0, r.ts_ms ?? 0));
+  }
+  return readings.map(r => {
+    const agg = r.agg || {};
+    const epoch = r.ts_epoch_ms ?? null;
+    const ts = epoch ?? receivedMs - (newest.get(r.device_id) - (r.ts_ms ?? 0));
+    const boot = r.boot || null;
+    return [
+      r.device_id,
+      ts,
+      epoch === null ? TS_ESTIMATED : TS_DEVICE,
+      r.ts_ms ?? 0,
+      boot,
+      boot !== null ? boot * 2 ** 32 + (r.ts_ms >>> 0) : -ts,
+      r.t_c ?? null,
+      r.rh ?? null,
+      r.tvoc_ppb,
+      r.eco2_ppm ?? null,
+      r.aq_index ?? null,
+      r.warming_up ? 1 : 0,
+      agg.n ?? 1,
+      ...(agg.tvoc_ppb ?? NO_SPAN),
+      ...(agg.eco2_ppm ?? NO_SPAN),
+      ...(agg.t_c ?? NO_SPAN),
+      ...(agg.rh ?? NO_SPAN),
+      receivedMs
+    ];
+  });
+}
+
+// Rollup resolutions: table and bucket width
+export const ROLLUPS = {
+  '1m': { table: 'rollup_1m', ms: 60 * 1000 },
+  '1h': { table: 'rollup_1h', ms: 60 * 60 * 1000 }
+};
+
+// Rollup metrics: output name, raw column, and the agg columns (null: no on-device window)
+const METRICS = [
+  { name: 'tvoc_ppb', prefix: 'tvoc', value: 'tvoc_ppb', span: ['tvoc_min', 'tvoc_mean', 'tvoc_max'] },
+  { name: 'eco2_ppm', prefix: 'eco2', value: 'eco2_ppm', span: ['eco2_min', 'eco2_mean', 'eco2_max'] },
+  { name: 'aq_index', prefix: 'aq', value: 'aq_index', span: null },
+  { name: 't_c', prefix: 'temp', value: 'temperature', span: ['temp_min', 'temp_mean', 'temp_max'] },
+  { name: 'rh', prefix: 'rh', value: 'humidity', span: ['rh_min', 'rh_mean', 'rh_max'] }
+];
+
+const ROLLUP_COLUMNS = ['device_id', 'bucket_ms', 'n', ...METRICS.flatMap(m =>
+  [`${m.prefix}_n`, `${m.prefix}_min`, `${m.prefix}_max`, `${m.prefix}_sum`])];
+
+function metricAggregates({ value, span }) {
+  if (!span) return [`COUNT(r.${value})`, `MIN(r.${value})`, `MAX(r.${value})`, `TOTAL(r.${value})`];
+  const [min, mean, max] = span;
+  return [
+    `SUM(CASE WHEN r.${mean} IS NOT NULL THEN r.sample_count WHEN r.${value} IS NOT NULL THEN 1 ELSE 0 END)`,
+    `MIN(COALESCE(r.${min}, r.${value}))`,
+    `MAX(COALESCE(r.${max}, r.${value}))`,
+    `TOTAL(CASE WHEN r.${mean} IS NOT NULL THEN r.${mean} * r.sample_count ELSE r.${value} END)`
+  ];
+}
+
+// Merge the rows of this write into a rollup. The join picks exactly the rows
+// this batch inserted (duplicates ignored by INSERT OR IGNORE keep their
+// original received_ms), so re-sent uploads are not counted twice, whatever ts
+// the estimate gave them this time.
+function rollupSql(rollup, bucketTable) {
+  const merge = ['n = n + excluded.n', ...METRICS.flatMap(({ prefix: p }) => [
+    `${p}_n = ${p}_n + excluded.${p}_n`,
+    `${p}_min = min(COALESCE(${p}_min, excluded.${p}_min), COALESCE(excluded.${p}_min, ${p}_min))`,
+    `${p}_max = max(COALESCE(${p}_max, excluded.${p}_max), COALESCE(excluded.${p}_max, ${p}_max))`,
+    `${p}_sum = ${p}_sum + excluded.${p}_sum`
+  ])];
+  return `INSERT INTO ${rollup.table} (${ROLLUP_COLUMNS.join(', ')})
+    SELECT r.device_id, (r.ts / ${rollup.ms}) * ${rollup.ms} AS bucket, SUM(r.sample_count),
+           ${METRICS.flatMap(metricAggregates).join(', ')}
+    FROM json_each(?) j
+    JOIN ${bucketTable} r ON r.device_id = json_extract(j.value, '$[${AT.device_id}]')
+                         AND r.reading_id = json_extract(j.value, '$[${AT.reading_id}]')
+                         AND r.received_ms = json_extract(j.value, '$[${AT.received_ms}]')
+    WHERE true
+    GROUP BY r.device_id, bucket
+    ON CONFLICT (device_id, bucket_ms) DO UPDATE SET ${merge.join(', ')}`;
+}
+
+// Buckets already created by this isolate (CREATE IF NOT EXISTS is skipped after the first write)
+const knownBuckets = new Set();
+
+// Write rows (from toRows) in one D1 batch: one multi-row INSERT per monthly table
+// and chunk, all in a single round trip and transaction. Returns the statement count.
+export async function writeRows(db, rows) {
+  const byBucket = new Map();
+  const seen = new Set();
+  for (const row of rows) {
+    // A key repeated within one write would otherwise be rolled up twice
+    const key = `${row[AT.device_id]}\u0000${row[AT.reading_id]}`;
+    if (seen.has(key)) continue;
+    seen.add(key);
+    const b = bucketOf(row[AT.ts]);
+    if (!byBucket.has(b.name)) byBucket.set(b.name, { bucket: b, rows: [] });
+    byBucket.get(b.name).rows.push(row);
+  }
+
+  const statements = [];
+  const created = [];
+  for (const { bucket, rows: bucketRows } of byBucket.values()) {
+    if (!knownBuckets.has(bucket.name)) {
+      for (const sql of createBucketSql(bucket.name)) statements.push(db.prepare(sql));
+      statements.push(db.prepare(
+        'INSERT OR IGNORE INTO reading_buckets (name, start_ms, end_ms) VALUES (?, ?, ?)'
+      ).bind(bucket.name, bucket.start, bucket.end));
+      created.push(bucket.name);
+    }
+    const insert = db.prepare(
+      `INSERT OR IGNORE INTO ${bucket.name} (${COLUMNS.join(', ')}) SELECT ${INSERT_SELECT} FROM json_each(?)`
+    );
+    const rollups = Object.values(ROLLUPS).map(r => db.prepare(rollupSql(r, bucket.name)));
+    for (let i = 0; i < bucketRows.length; i += ROWS_PER_STATEMENT) {
+      const chunk = JSON.stringify(bucketRows.slice(i, i + ROWS_PER_STATEMENT));
+      statements.push(insert.bind(chunk));
+      for (const rollup of rollups) statements.push(rollup.bind(chunk));
+    }
+  }
+  if (statements.length > 0) await db.batch(statements);
+  for (const name of created) knownBuckets.add(name);
+  return statements.length;
+}
+
+// Tables holding readings with fromMs <= ts < toMs, oldest first
+export async function bucketsFor(db, fromMs, toMs) {
+  const { results } = await db.prepare(
+    'SELECT name FROM reading_buckets WHERE end_ms > ? AND start_ms < ? ORDER BY start_ms'
+  ).bind(fromMs, toMs).all();
+  return results.map(r => r.name).filter(name => BUCKET_NAME.test(name));
+}
+
+// Readings in [fromMs, toMs) across buckets, oldest first. deviceId narrows to
+// one device (primary key range); limit caps the row count.
+export async function queryReadings(db, { fromMs, toMs, deviceId = null, limit = 10000, columns = READ_COLUMNS.join(', ') }) {
+  const buckets = await bucketsFor(db, fromMs, toMs);
+  if (buckets.length === 0) return [];
+  const where = deviceId ? 'device_id = ? AND ts >= ? AND ts < ?' : 'ts >= ? AND ts < ?';
+  const args = deviceId ? [deviceId, fromMs, toMs] : [fromMs, toMs];
+  const sql = buckets.map(name => `SELECT ${columns} FROM ${name} WHERE ${where}`).join(' UNION ALL ') +
+    ' ORDER BY ts ASC LIMIT ?';
+  const binds = buckets.flatMap(() => args);
+  const { results } = await db.prepare(sql).bind(...binds, limit).all();
+  return results;
+}
+
+// Storage row → the firmware's reading JSON format
+export function toReading(r) {
+  return {
+    ts_ms: r.ts_ms,
+    ts_epoch_ms: r.ts_source === TS_DEVICE ? r.ts : null,
+    ts: r.ts,
+    device_id: r.device_id,
+    t_c: r.temperature,
+    rh: r.humidity,
+    tvoc_ppb: r.tvoc_ppb,
+    eco2_ppm: r.eco2_ppm,
+    aq_index: r.aq_index,
+    warming_up: r.warming_up === 1
+  };
+}
+
+// Rollup rows in [fromMs, toMs) at resolution ('1m' or '1h'), oldest first
+export async function queryRollups(db, { resolution, fromMs, toMs, deviceId = null, limit = 10000 }) {
+  const { table } = ROLLUPS[resolution];
+  const where = deviceId ? 'device_id = ? AND bucket_ms >= ? AND bucket_ms < ?' : 'bucket_ms >= ? AND bucket_ms < ?';
+  const args = deviceId ? [deviceId, fromMs, toMs] : [fromMs, toMs];
+  const { results } = await db.prepare(
+    `SELECT ${ROLLUP_COLUMNS.join(', ')} FROM ${table} WHERE ${where} ORDER BY bucket_ms ASC LIMIT ?`
+  ).bind(...args, limit).all();
+  return results;
+}
+
+// Rollup row → reading-shaped JSON: the metric fields hold the bucket average
+// (so reading consumers can plot it as is), plus min/max and sample counts
+export function toRollup(r) {
+  const out = { device_id: r.device_id, ts: r.bucket_ms, ts_epoch_ms: r.bucket_ms, n: r.n, min: {}, max: {} };
+  for (const { name, prefix } of METRICS) {
+    const n = r[`${prefix}_n`];
+    out[name] = n > 0 ? r[`${prefix}_sum`] / n : null;
+    out.min[name] = r[`${prefix}_min`];
+    out.max[name] = r[`${prefix}_max`];
+  }
+  return out;
+}
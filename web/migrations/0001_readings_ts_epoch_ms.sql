@@ -0,0 +1,5 @@
+-- Device-side measurement time (Unix ms) for readings; NULL for rows from
+-- firmware without SNTP or readings taken before the device's first sync.
+-- Apply with: wrangler d1 migrations apply airq-db
+
+ALTER TABLE readings ADD COLUMN ts_epoch_ms INTEGER;
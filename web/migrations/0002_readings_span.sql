@@ -0,0 +1,17 @@
+-- Report-by-exception: each row may stand for several samples, summarized as
+-- min/mean/max over the window the device suppressed. Existing rows are single samples.
+-- Apply with: wrangler d1 migrations apply airq-db
+
+ALTER TABLE readings ADD COLUMN sample_count INTEGER NOT NULL DEFAULT 1;
+ALTER TABLE readings ADD COLUMN tvoc_min INTEGER;
+ALTER TABLE readings ADD COLUMN tvoc_mean INTEGER;
+ALTER TABLE readings ADD COLUMN tvoc_max INTEGER;
+ALTER TABLE readings ADD COLUMN eco2_min INTEGER;
+ALTER TABLE readings ADD COLUMN eco2_mean INTEGER;
+ALTER TABLE readings ADD COLUMN eco2_max INTEGER;
+ALTER TABLE readings ADD COLUMN temp_min REAL;
+ALTER TABLE readings ADD COLUMN temp_mean REAL;
+ALTER TABLE readings ADD COLUMN temp_max REAL;
+ALTER TABLE readings ADD COLUMN rh_min REAL;
+ALTER TABLE readings ADD COLUMN rh_mean REAL;
+ALTER TABLE readings ADD COLUMN rh_max REAL;
@@ -0,0 +1,25 @@
+-- Partitioned storage: new readings go to monthly tables readings_YYYYMM keyed by
+-- (device_id, ts), created on first write and listed in reading_buckets
+-- (see lib/readings-store.js). The existing readings table stays readable as a
+-- legacy bucket: it gets the same ts / ts_source / received_ms columns.
+-- Apply with: wrangler d1 migrations apply airq-db
+
+CREATE TABLE IF NOT EXISTS reading_buckets (
+    name TEXT PRIMARY KEY,
+    start_ms INTEGER NOT NULL,      -- ts range held by the table: start_ms <= ts < end_ms
+    end_ms INTEGER NOT NULL
+);
+
+ALTER TABLE readings ADD COLUMN ts INTEGER;
+ALTER TABLE readings ADD COLUMN ts_source INTEGER NOT NULL DEFAULT 1;
+ALTER TABLE readings ADD COLUMN received_ms INTEGER;
+
+UPDATE readings SET
+    received_ms = CAST(strftime('%s', created_at) AS INTEGER) * 1000,
+    ts = COALESCE(ts_epoch_ms, CAST(strftime('%s', created_at) AS INTEGER) * 1000),
+    ts_source = CASE WHEN ts_epoch_ms IS NULL THEN 1 ELSE 0 END;
+
+CREATE INDEX IF NOT EXISTS idx_readings_ts ON readings(ts);
+
+INSERT OR IGNORE INTO reading_buckets (name, start_ms, end_ms)
+    SELECT 'readings', MIN(ts), MAX(ts) + 1 FROM readings HAVING COUNT(*) > 0;
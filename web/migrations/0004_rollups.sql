@@ -0,0 +1,83 @@
+-- Rollups: per-device count/min/max/sum of each metric per minute and per hour,
+-- merged by every ingest write (see lib/readings-store.js). Averages are
+-- <metric>_sum / <metric>_n. The legacy readings table is backfilled here; apply
+-- it together with the ingest code, rows written to monthly tables before then
+-- are not rolled up.
+-- Apply with: wrangler d1 migrations apply airq-db
+
+CREATE TABLE IF NOT EXISTS rollup_1m (
+    device_id TEXT NOT NULL,
+    bucket_ms INTEGER NOT NULL,     -- bucket start (Unix ms)
+    n INTEGER NOT NULL,             -- samples, counting each report's sample_count
+    tvoc_n INTEGER NOT NULL, tvoc_min INTEGER, tvoc_max INTEGER, tvoc_sum REAL NOT NULL,
+    eco2_n INTEGER NOT NULL, eco2_min INTEGER, eco2_max INTEGER, eco2_sum REAL NOT NULL,
+    aq_n INTEGER NOT NULL, aq_min INTEGER, aq_max INTEGER, aq_sum REAL NOT NULL,
+    temp_n INTEGER NOT NULL, temp_min REAL, temp_max REAL, temp_sum REAL NOT NULL,
+    rh_n INTEGER NOT NULL, rh_min REAL, rh_max REAL, rh_sum REAL NOT NULL,
+    PRIMARY KEY (device_id, bucket_ms)
+) WITHOUT ROWID;
+CREATE INDEX IF NOT EXISTS idx_rollup_1m_bucket ON rollup_1m(bucket_ms);
+
+CREATE TABLE IF NOT EXISTS rollup_1h (
+    device_id TEXT NOT NULL,
+    bucket_ms INTEGER NOT NULL,     -- bucket start (Unix ms)
+    n INTEGER NOT NULL,             -- samples, counting each report's sample_count
+    tvoc_n INTEGER NOT NULL, tvoc_min INTEGER, tvoc_max INTEGER, tvoc_sum REAL NOT NULL,
+    eco2_n INTEGER NOT NULL, eco2_min INTEGER, eco2_max INTEGER, eco2_sum REAL NOT NULL,
+    aq_n INTEGER NOT NULL, aq_min INTEGER, aq_max INTEGER, aq_sum REAL NOT NULL,
+    temp_n INTEGER NOT NULL, temp_min REAL, temp_max REAL, temp_sum REAL NOT NULL,
+    rh_n INTEGER NOT NULL, rh_min REAL, rh_max REAL, rh_sum REAL NOT NULL,
+    PRIMARY KEY (device_id, bucket_ms)
+) WITHOUT ROWID;
+CREATE INDEX IF NOT EXISTS idx_rollup_1h_bucket ON rollup_1h(bucket_ms);
+
+INSERT OR IGNORE INTO rollup_1m
+    SELECT device_id, (ts / 60000) * 60000 AS bucket, SUM(sample_count),
+           SUM(CASE WHEN tvoc_mean IS NOT NULL THEN sample_count WHEN tvoc_ppb IS NOT NULL THEN 1 ELSE 0 END),
+           MIN(COALESCE(tvoc_min, tvoc_ppb)),
+           MAX(COALESCE(tvoc_max, tvoc_ppb)),
+           TOTAL(CASE WHEN tvoc_mean IS NOT NULL THEN tvoc_mean * sample_count ELSE tvoc_ppb END),
+           SUM(CASE WHEN eco2_mean IS NOT NULL THEN sample_count WHEN eco2_ppm IS NOT NULL THEN 1 ELSE 0 END),
+           MIN(COALESCE(eco2_min, eco2_ppm)),
+           MAX(COALESCE(eco2_max, eco2_ppm)),
+           TOTAL(CASE WHEN eco2_mean IS NOT NULL THEN eco2_mean * sample_count ELSE eco2_ppm END),
+           COUNT(aq_index),
+           MIN(aq_index),
+           MAX(aq_index),
+           TOTAL(aq_index),
+           SUM(CASE WHEN temp_mean IS NOT NULL THEN sample_count WHEN temperature IS NOT NULL THEN 1 ELSE 0 END),
+           MIN(COALESCE(temp_min, temperature)),
+           MAX(COALESCE(temp_max, temperature)),
+           TOTAL(CASE WHEN temp_mean IS NOT NULL THEN temp_mean * sample_count ELSE temperature END),
+           SUM(CASE WHEN rh_mean IS NOT NULL THEN sample_count WHEN humidity IS NOT NULL THEN 1 ELSE 0 END),
+           MIN(COALESCE(rh_min, humidity)),
+           MAX(COALESCE(rh_max, humidity)),
+           TOTAL(CASE WHEN rh_mean IS NOT NULL THEN rh_mean * sample_count ELSE humidity END)
+    FROM readings WHERE ts IS NOT NULL
+    GROUP BY device_id, bucket;
+
+INSERT OR IGNORE INTO rollup_1h
+    SELECT device_id, (ts / 3600000) * 3600000 AS bucket, SUM(sample_count),
+           SUM(CASE WHEN tvoc_mean IS NOT NULL THEN sample_count WHEN tvoc_ppb IS NOT NULL THEN 1 ELSE 0 END),
+           MIN(COALESCE(tvoc_min, tvoc_ppb)),
+           MAX(COALESCE(tvoc_max, tvoc_ppb)),
+           TOTAL(CASE WHEN tvoc_mean IS NOT NULL THEN tvoc_mean * sample_count ELSE tvoc_ppb END),
+           SUM(CASE WHEN eco2_mean IS NOT NULL THEN sample_count WHEN eco2_ppm IS NOT NULL THEN 1 ELSE 0 END),
+           MIN(COALESCE(eco2_min, eco2_ppm)),
+           MAX(COALESCE(eco2_max, eco2_ppm)),
+           TOTAL(CASE WHEN eco2_mean IS NOT NULL THEN eco2_mean * sample_count ELSE eco2_ppm END),
+           COUNT(aq_index),
+           MIN(aq_index),
+           MAX(aq_index),
+           TOTAL(aq_index),
+           SUM(CASE WHEN temp_mean IS NOT NULL THEN sample_count WHEN temperature IS NOT NULL THEN 1 ELSE 0 END),
+           MIN(COALESCE(temp_min, temperature)),
+           MAX(COALESCE(temp_max, temperature)),
+           TOTAL(CASE WHEN temp_mean IS NOT NULL THEN temp_mean * sample_count ELSE temperature END),
+           SUM(CASE WHEN rh_mean IS NOT NULL THEN sample_count WHEN humidity IS NOT NULL THEN 1 ELSE 0 END),
+           MIN(COALESCE(rh_min, humidity)),
+           MAX(COALESCE(rh_max, humidity)),
+           TOTAL(CASE WHEN rh_mean IS NOT NULL THEN rh_mean * sample_count ELSE humidity END)
+    FROM readings WHERE ts IS NOT NULL
+    GROUP BY device_id, bucket;
+
@@ -0,0 +1,172 @@
+// AirQ binary reading decoder (matches firmware/include/reading_codec.h)
+// Shared by the dashboard (MQTT messages) and the ingest function (binary uploads).
+
+export const READING_BIN_VERSION = 7;
+export const READING_BIN_LEN = 88;   // longest record, with the firmware's 4 extra slots
+
+// Record lengths of v1 (no ts_epoch_ms), v2 (no span) and v3 (no add-on sensors).
+// v4 appends extra slots to v3 (its length follows from the slot count), v5 the
+// statistics block after them and v6 the boot count. v7 keeps those sections but
+// each is only there when its flag is set (the slot count always is). All but
+// the current version come from older firmware.
+const RECORD_LEN = { 1: 15, 2: 21, 3: 47 };
+const HEAD_LEN = 21;
+const SPAN_LEN = 26;
+const EXTRA_AT = 47;   // v4 to v6
+const EXTRA_SLOT_LEN = 5;
+const STATS_LEN = 18;
+const BOOT_LEN = 2;
+
+// Add-on sensor fields by wire id (firmware/include/sensor_fields.h): [key, decimals].
+// Ids are append-only; unknown ones (newer firmware) are skipped.
+const EXTRA_FIELDS = {
+  1: ["pm1_ugm3", 0],
+  2: ["pm25_ugm3", 0],
+  3: ["pm10_ugm3", 0],
+  4: ["co2_ppm", 0]
+};
+
+const FLAG_WARMING_UP = 0x01;
+const FLAG_T_VALID = 0x02;
+const FLAG_RH_VALID = 0x04;
+const FLAG_SPAN_T_VALID = 0x08;
+const FLAG_SPAN_RH_VALID = 0x10;
+const FLAG_SPAN = 0x20;    // v7 section flags
+const FLAG_STATS = 0x40;
+const FLAG_BOOT = 0x80;
+
+// Three consecutive values (min, mean, max) starting at `at`
+function triple(view, at, read, scale, valid) {
+  if (!valid) return [null, null, null];
+  return [0, 2, 4].map(d => read.call(view, at + d, true) / scale);
+}
+
+// Spike bits of the statistics block (READING_ANOMALY_* in firmware/include/reading.h)
+const ANOMALY_TVOC_SPIKE = 0x01;
+const ANOMALY_ECO2_SPIKE = 0x02;
+
+// Offsets of the sections of the record at `offset` (null when absent) and its
+// length; undefined for an unknown version or a header that isn't there yet.
+function recordLayout(bytes, offset = 0) {
+  const version = bytes[offset];
+  const avail = bytes.length - offset;
+  if (version === 7) {
+    if (avail <= HEAD_LEN) return undefined;
+    const flags = bytes[offset + 1];
+    const span = (flags & FLAG_SPAN) ? HEAD_LEN : null;
+    const extra = HEAD_LEN + (span !== null ? SPAN_LEN : 0);
+    if (avail <= extra) return undefined;
+    let len = extra + 1 + EXTRA_SLOT_LEN * bytes[offset + extra];
+    const stats = (flags & FLAG_STATS) ? len : null;
+    if (stats !== null) len += STATS_LEN;
+    const boot = (flags & FLAG_BOOT) ? len : null;
+    if (boot !== null) len += BOOT_LEN;
+    return { span, extra, stats, boot, len };
+  }
+  if (version >= 4 && version <= 6) {
+    if (avail <= EXTRA_AT) return undefined;
+    const stats = EXTRA_AT + 1 + EXTRA_SLOT_LEN * bytes[offset + EXTRA_AT];
+    return {
+      span: HEAD_LEN,
+      extra: EXTRA_AT,
+      stats: version >= 5 ? stats : null,
+      boot: version >= 6 ? stats + STATS_LEN : null,
+      len: stats + (version >= 5 ? STATS_LEN : 0) + (version >= 6 ? BOOT_LEN : 0)
+    };
+  }
+  const len = RECORD_LEN[version];
+  if (len === undefined) return undefined;
+  return { span: version >= 3 ? HEAD_LEN : null, extra: null, stats: null, boot: null, len };
+}
+
+function recordLen(bytes, offset = 0) {
+  return recordLayout(bytes, offset)?.len;
+}
+
+// JSON payloads start with '{' or '['; binary ones with the version byte
+export function isBinaryReading(bytes) {
+  const len = recordLen(bytes);
+  return len !== undefined && bytes.length >= len;
+}
+
+// Decode one record at `offset` into the firmware's JSON shape.
+// Returns null for an unknown version or a truncated record.
+export function decodeReading(bytes, deviceId = null, offset = 0) {
+  const version = bytes[offset];
+  const layout = recordLayout(bytes, offset);
+  if (layout === undefined || bytes.length - offset < layout.len) return null;
+  const view = new DataView(bytes.buffer, bytes.byteOffset + offset, layout.len);
+
+  const flags = view.getUint8(1);
+  // uint48 Unix ms, 0 while the device clock wasn't synced
+  const epochMs = version >= 2 ? view.getUint32(15, true) + view.getUint16(19, true) * 2 ** 32 : 0;
+  // Boot count (0: unknown), as the firmware's JSON "boot"
+  const boot = layout.boot !== null ? view.getUint16(layout.boot, true) : 0;
+  const reading = {
+    ts_ms: view.getUint32(2, true),
+    ts_epoch_ms: epochMs || null,
+    device_id: deviceId,
+    t_c: (flags & FLAG_T_VALID) ? view.getInt16(6, true) / 100 : null,
+    rh: (flags & FLAG_RH_VALID) ? view.getUint16(8, true) / 100 : null,
+    tvoc_ppb: view.getUint16(10, true),
+    eco2_ppm: view.getUint16(12, true),
+    aq_index: view.getUint8(14),
+    warming_up: (flags & FLAG_WARMING_UP) !== 0
+  };
+  if (boot) reading.boot = boot;
+
+  // Add-on sensors: one key per filled slot, as in the firmware's JSON
+  if (layout.extra !== null) {
+    const extraEnd = layout.extra + 1 + EXTRA_SLOT_LEN * view.getUint8(layout.extra);
+    for (let at = layout.extra + 1; at + EXTRA_SLOT_LEN <= extraEnd; at += EXTRA_SLOT_LEN) {
+      const field = EXTRA_FIELDS[view.getUint8(at)];
+      if (field) reading[field[0]] = view.getInt32(at + 1, true) / 10 ** field[1];
+    }
+  }
+
+  // Edge analytics, same shape as the firmware's JSON "stats" and "spike":
+  // [ewma, window min, window max, change per minute]
+  if (layout.stats !== null) {
+    const at = layout.stats;
+    const n = view.getUint8(at);
+    const stats = (base, rateAt) => [
+      view.getUint16(base, true), view.getUint16(base + 2, true), view.getUint16(base + 4, true),
+      view.getInt16(rateAt, true)
+    ];
+    if (n > 0) reading.stats = { n, tvoc_ppb: stats(at + 2, at + 14), eco2_ppm: stats(at + 8, at + 16) };
+    const anomalies = view.getUint8(at + 1);
+    if (anomalies) {
+      reading.spike = [];
+      if (anomalies & ANOMALY_TVOC_SPIKE) reading.spike.push("tvoc_ppb");
+      if (anomalies & ANOMALY_ECO2_SPIKE) reading.spike.push("eco2_ppm");
+    }
+  }
+
+  // Report-by-exception window summary, same shape as the firmware's JSON "agg"
+  const at = layout.span;
+  const samples = at !== null ? view.getUint16(at, true) : 1;
+  if (samples > 1) {
+    reading.agg = {
+      n: samples,
+      tvoc_ppb: triple(view, at + 2, view.getUint16, 1, true),
+      eco2_ppm: triple(view, at + 8, view.getUint16, 1, true),
+      t_c: triple(view, at + 14, view.getInt16, 100, flags & FLAG_SPAN_T_VALID),
+      rh: triple(view, at + 20, view.getUint16, 100, flags & FLAG_SPAN_RH_VALID)
+    };
+  }
+  return reading;
+}
+
+// Decode back-to-back records (a binary batch); each record's version gives its length.
+// Stops at the first record it can't decode: consumed < bytes.length then.
+export function decodeReadings(bytes, deviceId = null) {
+  const readings = [];
+  let offset = 0;
+  while (offset < bytes.length) {
+    const r = decodeReading(bytes, deviceId, offset);
+    if (r === null) break;
+    readings.push(r);
+    offset += recordLen(bytes, offset);
+  }
+  return { readings, consumed: offset };
+}
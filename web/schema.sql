@@ -1,19 +1,54 @@
 -- AirQ Database Schema for D1
 -- Stores sensor readings from ESP8266 firmware
 
-CREATE TABLE IF NOT EXISTS readings (
-    id INTEGER PRIMARY KEY AUTOINCREMENT,
-    device_id TEXT NOT NULL,
-    ts_ms INTEGER NOT NULL,
-    temperature REAL,
-    humidity REAL,
-    tvoc_ppb INTEGER,
-    eco2_ppm INTEGER,
-    aq_index INTEGER,
-    warming_up INTEGER,
-    created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+-- Readings are stored in monthly tables readings_v2_YYYYMM (UTC), created by the
+-- ingest path on first write (lib/readings-store.js):
+--
+--   device_id TEXT, reading_id INTEGER
+--                                     -- PRIMARY KEY (device_id, reading_id), WITHOUT ROWID;
+--                                     -- reading_id = boot * 2^32 + ts_ms (-ts if boot is unknown)
+--   ts INTEGER                        -- measurement time (Unix ms)
+--   ts_source INTEGER                 -- 0: ts is the device's SNTP time, 1: estimated at ingest
+--   ts_ms INTEGER                     -- device uptime (ms)
+--   boot INTEGER                      -- device cold boot count (NULL for older firmware)
+--   temperature, humidity, tvoc_ppb, eco2_ppm, aq_index, warming_up
+--   sample_count, {tvoc,eco2,temp,rh}_{min,mean,max}
+--                                     -- report-by-exception window (NULL for single samples)
+--   received_ms INTEGER               -- server receive time (Unix ms)
+--
+-- with indexes on (device_id, ts) and ts. reading_buckets lists them and the ts
+-- range each holds; older readings_YYYYMM tables, keyed by (device_id, ts), stay readable.
+CREATE TABLE IF NOT EXISTS reading_buckets (
+    name TEXT PRIMARY KEY,
+    start_ms INTEGER NOT NULL,
+    end_ms INTEGER NOT NULL
 );
 
-CREATE INDEX IF NOT EXISTS idx_readings_created_at ON readings(created_at DESC);
-CREATE INDEX IF NOT EXISTS idx_readings_device ON readings(device_id);
+-- Per-device rollups, merged at ingest: count/min/max/sum of each metric over
+-- 1 minute and 1 hour buckets (the sum of a report with an agg window is
+-- mean * sample_count). Averages are <metric>_sum / <metric>_n.
+CREATE TABLE IF NOT EXISTS rollup_1m (
+    device_id TEXT NOT NULL,
+    bucket_ms INTEGER NOT NULL,     -- bucket start (Unix ms)
+    n INTEGER NOT NULL,             -- samples, counting each report's sample_count
+    tvoc_n INTEGER NOT NULL, tvoc_min INTEGER, tvoc_max INTEGER, tvoc_sum REAL NOT NULL,
+    eco2_n INTEGER NOT NULL, eco2_min INTEGER, eco2_max INTEGER, eco2_sum REAL NOT NULL,
+    aq_n INTEGER NOT NULL, aq_min INTEGER, aq_max INTEGER, aq_sum REAL NOT NULL,
+    temp_n INTEGER NOT NULL, temp_min REAL, temp_max REAL, temp_sum REAL NOT NULL,
+    rh_n INTEGER NOT NULL, rh_min REAL, rh_max REAL, rh_sum REAL NOT NULL,
+    PRIMARY KEY (device_id, bucket_ms)
+) WITHOUT ROWID;
+CREATE INDEX IF NOT EXISTS idx_rollup_1m_bucket ON rollup_1m(bucket_ms);
 
+CREATE TABLE IF NOT EXISTS rollup_1h (
+    device_id TEXT NOT NULL,
+    bucket_ms INTEGER NOT NULL,     -- bucket start (Unix ms)
+    n INTEGER NOT NULL,             -- samples, counting each report's sample_count
+    tvoc_n INTEGER NOT NULL, tvoc_min INTEGER, tvoc_max INTEGER, tvoc_sum REAL NOT NULL,
+    eco2_n INTEGER NOT NULL, eco2_min INTEGER, eco2_max INTEGER, eco2_sum REAL NOT NULL,
+    aq_n INTEGER NOT NULL, aq_min INTEGER, aq_max INTEGER, aq_sum REAL NOT NULL,
+    temp_n INTEGER NOT NULL, temp_min REAL, temp_max REAL, temp_sum REAL NOT NULL,
+    rh_n INTEGER NOT NULL, rh_min REAL, rh_max REAL, rh_sum REAL NOT NULL,
+    PRIMARY KEY (device_id, bucket_ms)
+) WITHOUT ROWID;
+CREATE INDEX IF NOT EXISTS idx_rollup_1h_bucket ON rollup_1h(bucket_ms);
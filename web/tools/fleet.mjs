@@ -0,0 +1,209 @@
+// AirQ fleet simulator: synthetic devices producing the firmware's report payloads
+// (JSON as in firmware/src/reading_json.cpp, binary as in firmware/include/reading_codec.h),
+// so load tests exercise the same parsing, validation and storage paths as real devices.
+
+import { READING_BIN_VERSION, READING_BIN_LEN } from '../public/airq-payload.js';
+
+const FLAG_WARMING_UP = 0x01;
+const FLAG_T_VALID = 0x02;
+const FLAG_RH_VALID = 0x04;
+const FLAG_SPAN_T_VALID = 0x08;
+const FLAG_SPAN_RH_VALID = 0x10;
+const FLAG_SPAN = 0x20;
+const FLAG_STATS = 0x40;
+const FLAG_BOOT = 0x80;
+
+const HEAD_LEN = 21;
+const SPAN_LEN = 26;
+const ANOMALY_TVOC_SPIKE = 0x01;
+const ANOMALY_ECO2_SPIKE = 0x02;
+
+// Rolling window the firmware's edge statistics cover (EDGE_WINDOW)
+const EDGE_WINDOW = 32;
+
+// mulberry32: small, seedable, good enough for sensor noise
+export function prng(seed) {
+  let a = seed >>> 0;
+  return () => {
+    a = (a + 0x6d2b79f5) >>> 0;
+    let t = Math.imul(a ^ (a >>> 15), 1 | a);
+    t = (t + Math.imul(t ^ (t >>> 7), 61 | t)) ^ t;
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+// Same mapping as firmware/src/aq_index.cpp
+export function tvocToIndex(tvoc) {
+  if (tvoc <= 200) return Math.floor(tvoc * 60 / 200);
+  if (tvoc <= 800) return Math.floor(60 + (tvoc - 200) * 30 / 600);
+  return 100;
+}
+
+const clamp = (v, lo, hi) => Math.min(hi, Math.max(lo, v));
+const round2 = v => Math.round(v * 100) / 100;
+
+// One simulated device. Each report stands for `samples` sensor samples taken
+// sampleMs apart (more than one: the report carries their "agg" summary, as
+// after report-by-exception suppression); TVOC occasionally spikes.
+export class SimDevice {
+  constructor(id, { seed = 1, sampleMs = 2000, samples = 1, spikeRate = 0.002 } = {}) {
+    this.id = id;
+    this.random = prng(seed);
+    this.sampleMs = sampleMs;
+    this.samples = Math.max(1, samples);
+    this.spikeRate = spikeRate;
+    // Devices booted at different times, some minutes ago, some days, and some more often
+    this.uptimeMs = Math.floor(this.random() * 3 * 24 * 3600 * 1000);
+    this.boot = 1 + Math.floor(this.random() * 200);
+    this.tvoc = 30 + this.random() * 120;
+    this.eco2 = 400 + this.tvoc * 0.6;
+    this.tC = 19 + this.random() * 8;
+    this.rh = 35 + this.random() * 25;
+    this.spikeLeft = 0;
+    this.ewma = { tvoc: this.tvoc, eco2: this.eco2 };
+    this.window = { tvoc: [], eco2: [] };
+    this.last = { tvoc: this.tvoc, eco2: this.eco2 };
+  }
+
+  step() {
+    const r = this.random;
+    if (this.spikeLeft === 0 && r() < this.spikeRate) this.spikeLeft = 5 + Math.floor(r() * 10);
+    const target = this.spikeLeft > 0 ? 900 : 60;
+    if (this.spikeLeft > 0) this.spikeLeft--;
+    this.tvoc = clamp(this.tvoc + (target - this.tvoc) * 0.08 + (r() - 0.5) * 12, 0, 60000);
+    this.eco2 = clamp(400 + this.tvoc * 0.6 + (r() - 0.5) * 20, 400, 60000);
+    this.tC = clamp(this.tC + (r() - 0.5) * 0.05, -40, 85);
+    this.rh = clamp(this.rh + (r() - 0.5) * 0.2, 0, 100);
+    this.uptimeMs += this.sampleMs;
+    return {
+      tvoc: Math.round(this.tvoc), eco2: Math.round(this.eco2), tC: round2(this.tC), rh: round2(this.rh)
+    };
+  }
+
+  // Edge statistics of one channel after a sample: [ewma, min, max, change per minute]
+  edge(key, value) {
+    const w = this.window[key];
+    w.push(value);
+    if (w.length > EDGE_WINDOW) w.shift();
+    const above = value - this.ewma[key];
+    const rate = Math.round((value - this.last[key]) * 60000 / this.sampleMs);
+    this.ewma[key] += (value - this.ewma[key]) / 8;
+    this.last[key] = value;
+    return { stat: [Math.round(this.ewma[key]), Math.min(...w), Math.max(...w), clamp(rate, -32768, 32767)], above };
+  }
+
+  // Next report in the firmware's JSON shape, measured at epochMs
+  report(epochMs) {
+    // The device updates its edge statistics on every sample and reports the last one
+    const taken = [];
+    let tvoc, eco2;
+    for (let i = 0; i < this.samples; i++) {
+      const s = this.step();
+      taken.push(s);
+      tvoc = this.edge('tvoc', s.tvoc);
+      eco2 = this.edge('eco2', s.eco2);
+    }
+    const s = taken[taken.length - 1];
+
+    const reading = {
+      ts_ms: this.uptimeMs >>> 0,
+      boot: this.boot,
+      ts_epoch_ms: epochMs,
+      device_id: this.id,
+      t_c: s.tC,
+      rh: s.rh,
+      tvoc_ppb: s.tvoc,
+      eco2_ppm: s.eco2,
+      aq_index: tvocToIndex(s.tvoc),
+      warming_up: false,
+      stats: { n: this.window.tvoc.length, tvoc_ppb: tvoc.stat, eco2_ppm: eco2.stat }
+    };
+    // Same bands as the default SPIKE_TVOC_RISE_PPB / SPIKE_ECO2_RISE_PPM
+    const spike = [];
+    if (tvoc.above >= 150 && tvoc.stat[3] >= 300) spike.push('tvoc_ppb');
+    if (eco2.above >= 200 && eco2.stat[3] >= 400) spike.push('eco2_ppm');
+    if (spike.length > 0) reading.spike = spike;
+
+    if (taken.length > 1) {
+      const span = key => {
+        const v = taken.map(t => t[key]);
+        const mean = v.reduce((a, b) => a + b, 0) / v.length;
+        const integer = key === 'tvoc' || key === 'eco2';
+        return [Math.min(...v), integer ? Math.round(mean) : round2(mean), Math.max(...v)];
+      };
+      reading.agg = { n: taken.length, tvoc_ppb: span('tvoc'), eco2_ppm: span('eco2'), t_c: span('tC'), rh: span('rh') };
+    }
+    return reading;
+  }
+}
+
+// Firmware JSON reading → binary record (current READING_BIN_VERSION, no add-on
+// sensors) at `offset` in `out`; returns the record's bytes
+export function encodeReading(reading, out = new Uint8Array(READING_BIN_LEN), offset = 0) {
+  const view = new DataView(out.buffer, out.byteOffset + offset, READING_BIN_LEN);
+  const agg = reading.agg;
+  const st = reading.stats;
+  const centi = (v, lo, hi) => clamp(Math.round(v * 100), lo, hi);
+  let anomalies = 0;
+  if (reading.spike?.includes('tvoc_ppb')) anomalies |= ANOMALY_TVOC_SPIKE;
+  if (reading.spike?.includes('eco2_ppm')) anomalies |= ANOMALY_ECO2_SPIKE;
+
+  let flags = 0;
+  if (reading.warming_up) flags |= FLAG_WARMING_UP;
+  if (reading.t_c !== null) flags |= FLAG_T_VALID;
+  if (reading.rh !== null) flags |= FLAG_RH_VALID;
+  if (agg) flags |= FLAG_SPAN;
+  if (agg?.t_c) flags |= FLAG_SPAN_T_VALID;
+  if (agg?.rh) flags |= FLAG_SPAN_RH_VALID;
+  if (st || anomalies) flags |= FLAG_STATS;
+  if (reading.boot) flags |= FLAG_BOOT;
+
+  view.setUint8(0, READING_BIN_VERSION);
+  view.setUint8(1, flags);
+  view.setUint32(2, reading.ts_ms, true);
+  view.setInt16(6, flags & FLAG_T_VALID ? centi(reading.t_c, -32768, 32767) : 0, true);
+  view.setUint16(8, flags & FLAG_RH_VALID ? centi(reading.rh, 0, 65535) : 0, true);
+  view.setUint16(10, reading.tvoc_ppb, true);
+  view.setUint16(12, reading.eco2_ppm, true);
+  view.setUint8(14, reading.aq_index);
+  const epoch = reading.ts_epoch_ms ?? 0;
+  view.setUint32(15, epoch % 2 ** 32, true);
+  view.setUint16(19, Math.floor(epoch / 2 ** 32), true);
+  let at = HEAD_LEN;
+
+  if (agg) {
+    view.setUint16(at, agg.n, true);
+    agg.tvoc_ppb.forEach((v, i) => view.setUint16(at + 2 + 2 * i, v, true));
+    agg.eco2_ppm.forEach((v, i) => view.setUint16(at + 8 + 2 * i, v, true));
+    [0, 1, 2].forEach(i => {
+      view.setInt16(at + 14 + 2 * i, agg.t_c ? centi(agg.t_c[i], -32768, 32767) : 0, true);
+      view.setUint16(at + 20 + 2 * i, agg.rh ? centi(agg.rh[i], 0, 65535) : 0, true);
+    });
+    at += SPAN_LEN;
+  }
+
+  view.setUint8(at++, 0);   // no extra slots
+
+  if (flags & FLAG_STATS) {
+    view.setUint8(at, st?.n ?? 0);
+    view.setUint8(at + 1, anomalies);
+    [...(st?.tvoc_ppb.slice(0, 3) ?? [0, 0, 0]), ...(st?.eco2_ppm.slice(0, 3) ?? [0, 0, 0])]
+      .forEach((v, i) => view.setUint16(at + 2 + 2 * i, v, true));
+    view.setInt16(at + 14, st?.tvoc_ppb[3] ?? 0, true);
+    view.setInt16(at + 16, st?.eco2_ppm[3] ?? 0, true);
+    at += 18;
+  }
+  if (flags & FLAG_BOOT) {
+    view.setUint16(at, reading.boot, true);
+    at += 2;
+  }
+  return out.subarray(offset, offset + at);
+}
+
+// Back-to-back records, as the firmware's binary batch upload
+export function encodeReadings(readings) {
+  const out = new Uint8Array(READING_BIN_LEN * readings.length);
+  let len = 0;
+  for (const r of readings) len += encodeReading(r, out, len).length;
+  return out.subarray(0, len);
+}
@@ -0,0 +1,432 @@
+// AirQ fleet load test: thousands of simulated devices (tools/fleet.mjs)
+// uploading the firmware's payloads at a fixed rate over the HTTPS ingest path
+// and/or publishing them over MQTT, reporting latency percentiles, error rates
+// and write throughput. Run it against `wrangler pages dev` or a preview
+// deployment before and after each server-side batching or schema change.
+//
+//   node tools/loadtest.mjs --url http://localhost:8788 --devices 2000 --duration 120
+//   node tools/loadtest.mjs --mqtt mqtts://<cluster>.hivemq.cloud:8883 --devices 200 --format binary
+//
+// Every device uploads `--batch` reports (taken `--report-s` apart) per POST,
+// as the firmware's BATCH_MAX_SAMPLES batching does, and publishes each report
+// on MQTT as it is taken. Latency is measured from the moment a request was due,
+// so time spent waiting for a free `--concurrency` slot counts against the
+// server instead of silently lowering the offered load.
+
+import { SimDevice, encodeReading, encodeReadings } from './fleet.mjs';
+import { MqttPublisher } from './mqtt-publisher.mjs';
+
+const DEFAULTS = {
+  url: null,                 // HTTPS path: base URL of the Pages project
+  path: '/api/store',        // firmware upload path (same handler as /api/ingest)
+  mqtt: null,                // MQTT path: mqtts://host:port
+  'mqtt-user': null,          // default $AIRQ_MQTT_USERNAME
+  'mqtt-pass': null,          // default $AIRQ_MQTT_PASSWORD
+  'mqtt-topic': 'airq/',     // prefix; the device id follows, as MQTT_TOPIC
+  'mqtt-clients': 0,         // MQTT connections shared by the devices, 0 = one per device
+  devices: 100,
+  prefix: 'loadtest',        // device ids are <prefix>-00001, ...
+  format: 'json',            // json (an array when --batch > 1) or binary
+  'report-s': 2,             // seconds between a device's reports (SAMPLE_MS)
+  batch: 15,                 // reports per HTTPS upload (BATCH_MAX_SAMPLES)
+  samples: 1,                // samples each report stands for (> 1 adds "agg")
+  duration: 60,              // seconds of load
+  concurrency: 512,          // HTTPS requests in flight at most
+  timeout: 10,               // seconds before a request or publish counts as failed
+  progress: 10,              // seconds between progress lines, 0 = none
+  verify: 0,                 // devices whose stored rows are counted afterwards
+  'verify-timeout': 60,      // seconds to wait for buffered rows to reach D1
+  seed: 1,
+  json: false                // print the summary as JSON
+};
+
+const USAGE = `usage: node tools/loadtest.mjs (--url <base> | --mqtt <mqtts://host:port>) [options]
+${Object.entries(DEFAULTS).map(([k, v]) => `  --${k}${typeof v === 'boolean' ? '' : ` <${v ?? 'value'}>`}`).join('\n')}`;
+
+function parseArgs(argv) {
+  const opts = { ...DEFAULTS };
+  for (let i = 0; i < argv.length; i++) {
+    const m = /^--([a-z-]+)(?:=(.*))?$/.exec(argv[i]);
+    if (!m || !(m[1] in DEFAULTS)) throw new Error(`unknown option ${argv[i]}`);
+    const key = m[1];
+    if (typeof DEFAULTS[key] === 'boolean') {
+      opts[key] = true;
+      continue;
+    }
+    const value = m[2] ?? argv[++i];
+    if (value === undefined) throw new Error(`--${key} needs a value`);
+    opts[key] = typeof DEFAULTS[key] === 'number' ? Number(value) : value;
+    if (typeof DEFAULTS[key] === 'number' && !Number.isFinite(opts[key])) throw new Error(`--${key}: not a number`);
+  }
+  opts['mqtt-user'] ??= process.env.AIRQ_MQTT_USERNAME ?? null;
+  opts['mqtt-pass'] ??= process.env.AIRQ_MQTT_PASSWORD ?? null;
+  if (!opts.url && !opts.mqtt) throw new Error('nothing to load: give --url and/or --mqtt');
+  if (opts.format !== 'json' && opts.format !== 'binary') throw new Error('--format must be json or binary');
+  if (opts.devices < 1 || opts.batch < 1 || opts['report-s'] <= 0) throw new Error('--devices, --batch and --report-s must be positive');
+  return opts;
+}
+
+const sleep = ms => new Promise(resolve => setTimeout(resolve, ms));
+
+function withTimeout(promise, ms) {
+  let timer;
+  const timeout = new Promise((_, reject) => {
+    timer = setTimeout(() => reject(Object.assign(new Error('timeout'), { code: 'timeout' })), ms);
+  });
+  return Promise.race([promise, timeout]).finally(() => clearTimeout(timer));
+}
+
+// Nearest-rank percentile of an ascending array
+function percentile(sorted, p) {
+  if (sorted.length === 0) return null;
+  return sorted[Math.min(sorted.length - 1, Math.ceil(p / 100 * sorted.length) - 1)];
+}
+
+// Outcomes of one transport; window() returns and resets the counts since the last call
+class Stats {
+  constructor(name) {
+    this.name = name;
+    this.requests = 0;
+    this.readings = 0;
+    this.ok = 0;
+    this.okReadings = 0;
+    this.stored = 0;      // readings written to D1 before the response
+    this.buffered = 0;    // readings accepted by the ingest buffer
+    this.queued = 0;      // requests that waited for a concurrency slot
+    this.errors = new Map();
+    this.latencies = [];
+    this.recent = [];
+    this.recentErrors = 0;
+    this.firstMs = null;
+    this.lastMs = null;
+  }
+
+  fail(kind) {
+    this.errors.set(kind, (this.errors.get(kind) ?? 0) + 1);
+  }
+
+  record(dueMs, readings, error = null) {
+    const now = performance.now();
+    this.firstMs = Math.min(this.firstMs ?? dueMs, dueMs);
+    this.lastMs = now;
+    this.requests++;
+    this.readings += readings;
+    if (error !== null) {
+      this.fail(error);
+      this.recentErrors++;
+      return;
+    }
+    this.ok++;
+    this.okReadings += readings;
+    this.latencies.push(now - dueMs);
+    this.recent.push(now - dueMs);
+  }
+
+  window() {
+    const sorted = this.recent.sort((a, b) => a - b);
+    const out = { n: sorted.length + this.recentErrors, errors: this.recentErrors, p50: percentile(sorted, 50), p99: percentile(sorted, 99) };
+    this.recent = [];
+    this.recentErrors = 0;
+    return out;
+  }
+
+  summary() {
+    const sorted = this.latencies.sort((a, b) => a - b);
+    const seconds = this.firstMs === null ? 0 : Math.max(this.lastMs - this.firstMs, 1) / 1000;
+    const round = v => v === null ? null : Math.round(v * 10) / 10;
+    return {
+      requests: this.requests,
+      readings: this.readings,
+      ok: this.ok,
+      error_rate: this.requests ? (this.requests - this.ok) / this.requests : 0,
+      errors: Object.fromEntries(this.errors),
+      queued: this.queued,
+      latency_ms: {
+        p50: round(percentile(sorted, 50)),
+        p90: round(percentile(sorted, 90)),
+        p99: round(percentile(sorted, 99)),
+        max: round(sorted.length ? sorted[sorted.length - 1] : null)
+      },
+      requests_per_s: round(this.requests / (seconds || 1)),
+      readings_per_s: round(this.okReadings / (seconds || 1)),
+      stored: this.stored,
+      stored_per_s: round(this.stored / (seconds || 1)),
+      buffered: this.buffered
+    };
+  }
+}
+
+// Bounded number of requests in flight; acquire() waits for a free slot
+class Slots {
+  constructor(n) {
+    this.free = n;
+    this.waiting = [];
+  }
+
+  acquire() {
+    if (this.free > 0) {
+      this.free--;
+      return null;
+    }
+    return new Promise(resolve => this.waiting.push(resolve));
+  }
+
+  release() {
+    const next = this.waiting.shift();
+    if (next) next();
+    else this.free++;
+  }
+}
+
+class HttpsLoad {
+  constructor(opts) {
+    this.endpoint = new URL(opts.path, opts.url);
+    this.binary = opts.format === 'binary';
+    this.timeoutMs = opts.timeout * 1000;
+    this.slots = new Slots(opts.concurrency);
+    this.stats = new Stats('https');
+    this.inflight = new Set();
+  }
+
+  request(readings) {
+    const deviceId = readings[0].device_id;
+    if (this.binary) {
+      const url = new URL(this.endpoint);
+      url.searchParams.set('device_id', deviceId);
+      return { url, init: { headers: { 'Content-Type': 'application/octet-stream' }, body: encodeReadings(readings) } };
+    }
+    const body = JSON.stringify(readings.length === 1 ? readings[0] : readings);
+    return { url: this.endpoint, init: { headers: { 'Content-Type': 'application/json' }, body } };
+  }
+
+  upload(readings, dueMs) {
+    const run = async () => {
+      const wait = this.slots.acquire();
+      if (wait) {
+        this.stats.queued++;
+        await wait;
+      }
+      const { url, init } = this.request(readings);
+      try {
+        const res = await fetch(url, { ...init, method: 'POST', signal: AbortSignal.timeout(this.timeoutMs) });
+        const body = await res.json().catch(() => null);
+        if (!res.ok) {
+          this.stats.record(dueMs, readings.length, `http_${res.status}`);
+          return;
+        }
+        if (body?.buffered) this.stats.buffered += readings.length;
+        else this.stats.stored += readings.length;
+        this.stats.record(dueMs, readings.length);
+      } catch (err) {
+        const kind = err.name === 'TimeoutError' ? 'timeout' : (err.cause?.code ?? err.name);
+        this.stats.record(dueMs, readings.length, kind);
+      } finally {
+        this.slots.release();
+      }
+    };
+    const p = run();
+    this.inflight.add(p);
+    p.finally(() => this.inflight.delete(p));
+  }
+
+  drain() {
+    return Promise.all(this.inflight);
+  }
+}
+
+class MqttLoad {
+  constructor(opts) {
+    this.opts = opts;
+    this.binary = opts.format === 'binary';
+    this.timeoutMs = opts.timeout * 1000;
+    this.clients = [];
+    this.stats = new Stats('mqtt');
+    this.inflight = new Set();
+  }
+
+  // Connect in small groups so the broker doesn't see one burst of handshakes
+  async connect(count) {
+    const { opts } = this;
+    for (let i = 0; i < count; i += 20) {
+      const group = [];
+      for (let j = i; j < Math.min(i + 20, count); j++) {
+        const client = new MqttPublisher(opts.mqtt, {
+          clientId: `${opts.prefix}-pub-${String(j + 1).padStart(5, '0')}`,
+          username: opts['mqtt-user'],
+          password: opts['mqtt-pass'],
+          connectTimeoutMs: this.timeoutMs
+        });
+        this.clients.push(client);
+        group.push(client.connect().catch(err => this.stats.fail(`connect_${err.code ?? err.message}`)));
+      }
+      await Promise.all(group);
+    }
+    return this.clients.filter(c => !c.closed).length;
+  }
+
+  publish(index, reading, dueMs) {
+    const client = this.clients[index % this.clients.length];
+    const payload = this.binary ? encodeReading(reading) : JSON.stringify(reading);
+    const p = withTimeout(client.publish(`${this.opts['mqtt-topic']}${reading.device_id}`, payload), this.timeoutMs)
+      .then(() => this.stats.record(dueMs, 1), err => this.stats.record(dueMs, 1, err.code ?? err.message));
+    this.inflight.add(p);
+    p.finally(() => this.inflight.delete(p));
+  }
+
+  async drain() {
+    await Promise.all(this.inflight);
+    for (const client of this.clients) client.end();
+  }
+}
+
+// Stored raw rows of one device since fromMs (cache-busted: /api/latest is edge cached)
+async function storedRows(opts, deviceId, fromMs) {
+  const url = new URL('/api/latest', opts.url);
+  const minutes = Math.ceil((Date.now() - fromMs) / 60000) + 1;
+  url.searchParams.set('resolution', 'raw');
+  url.searchParams.set('device', deviceId);
+  url.searchParams.set('minutes', String(minutes));
+  url.searchParams.set('nocache', String(Date.now()));
+  const res = await fetch(url, { signal: AbortSignal.timeout(opts.timeout * 1000) });
+  if (!res.ok) throw new Error(`GET /api/latest: ${res.status}`);
+  const rows = await res.json();
+  return rows.filter(r => r.ts >= fromMs).length;
+}
+
+// Poll until every sampled device's rows are in D1 (buffered writes land later)
+async function verify(opts, devices, sent, fromMs, endMs) {
+  const sample = devices.slice(0, Math.min(opts.verify, devices.length));
+  const expected = sample.reduce((n, d) => n + sent.get(d.id), 0);
+  const deadline = Date.now() + opts['verify-timeout'] * 1000;
+  let found = 0;
+  for (;;) {
+    const counts = await Promise.all(sample.map(d => storedRows(opts, d.id, fromMs).catch(() => 0)));
+    found = counts.reduce((a, b) => a + b, 0);
+    if (found >= expected || Date.now() >= deadline) break;
+    await sleep(2000);
+  }
+  return { devices: sample.length, expected, found, drained_ms: found >= expected ? Date.now() - endMs : null };
+}
+
+function formatSummary(name, s) {
+  const pct = v => `${(v * 100).toFixed(2)}%`;
+  const errors = Object.entries(s.errors).map(([k, n]) => `${k}×${n}`).join(' ') || 'none';
+  const l = s.latency_ms;
+  const lines = [
+    `${name.padEnd(6)} ${s.requests} req, ${s.readings} readings, errors ${pct(s.error_rate)} (${errors})`,
+    `       latency p50 ${l.p50} ms, p90 ${l.p90} ms, p99 ${l.p99} ms, max ${l.max} ms; ${s.queued} queued for a slot`,
+    `       ${s.requests_per_s} req/s, ${s.readings_per_s} readings/s accepted`
+  ];
+  if (name === 'https') lines.push(`       ${s.stored} written to D1 in-request (${s.stored_per_s}/s), ${s.buffered} via the ingest buffer`);
+  return lines.join('\n');
+}
+
+async function main() {
+  let opts;
+  try {
+    opts = parseArgs(process.argv.slice(2));
+  } catch (err) {
+    console.error(`${err.message}\n${USAGE}`);
+    process.exit(2);
+  }
+
+  const reportMs = opts['report-s'] * 1000;
+  const devices = [];
+  for (let i = 0; i < opts.devices; i++) {
+    devices.push(new SimDevice(`${opts.prefix}-${String(i + 1).padStart(5, '0')}`, {
+      seed: opts.seed * 100003 + i,
+      sampleMs: reportMs / Math.max(1, opts.samples),
+      samples: opts.samples
+    }));
+  }
+
+  const https = opts.url ? new HttpsLoad(opts) : null;
+  const mqtt = opts.mqtt ? new MqttLoad(opts) : null;
+  if (mqtt) {
+    const count = opts['mqtt-clients'] > 0 ? Math.min(opts['mqtt-clients'], opts.devices) : opts.devices;
+    const up = await mqtt.connect(count);
+    console.error(`mqtt: ${up}/${count} connections up`);
+    if (up === 0) process.exit(1);
+  }
+
+  const loads = [https, mqtt].filter(Boolean);
+  const uploadMs = reportMs * opts.batch;
+  console.error(`${opts.devices} devices, a report every ${opts['report-s']} s` +
+    (https ? `, ${opts.batch} per ${opts.format} upload (${(opts.devices * 1000 / uploadMs).toFixed(1)} req/s)` : '') +
+    (mqtt ? `, ${(opts.devices * 1000 / reportMs).toFixed(1)} publishes/s` : '') + `, for ${opts.duration} s`);
+
+  // A fleet that booted at different times: each device's reports fall at a
+  // random point of the report period and its uploads at a random point of the
+  // upload period (so its first batch is short), then strictly periodic (no drift)
+  const epochStart = Date.now();
+  const start = performance.now();
+  const end = start + opts.duration * 1000;
+  const sent = new Map(devices.map(d => [d.id, 0]));
+  const timers = new Set();
+  devices.forEach((device, index) => {
+    const phase = device.random() * reportMs;
+    let k = 0;
+    let batch = [];
+    let batchLeft = 1 + Math.floor(device.random() * opts.batch);
+    const tick = () => {
+      const due = start + phase + k * reportMs;
+      const reading = device.report(epochStart + Math.round(due - start));
+      k++;
+      if (mqtt) mqtt.publish(index, reading, due);
+      if (https) {
+        batch.push(reading);
+        if (--batchLeft === 0) {
+          https.upload(batch, due);
+          sent.set(device.id, sent.get(device.id) + batch.length);
+          batch = [];
+          batchLeft = opts.batch;
+        }
+      }
+      const next = start + phase + k * reportMs;
+      if (next < end) schedule(next);
+    };
+    const schedule = at => {
+      const timer = setTimeout(() => {
+        timers.delete(timer);
+        tick();
+      }, Math.max(0, at - performance.now()));
+      timers.add(timer);
+    };
+    schedule(start + phase);
+  });
+
+  const progress = opts.progress > 0 ? setInterval(() => {
+    const t = ((performance.now() - start) / 1000).toFixed(0);
+    const parts = loads.map(l => {
+      const w = l.stats.window();
+      return `${l.stats.name} ${w.n} (${w.errors} err) p50 ${w.p50?.toFixed(0) ?? '-'} p99 ${w.p99?.toFixed(0) ?? '-'} ms`;
+    });
+    console.error(`[${t}s] ${parts.join(' | ')}`);
+  }, opts.progress * 1000) : null;
+
+  while (timers.size > 0) await sleep(100);
+  clearInterval(progress);
+  // Partial batches are not uploaded: the devices would send them in their next period
+  await Promise.all(loads.map(l => l.drain()));
+  const endMs = Date.now();
+
+  const result = { options: opts };
+  for (const l of loads) result[l.stats.name] = l.stats.summary();
+  if (https && opts.verify > 0) result.verify = await verify(opts, devices, sent, epochStart, endMs);
+
+  if (opts.json) {
+    console.log(JSON.stringify(result, (k, v) => k === 'mqtt-pass' ? undefined : v, 2));
+    return;
+  }
+  for (const l of loads) console.log(formatSummary(l.stats.name, result[l.stats.name]));
+  if (result.verify) {
+    const v = result.verify;
+    console.log(`verify ${v.devices} devices: ${v.found}/${v.expected} rows stored` +
+      (v.drained_ms !== null ? `, all in D1 ${(v.drained_ms / 1000).toFixed(1)} s after the last upload` : `, not all within ${opts['verify-timeout']} s`));
+  }
+}
+
+main().catch(err => {
+  console.error(err);
+  process.exit(1);
+});
@@ -0,0 +1,162 @@
+// Minimal MQTT 3.1.1 publisher for the load test: CONNECT, QoS1 PUBLISH and
+// PUBACK, PINGREQ when idle. The subset firmware/src/mqtt_link.cpp speaks, over
+// TLS (mqtts://, verified against Node's CA store) or plain TCP (mqtt://).
+
+import net from 'node:net';
+import tls from 'node:tls';
+
+const CONNECT = 0x10;
+const CONNACK = 0x20;
+const PUBLISH_QOS1 = 0x32;
+const PUBACK = 0x40;
+const PINGREQ = 0xc0;
+const DISCONNECT = 0xe0;
+
+const KEEPALIVE_S = 60;
+
+function remainingLength(n) {
+  const out = [];
+  do {
+    let b = n % 128;
+    n = Math.floor(n / 128);
+    if (n > 0) b |= 0x80;
+    out.push(b);
+  } while (n > 0);
+  return Buffer.from(out);
+}
+
+function utf8(s) {
+  const b = Buffer.from(s, 'utf8');
+  const len = Buffer.alloc(2);
+  len.writeUInt16BE(b.length);
+  return Buffer.concat([len, b]);
+}
+
+function packet(header, body) {
+  return Buffer.concat([Buffer.from([header]), remainingLength(body.length), body]);
+}
+
+export class MqttPublisher {
+  // url: mqtts://host[:8883] or mqtt://host[:1883]
+  constructor(url, { clientId, username = null, password = null, connectTimeoutMs = 15000 } = {}) {
+    this.url = new URL(url);
+    this.clientId = clientId;
+    this.username = username;
+    this.password = password;
+    this.connectTimeoutMs = connectTimeoutMs;
+    this.socket = null;
+    this.rx = Buffer.alloc(0);
+    this.nextId = 1;
+    this.inflight = new Map();   // packet id → { resolve, reject }
+    this.onConnack = null;
+    this.pinger = null;
+    this.closed = false;
+  }
+
+  connect() {
+    const secure = this.url.protocol === 'mqtts:';
+    const host = this.url.hostname;
+    const port = Number(this.url.port) || (secure ? 8883 : 1883);
+    return new Promise((resolve, reject) => {
+      const timer = setTimeout(() => fail(new Error('connect timeout')), this.connectTimeoutMs);
+      const fail = err => {
+        clearTimeout(timer);
+        this.close(err);
+        reject(err);
+      };
+      this.onConnack = code => {
+        clearTimeout(timer);
+        if (code !== 0) return fail(new Error(`CONNACK return code ${code}`));
+        this.pinger = setInterval(() => this.ping(), KEEPALIVE_S * 1000 / 2);
+        resolve();
+      };
+      const onConnect = () => this.socket.write(this.connectPacket());
+      this.socket = secure
+        ? tls.connect({ host, port, servername: host }, onConnect)
+        : net.connect({ host, port }, onConnect);
+      this.socket.setNoDelay(true);
+      this.socket.on('data', chunk => this.receive(chunk));
+      this.socket.on('error', err => fail(err));
+      this.socket.on('close', () => this.close(new Error('connection closed')));
+    });
+  }
+
+  connectPacket() {
+    let flags = 0x02;   // clean session
+    const payload = [utf8(this.clientId)];
+    if (this.username !== null) {
+      flags |= 0x80;
+      payload.push(utf8(this.username));
+    }
+    if (this.password !== null) {
+      flags |= 0x40;
+      payload.push(utf8(this.password));
+    }
+    const keepalive = Buffer.alloc(2);
+    keepalive.writeUInt16BE(KEEPALIVE_S);
+    return packet(CONNECT, Buffer.concat([utf8('MQTT'), Buffer.from([4, flags]), keepalive, ...payload]));
+  }
+
+  // Resolves on PUBACK
+  publish(topic, payload) {
+    if (this.closed) return Promise.reject(new Error('not connected'));
+    const id = this.nextId;
+    this.nextId = this.nextId === 0xffff ? 1 : this.nextId + 1;
+    const pid = Buffer.alloc(2);
+    pid.writeUInt16BE(id);
+    this.socket.write(packet(PUBLISH_QOS1, Buffer.concat([utf8(topic), pid, Buffer.from(payload)])));
+    return new Promise((resolve, reject) => this.inflight.set(id, { resolve, reject }));
+  }
+
+  ping() {
+    if (!this.closed) this.socket.write(Buffer.from([PINGREQ, 0]));
+  }
+
+  receive(chunk) {
+    this.rx = this.rx.length ? Buffer.concat([this.rx, chunk]) : chunk;
+    for (;;) {
+      // Fixed header: type byte, then 1-4 remaining-length bytes
+      let len = 0, mul = 1, at = 1, done = false;
+      while (at < this.rx.length && at <= 4) {
+        const b = this.rx[at++];
+        len += (b & 0x7f) * mul;
+        mul *= 128;
+        if ((b & 0x80) === 0) {
+          done = true;
+          break;
+        }
+      }
+      if (!done || this.rx.length < at + len) return;
+      const type = this.rx[0] & 0xf0;
+      const body = this.rx.subarray(at, at + len);
+      this.rx = this.rx.subarray(at + len);
+
+      if (type === CONNACK && this.onConnack) {
+        this.onConnack(body[1]);
+      } else if (type === PUBACK) {
+        const id = body.readUInt16BE(0);
+        const waiter = this.inflight.get(id);
+        if (waiter) {
+          this.inflight.delete(id);
+          waiter.resolve();
+        }
+      }
+      // PINGRESP needs nothing; nothing is subscribed, so no PUBLISH arrives
+    }
+  }
+
+  // DISCONNECT and close; publishes still awaiting their PUBACK fail
+  end() {
+    if (!this.closed && this.socket && !this.socket.destroyed) this.socket.write(Buffer.from([DISCONNECT, 0]));
+    this.close(new Error('closed'));
+  }
+
+  close(err) {
+    if (this.closed) return;
+    this.closed = true;
+    clearInterval(this.pinger);
+    for (const { reject } of this.inflight.values()) reject(err);
+    this.inflight.clear();
+    if (this.socket) this.socket.end();
+  }
+}